@@ -1,10 +1,19 @@
 #ifndef __PAMAURY_ADT_HPP__
 #define __PAMAURY_ADT_HPP__
 
+#include "config.hpp"
+
 #define __STDC_LIMIT_MACROS
 #include <stdint.h>
 #include <cassert>
 #include <string.h> /* for memset */
+#include <vector>
+#include <algorithm>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 namespace PAMAURY_SCHEDULER_NS
 {
@@ -83,45 +92,134 @@ inline size_t find_next_bit_set(T a, size_t cur_pos)
     return cur_pos;
 }
 
-} /* namespace */
+/**
+ * Chunk-wise operations, vectorised with AVX2 or SSE2 when available
+ */
+struct bit_or_op
+{
+    static uint64_t apply(uint64_t a, uint64_t b) { return a | b; }
+#if defined(__AVX2__)
+    static __m256i apply(__m256i a, __m256i b) { return _mm256_or_si256(a, b); }
+#elif defined(__SSE2__)
+    static __m128i apply(__m128i a, __m128i b) { return _mm_or_si128(a, b); }
+#endif
+};
 
-template< size_t MAX_CHUNKS >
-struct bitmap_N_const_bit_set_iterator;
+struct bit_and_op
+{
+    static uint64_t apply(uint64_t a, uint64_t b) { return a & b; }
+#if defined(__AVX2__)
+    static __m256i apply(__m256i a, __m256i b) { return _mm256_and_si256(a, b); }
+#elif defined(__SSE2__)
+    static __m128i apply(__m128i a, __m128i b) { return _mm_and_si128(a, b); }
+#endif
+};
 
-template< size_t MAX_CHUNKS >
-struct bitmap_N
+struct bit_andnot_op
 {
-    typedef bitmap_N_const_bit_set_iterator< MAX_CHUNKS > const_bit_set_iterator;
-    
-    bitmap_N()
+    static uint64_t apply(uint64_t a, uint64_t b) { return a & ~b; }
+    /* NOTE: the intrinsics compute ~first & second */
+#if defined(__AVX2__)
+    static __m256i apply(__m256i a, __m256i b) { return _mm256_andnot_si256(b, a); }
+#elif defined(__SSE2__)
+    static __m128i apply(__m128i a, __m128i b) { return _mm_andnot_si128(b, a); }
+#endif
+};
+
+/* dst[i] = OP(dst[i], src[i]) */
+template< typename OP >
+inline void combine_chunks(uint64_t *dst, const uint64_t *src, size_t n)
+{
+    size_t i = 0;
+#if defined(__AVX2__)
+    for(; i + 4 <= n; i += 4)
+        _mm256_storeu_si256((__m256i *)(dst + i), OP::apply(
+            _mm256_loadu_si256((const __m256i *)(dst + i)),
+            _mm256_loadu_si256((const __m256i *)(src + i))));
+#elif defined(__SSE2__)
+    for(; i + 2 <= n; i += 2)
+        _mm_storeu_si128((__m128i *)(dst + i), OP::apply(
+            _mm_loadu_si128((const __m128i *)(dst + i)),
+            _mm_loadu_si128((const __m128i *)(src + i))));
+#endif
+    for(; i < n; i++)
+        dst[i] = OP::apply(dst[i], src[i]);
+}
+
+} /* namespace */
+
+/**
+ * Bitmap whose size is set at runtime. Small bitmaps (up to 256 bits) are
+ * stored inline, bigger ones on the heap. Bits past the size are always
+ * cleared so that whole chunks can be compared, counted and hashed. Bulk
+ * operations use AVX2 or SSE2 when the compiler enables them.
+ */
+class bitmap
+{
+    public:
+    typedef uint64_t chunk_t;
+    struct const_bit_set_iterator;
+
+    static const size_t BITS_PER_CHUNKS = sizeof(chunk_t) * 8;
+    static const size_t INLINE_CHUNKS = 4;
+
+    bitmap()
+        :m_chunks(m_inline), m_nb_chunks(0), m_nb_bits(0)
     {
-        set_nb_bits(0);
     }
-    
-    bitmap_N(size_t nb_bits)
+
+    bitmap(size_t nb_bits)
+        :m_chunks(m_inline), m_nb_chunks(0), m_nb_bits(0)
     {
         set_nb_bits(nb_bits);
     }
 
+    bitmap(const bitmap& o)
+        :m_chunks(m_inline), m_nb_chunks(0), m_nb_bits(0)
+    {
+        resize_chunks(o.m_nb_chunks);
+        m_nb_bits = o.m_nb_bits;
+        memcpy(m_chunks, o.m_chunks, m_nb_chunks * sizeof(chunk_t));
+    }
+
+    ~bitmap()
+    {
+        if(m_chunks != m_inline)
+            delete[] m_chunks;
+    }
+
+    bitmap& operator=(const bitmap& o)
+    {
+        if(this != &o)
+        {
+            resize_chunks(o.m_nb_chunks);
+            m_nb_bits = o.m_nb_bits;
+            memcpy(m_chunks, o.m_chunks, m_nb_chunks * sizeof(chunk_t));
+        }
+        return *this;
+    }
+
+    /* NOTE: clears the bitmap */
     void set_nb_bits(size_t nb_bits)
     {
-        assert(nb_bits < BITS_PER_CHUNKS * MAX_CHUNKS && "bitmap is too small to handle such a number of bits");
+        resize_chunks((nb_bits + BITS_PER_CHUNKS - 1) / BITS_PER_CHUNKS);
         m_nb_bits = nb_bits;
-        m_nb_chunks = (nb_bits + BITS_PER_CHUNKS - 1) / BITS_PER_CHUNKS;
         clear();
     }
 
-    template< size_t N >
-    bool operator<(const bitmap_N< N >& o) const
+    size_t nb_bits() const
+    {
+        return m_nb_bits;
+    }
+
+    bool operator<(const bitmap& o) const
     {
         assert(o.m_nb_bits == m_nb_bits);
 
-        for(int i = m_nb_chunks - 1; i >= 0; i--)
+        for(size_t i = m_nb_chunks; i-- > 0;)
         {
-            if(m_chunks[i] < o.m_chunks[i])
-                return true;
-            else if(m_chunks[i] > o.m_chunks[i])
-                return false;
+            if(m_chunks[i] != o.m_chunks[i])
+                return m_chunks[i] < o.m_chunks[i];
         }
 
         return false;
@@ -129,36 +227,52 @@ struct bitmap_N
 
     void set_bit(size_t b)
     {
-        m_chunks[b / BITS_PER_CHUNKS] |= (uintmax_t)1 << (b % BITS_PER_CHUNKS);
+        assert(b < m_nb_bits);
+        m_chunks[b / BITS_PER_CHUNKS] |= (chunk_t)1 << (b % BITS_PER_CHUNKS);
     }
 
     void clear_bit(size_t b)
     {
-        m_chunks[b / BITS_PER_CHUNKS] &= ~((uintmax_t)1 << (b % BITS_PER_CHUNKS));
+        assert(b < m_nb_bits);
+        m_chunks[b / BITS_PER_CHUNKS] &= ~((chunk_t)1 << (b % BITS_PER_CHUNKS));
     }
 
     bool test_bit(size_t b) const
     {
-        return pasched::test_bit(m_chunks[b / BITS_PER_CHUNKS ], b % BITS_PER_CHUNKS);
+        assert(b < m_nb_bits);
+        return pasched::test_bit(m_chunks[b / BITS_PER_CHUNKS], b % BITS_PER_CHUNKS);
     }
 
-    template< size_t N >
-    bitmap_N< MAX_CHUNKS >& operator|=(const bitmap_N< N >& o)
+    bitmap& operator|=(const bitmap& o)
     {
         assert(m_nb_bits == o.m_nb_bits);
-        for(size_t i = 0; i < m_nb_chunks; i++)
-            m_chunks[i] |= o.m_chunks[i];
+        combine_chunks< bit_or_op >(m_chunks, o.m_chunks, m_nb_chunks);
+        return *this;
+    }
+
+    bitmap& operator&=(const bitmap& o)
+    {
+        assert(m_nb_bits == o.m_nb_bits);
+        combine_chunks< bit_and_op >(m_chunks, o.m_chunks, m_nb_chunks);
+        return *this;
+    }
+
+    /* clear all the bits set in o */
+    bitmap& and_not(const bitmap& o)
+    {
+        assert(m_nb_bits == o.m_nb_bits);
+        combine_chunks< bit_andnot_op >(m_chunks, o.m_chunks, m_nb_chunks);
         return *this;
     }
 
     void clear()
     {
-        memset(m_chunks, 0, sizeof m_chunks);
+        memset(m_chunks, 0, m_nb_chunks * sizeof(chunk_t));
     }
 
-    static size_t nbs(uintmax_t n)
+    static size_t nbs(chunk_t n)
     {
-        return popcount(n);
+        return popcount((unsigned long long)n);
     }
 
     size_t nb_bits_set() const
@@ -174,95 +288,124 @@ struct bitmap_N
         return m_nb_bits - nb_bits_set();
     }
 
-    template< size_t N >
-    bool operator==(const bitmap_N< N >& o) const
+    bool operator==(const bitmap& o) const
     {
         assert(o.m_nb_bits == m_nb_bits);
-        
-        for(size_t i = 0; i < m_nb_chunks; i++)
+        size_t i = 0;
+#if defined(__AVX2__)
+        for(; i + 4 <= m_nb_chunks; i += 4)
+        {
+            __m256i x = _mm256_xor_si256(
+                _mm256_loadu_si256((const __m256i *)(m_chunks + i)),
+                _mm256_loadu_si256((const __m256i *)(o.m_chunks + i)));
+            if(!_mm256_testz_si256(x, x))
+                return false;
+        }
+#elif defined(__SSE2__)
+        for(; i + 2 <= m_nb_chunks; i += 2)
+        {
+            __m128i x = _mm_cmpeq_epi8(
+                _mm_loadu_si128((const __m128i *)(m_chunks + i)),
+                _mm_loadu_si128((const __m128i *)(o.m_chunks + i)));
+            if(_mm_movemask_epi8(x) != 0xffff)
+                return false;
+        }
+#endif
+        for(; i < m_nb_chunks; i++)
             if(m_chunks[i] != o.m_chunks[i])
                 return false;
         return true;
     }
 
-    template< size_t N >
-    bool operator!=(const bitmap_N< N >& o) const
+    bool operator!=(const bitmap& o) const
     {
         return !operator==(o);
     }
 
-    const_bit_set_iterator bit_set_begin() const
+    size_t hash() const
     {
-        const_bit_set_iterator it(this, 0, 0);
-        if(!test_bit(0))
-            ++it;
-        return it;
+        uint64_t h = (uint64_t)m_nb_bits * 0x9e3779b97f4a7c15ULL;
+        for(size_t i = 0; i < m_nb_chunks; i++)
+        {
+            h = (h ^ m_chunks[i]) * 0xff51afd7ed558ccdULL;
+            h ^= h >> 32;
+        }
+        return (size_t)h;
     }
 
-    const_bit_set_iterator bit_set_end() const
+    /* position of the first bit set at or after b, or bit_set_end() position */
+    size_t find_next_bit_set(size_t b) const
     {
-        return const_bit_set_iterator(this, m_nb_chunks, 0);
+        size_t c = b / BITS_PER_CHUNKS;
+        if(c >= m_nb_chunks)
+            return m_nb_chunks * BITS_PER_CHUNKS;
+        chunk_t v = m_chunks[c] & (~(chunk_t)0 << (b % BITS_PER_CHUNKS));
+        while(v == 0)
+        {
+            if(++c == m_nb_chunks)
+                return m_nb_chunks * BITS_PER_CHUNKS;
+            v = m_chunks[c];
+        }
+        return c * BITS_PER_CHUNKS + find_first_bit_set(v);
     }
 
-    static const size_t BITS_PER_CHUNKS = sizeof(uintmax_t) * 8;
-    uintmax_t m_chunks[MAX_CHUNKS];
-    size_t m_nb_chunks;
-    size_t m_nb_bits;
-};
+    inline const_bit_set_iterator bit_set_begin() const;
+    inline const_bit_set_iterator bit_set_end() const;
 
-template< size_t MAX_CHUNKS >
-struct bitmap_N_const_bit_set_iterator
-{
-    bitmap_N_const_bit_set_iterator()
-        :m_bitmap(0) {}
-    bitmap_N_const_bit_set_iterator(const bitmap_N< MAX_CHUNKS > *b, size_t c_idx, size_t b_idx)
-        :m_bitmap(b), m_chunk_idx(c_idx), m_chunk_bit_idx(b_idx)
+    const chunk_t *chunks() const
+    {
+        return m_chunks;
+    }
+
+    size_t nb_chunks() const
     {
-        m_abs_bit_idx = c_idx * BITS_PER_CHUNKS + b_idx;
+        return m_nb_chunks;
     }
 
-    bitmap_N_const_bit_set_iterator& operator++()
+    protected:
+    /* NOTE: the content is undefined afterwards */
+    void resize_chunks(size_t nb_chunks)
     {
-        /* special starting case */
-        if(m_chunk_idx == 0 && m_chunk_bit_idx == 0 && m_bitmap->m_chunks[0] == 0)
-            goto Ladv_chunk;
-        /* advance in the chunk, if possible */
-        m_chunk_bit_idx++;
-        if(m_chunk_bit_idx < BITS_PER_CHUNKS)
+        if(nb_chunks <= INLINE_CHUNKS)
         {
-            /* we are still in the chunk, see if we are past the last bit set */
-            if(m_chunk_bit_idx <= find_last_bit_set(m_bitmap->m_chunks[m_chunk_idx]))
-            {
-                /* find next bit set in the chunk */
-                m_chunk_bit_idx = find_next_bit_set(m_bitmap->m_chunks[m_chunk_idx], m_chunk_bit_idx);
-                goto Lend;
-            }
-            /* fallback */
+            if(m_chunks != m_inline)
+                delete[] m_chunks;
+            m_chunks = m_inline;
+        }
+        else if(nb_chunks != m_nb_chunks)
+        {
+            if(m_chunks != m_inline)
+                delete[] m_chunks;
+            m_chunks = new chunk_t[nb_chunks];
         }
-        Ladv_chunk:
-        /* advance to next chunk */
-        m_chunk_idx++;
-        m_chunk_bit_idx = 0;
-        while(m_chunk_idx < m_bitmap->m_nb_chunks && m_bitmap->m_chunks[m_chunk_idx] == 0)
-            m_chunk_idx++;
-        /* still there ? */
-        if(m_chunk_idx < m_bitmap->m_nb_chunks)
-            /* find first bit set */
-            m_chunk_bit_idx = find_first_bit_set(m_bitmap->m_chunks[m_chunk_idx]);
-
-        Lend:
-        /* compute absolute position */
-        m_abs_bit_idx = m_chunk_idx * BITS_PER_CHUNKS + m_chunk_bit_idx;
+        m_nb_chunks = nb_chunks;
+    }
 
+    chunk_t m_inline[INLINE_CHUNKS];
+    chunk_t *m_chunks;
+    size_t m_nb_chunks;
+    size_t m_nb_bits;
+};
+
+struct bitmap::const_bit_set_iterator
+{
+    const_bit_set_iterator()
+        :m_bitmap(0), m_abs_bit_idx(0) {}
+    const_bit_set_iterator(const bitmap *b, size_t idx)
+        :m_bitmap(b), m_abs_bit_idx(idx) {}
+
+    const_bit_set_iterator& operator++()
+    {
+        m_abs_bit_idx = m_bitmap->find_next_bit_set(m_abs_bit_idx + 1);
         return *this;
     }
 
-    bool operator==(const bitmap_N_const_bit_set_iterator& o) const
+    bool operator==(const const_bit_set_iterator& o) const
     {
         return m_bitmap == o.m_bitmap && m_abs_bit_idx == o.m_abs_bit_idx;
     }
 
-    bool operator!=(const bitmap_N_const_bit_set_iterator& o) const
+    bool operator!=(const const_bit_set_iterator& o) const
     {
         return !operator==(o);
     }
@@ -272,14 +415,336 @@ struct bitmap_N_const_bit_set_iterator
         return m_abs_bit_idx;
     }
 
-    static const size_t BITS_PER_CHUNKS = bitmap_N< MAX_CHUNKS >::BITS_PER_CHUNKS;
-    const bitmap_N< MAX_CHUNKS > *m_bitmap;
-    size_t m_chunk_idx;
-    size_t m_chunk_bit_idx;
+    const bitmap *m_bitmap;
     size_t m_abs_bit_idx;
 };
 
-typedef bitmap_N< 100 > bitmap; /* should be sufficient for all cases */
+inline bitmap::const_bit_set_iterator bitmap::bit_set_begin() const
+{
+    return const_bit_set_iterator(this, find_next_bit_set(0));
+}
+
+inline bitmap::const_bit_set_iterator bitmap::bit_set_end() const
+{
+    return const_bit_set_iterator(this, m_nb_chunks * BITS_PER_CHUNKS);
+}
+
+/**
+ * Bitmap of at most NB_CHUNKS chunks, with the same interface as bitmap.
+ * The number of chunks is known at compile time so the whole bitmap is a few
+ * words and the loops on chunks are unrolled.
+ */
+template< size_t NB_CHUNKS >
+class fixed_bitmap
+{
+    public:
+    typedef uint64_t chunk_t;
+
+    static const size_t BITS_PER_CHUNKS = sizeof(chunk_t) * 8;
+
+    fixed_bitmap()
+        :m_nb_bits(0)
+    {
+        clear();
+    }
+
+    fixed_bitmap(size_t nb_bits)
+    {
+        set_nb_bits(nb_bits);
+    }
+
+    void set_nb_bits(size_t nb_bits)
+    {
+        assert(nb_bits <= NB_CHUNKS * BITS_PER_CHUNKS && "Too many bits for fixed_bitmap");
+        m_nb_bits = nb_bits;
+        clear();
+    }
+
+    size_t nb_bits() const
+    {
+        return m_nb_bits;
+    }
+
+    void set_bit(size_t b)
+    {
+        assert(b < m_nb_bits);
+        m_chunks[b / BITS_PER_CHUNKS] |= (chunk_t)1 << (b % BITS_PER_CHUNKS);
+    }
+
+    void clear_bit(size_t b)
+    {
+        assert(b < m_nb_bits);
+        m_chunks[b / BITS_PER_CHUNKS] &= ~((chunk_t)1 << (b % BITS_PER_CHUNKS));
+    }
+
+    bool test_bit(size_t b) const
+    {
+        assert(b < m_nb_bits);
+        return pasched::test_bit(m_chunks[b / BITS_PER_CHUNKS], b % BITS_PER_CHUNKS);
+    }
+
+    void clear()
+    {
+        for(size_t i = 0; i < NB_CHUNKS; i++)
+            m_chunks[i] = 0;
+    }
+
+    size_t nb_bits_set() const
+    {
+        size_t cnt = 0;
+        for(size_t i = 0; i < NB_CHUNKS; i++)
+            cnt += popcount((unsigned long long)m_chunks[i]);
+        return cnt;
+    }
+
+    /* position of the first bit set at or after b, or NB_CHUNKS * BITS_PER_CHUNKS */
+    size_t find_next_bit_set(size_t b) const
+    {
+        size_t c = b / BITS_PER_CHUNKS;
+        if(c >= NB_CHUNKS)
+            return NB_CHUNKS * BITS_PER_CHUNKS;
+        chunk_t v = m_chunks[c] & (~(chunk_t)0 << (b % BITS_PER_CHUNKS));
+        while(v == 0)
+        {
+            if(++c == NB_CHUNKS)
+                return NB_CHUNKS * BITS_PER_CHUNKS;
+            v = m_chunks[c];
+        }
+        return c * BITS_PER_CHUNKS + find_first_bit_set(v);
+    }
+
+    const chunk_t *chunks() const
+    {
+        return m_chunks;
+    }
+
+    size_t nb_chunks() const
+    {
+        return NB_CHUNKS;
+    }
+
+    protected:
+    chunk_t m_chunks[NB_CHUNKS];
+    size_t m_nb_bits;
+};
+
+/**
+ * Matrix of bits stored row by row in a contiguous array, each row being
+ * padded to a whole number of chunks. Padding bits are always cleared.
+ */
+class bit_matrix
+{
+    public:
+    typedef uint64_t chunk_t;
+
+    static const size_t BITS_PER_CHUNKS = sizeof(chunk_t) * 8;
+
+    bit_matrix()
+        :m_nb_rows(0), m_nb_cols(0), m_chunks_per_row(0) {}
+
+    bit_matrix(size_t nb_rows, size_t nb_cols)
+    {
+        resize(nb_rows, nb_cols);
+    }
+
+    /* NOTE: clears the matrix */
+    void resize(size_t nb_rows, size_t nb_cols)
+    {
+        m_nb_rows = nb_rows;
+        m_nb_cols = nb_cols;
+        m_chunks_per_row = (nb_cols + BITS_PER_CHUNKS - 1) / BITS_PER_CHUNKS;
+        m_chunks.assign(m_nb_rows * m_chunks_per_row, 0);
+    }
+
+    void clear()
+    {
+        std::fill(m_chunks.begin(), m_chunks.end(), 0);
+    }
+
+    void swap(bit_matrix& o)
+    {
+        std::swap(m_nb_rows, o.m_nb_rows);
+        std::swap(m_nb_cols, o.m_nb_cols);
+        std::swap(m_chunks_per_row, o.m_chunks_per_row);
+        m_chunks.swap(o.m_chunks);
+    }
+
+    size_t nb_rows() const
+    {
+        return m_nb_rows;
+    }
+
+    size_t nb_cols() const
+    {
+        return m_nb_cols;
+    }
+
+    size_t chunks_per_row() const
+    {
+        return m_chunks_per_row;
+    }
+
+    bool test_bit(size_t r, size_t c) const
+    {
+        assert(r < m_nb_rows && c < m_nb_cols);
+        return pasched::test_bit(row(r)[c / BITS_PER_CHUNKS], c % BITS_PER_CHUNKS);
+    }
+
+    void set_bit(size_t r, size_t c)
+    {
+        assert(r < m_nb_rows && c < m_nb_cols);
+        row(r)[c / BITS_PER_CHUNKS] |= (chunk_t)1 << (c % BITS_PER_CHUNKS);
+    }
+
+    void clear_bit(size_t r, size_t c)
+    {
+        assert(r < m_nb_rows && c < m_nb_cols);
+        row(r)[c / BITS_PER_CHUNKS] &= ~((chunk_t)1 << (c % BITS_PER_CHUNKS));
+    }
+
+    /* row dst |= row src */
+    void or_row(size_t dst, size_t src)
+    {
+        combine_chunks< bit_or_op >(row(dst), row(src), m_chunks_per_row);
+    }
+
+    size_t nb_bits_set_in_row(size_t r) const
+    {
+        size_t cnt = 0;
+        for(size_t i = 0; i < m_chunks_per_row; i++)
+            cnt += popcount((unsigned long long)row(r)[i]);
+        return cnt;
+    }
+
+    chunk_t *row(size_t r)
+    {
+        return &m_chunks[r * m_chunks_per_row];
+    }
+
+    const chunk_t *row(size_t r) const
+    {
+        return &m_chunks[r * m_chunks_per_row];
+    }
+
+    protected:
+    size_t m_nb_rows;
+    size_t m_nb_cols;
+    size_t m_chunks_per_row;
+    std::vector< chunk_t > m_chunks;
+};
+
+/**
+ * Hash table mapping pointers to indexes. It uses open addressing with linear
+ * probing and removal shifts the following entries back, so there are no
+ * tombstones and lookups stay short.
+ */
+class ptr_index_map
+{
+    public:
+    ptr_index_map()
+        :m_size(0) {}
+
+    size_t size() const
+    {
+        return m_size;
+    }
+
+    void clear()
+    {
+        m_keys.clear();
+        m_values.clear();
+        m_size = 0;
+    }
+
+    bool find(const void *p, size_t& idx) const
+    {
+        if(m_keys.empty())
+            return false;
+        size_t mask = m_keys.size() - 1;
+        for(size_t i = hash(p) & mask; m_keys[i] != 0; i = (i + 1) & mask)
+            if(m_keys[i] == p)
+            {
+                idx = m_values[i];
+                return true;
+            }
+        return false;
+    }
+
+    /* insert or update */
+    void set(const void *p, size_t idx)
+    {
+        assert(p != 0 && "null pointers cannot be stored in a ptr_index_map");
+        if(2 * (m_size + 1) > m_keys.size())
+            rehash(m_keys.empty() ? 16 : 2 * m_keys.size());
+        size_t mask = m_keys.size() - 1;
+        size_t i = hash(p) & mask;
+        while(m_keys[i] != 0 && m_keys[i] != p)
+            i = (i + 1) & mask;
+        if(m_keys[i] == 0)
+        {
+            m_keys[i] = p;
+            m_size++;
+        }
+        m_values[i] = idx;
+    }
+
+    void erase(const void *p)
+    {
+        if(m_keys.empty())
+            return;
+        size_t mask = m_keys.size() - 1;
+        size_t i = hash(p) & mask;
+        while(m_keys[i] != p)
+        {
+            if(m_keys[i] == 0)
+                return;
+            i = (i + 1) & mask;
+        }
+        /* shift back the entries of the cluster which cannot be reached anymore */
+        for(size_t j = (i + 1) & mask; m_keys[j] != 0; j = (j + 1) & mask)
+        {
+            size_t k = hash(m_keys[j]) & mask;
+            /* skip entry if its home slot lies cyclically in (i,j] */
+            if(i <= j ? (i < k && k <= j) : (i < k || k <= j))
+                continue;
+            m_keys[i] = m_keys[j];
+            m_values[i] = m_values[j];
+            i = j;
+        }
+        m_keys[i] = 0;
+        m_size--;
+    }
+
+    protected:
+    static size_t hash(const void *p)
+    {
+        uint64_t h = (uint64_t)(uintptr_t)p * 0x9e3779b97f4a7c15ULL;
+        return (size_t)(h ^ (h >> 32));
+    }
+
+    void rehash(size_t new_size)
+    {
+        std::vector< const void * > keys(new_size, (const void *)0);
+        std::vector< size_t > values(new_size);
+        size_t mask = new_size - 1;
+        for(size_t j = 0; j < m_keys.size(); j++)
+        {
+            if(m_keys[j] == 0)
+                continue;
+            size_t i = hash(m_keys[j]) & mask;
+            while(keys[i] != 0)
+                i = (i + 1) & mask;
+            keys[i] = m_keys[j];
+            values[i] = m_values[j];
+        }
+        m_keys.swap(keys);
+        m_values.swap(values);
+    }
+
+    std::vector< const void * > m_keys;
+    std::vector< size_t > m_values;
+    size_t m_size;
+};
 
 }
 
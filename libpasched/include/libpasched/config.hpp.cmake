@@ -3,7 +3,7 @@
 
 #define PAMAURY_SCHEDULER_NS    pasched
 
-#cmakedefine HAS_SYMHPONY
+#cmakedefine HAS_SYMPHONY
 #cmakedefine ENABLE_DAG_AUTO_CHECK_CONSISTENCY
 #cmakedefine ENABLE_SCHED_AUTO_CHECK_RP
 #cmakedefine ENABLE_EXPENSIVE_SCHED_AUTO_CHECK_RP
@@ -11,6 +11,7 @@
 #cmakedefine ENABLE_XFORM_TIME_STAT
 #cmakedefine ENABLE_SCHED_TIME_STAT
 #cmakedefine ENABLE_MISC_TIME_STAT
+#cmakedefine ENABLE_THREADS
 
 #ifdef ENABLE_XFORM_TIME_STAT
 #define XTM_STAT(a) a
@@ -0,0 +1,244 @@
+#ifndef __PAMAURY_ILP_HPP__
+#define __PAMAURY_ILP_HPP__
+
+#include "config.hpp"
+#include "time-tools.hpp"
+#include <string>
+#include <vector>
+#include <istream>
+
+namespace PAMAURY_SCHEDULER_NS
+{
+
+/**
+ * Integer linear program to minimize. Rows and columns are numbered from 1
+ * like in GLPK and a row is lb <= sum(coef * column) <= ub, the bound type
+ * tells which sides apply. The names are only kept if the problem is created
+ * with names, so that large models do not pay for them.
+ */
+class ilp_problem
+{
+    public:
+    enum col_kind
+    {
+        continuous_col,
+        integer_col,
+        /* integer between 0 and 1 whatever the bounds */
+        binary_col
+    };
+
+    enum bound_type
+    {
+        free_bnd,
+        lower_bnd,
+        upper_bnd,
+        double_bnd,
+        fixed_bnd
+    };
+
+    ilp_problem(bool with_names = false);
+    ~ilp_problem();
+
+    void reserve(size_t nb_rows, size_t nb_nz);
+    int add_col(col_kind kind, bound_type type, double lb, double ub);
+    void set_obj_coef(int col, double coef);
+    /* cols and coefs have len entries, starting at index 0 */
+    int add_row(bound_type type, double lb, double ub, size_t len, const int *cols, const double *coefs);
+    /* printf-like, does nothing without names or on row 0 so that the rows
+     * dropped by the caller need no check */
+    void set_col_name(int col, const char *fmt, ...);
+    void set_row_name(int row, const char *fmt, ...);
+
+    bool has_names() const;
+    size_t get_col_count() const;
+    size_t get_row_count() const;
+    col_kind get_col_kind(int col) const;
+    bound_type get_col_type(int col) const;
+    double get_col_lb(int col) const;
+    double get_col_ub(int col) const;
+    double get_obj_coef(int col) const;
+    /* empty if it has no name */
+    std::string get_col_name(int col) const;
+    bound_type get_row_type(int row) const;
+    double get_row_lb(int row) const;
+    double get_row_ub(int row) const;
+    std::string get_row_name(int row) const;
+    /* the coefficients as (row, column, value) triplets, the first entry is
+     * unused like in glp_load_matrix */
+    const std::vector< int >& get_nz_rows() const;
+    const std::vector< int >& get_nz_cols() const;
+    const std::vector< double >& get_nz_values() const;
+
+    protected:
+    struct col_t
+    {
+        col_kind kind;
+        bound_type type;
+        double lb;
+        double ub;
+        double obj;
+    };
+
+    struct row_t
+    {
+        bound_type type;
+        double lb;
+        double ub;
+    };
+
+    bool m_with_names;
+    std::vector< col_t > m_cols;
+    std::vector< row_t > m_rows;
+    std::vector< int > m_nz_rows;
+    std::vector< int > m_nz_cols;
+    std::vector< double > m_nz_values;
+    std::vector< std::string > m_col_names;
+    std::vector< std::string > m_row_names;
+};
+
+/**
+ * Rows left out of a problem because there are too many of them, the backend
+ * asks for the ones violated by the solutions it meets. An integer solution
+ * which violates none of them must satisfy all of them.
+ */
+class ilp_separator
+{
+    public:
+    virtual ~ilp_separator() {}
+
+    /* x[1..nb_cols] is a solution of a relaxation, add the rows it violates to
+     * rows, which has no columns of its own, and return how many were added */
+    virtual size_t separate(const std::vector< double >& x, ilp_problem& rows) const = 0;
+};
+
+/**
+ * Interface to an ILP solver, the scheduler builds the problem and the backend
+ * solves it.
+ */
+class ilp_backend
+{
+    public:
+    enum status
+    {
+        /* the solution is optimal */
+        optimal,
+        /* the budget was exhausted before the optimum was found */
+        exhausted,
+        /* solver error, infeasible problem... */
+        failed
+    };
+
+    virtual ~ilp_backend() {}
+
+    /* if false, the separator is ignored and all the rows must be in the problem */
+    virtual bool has_lazy_rows() const { return false; }
+    /* if true, the problem is worth naming */
+    virtual bool uses_names() const { return false; }
+    /* incumbent is empty or a feasible solution to start from, the separator can
+     * be 0, the solution is stored in x[1..nb_cols]. When the budget is exhausted,
+     * x is the best integer solution found if it is not empty */
+    virtual status solve(const ilp_problem& pb, const std::vector< double >& incumbent,
+        const ilp_separator *sep, budget_meter& meter, bool verbose,
+        std::vector< double >& x) const = 0;
+};
+
+/**
+ * Branch and cut of GLPK, the work of the budget is the number of branch and
+ * bound nodes.
+ */
+class glpk_ilp_backend : public ilp_backend
+{
+    public:
+    glpk_ilp_backend();
+    virtual ~glpk_ilp_backend();
+
+    virtual bool has_lazy_rows() const;
+    virtual status solve(const ilp_problem& pb, const std::vector< double >& incumbent,
+        const ilp_separator *sep, budget_meter& meter, bool verbose,
+        std::vector< double >& x) const;
+};
+
+#ifdef HAS_SYMPHONY
+/**
+ * Branch, cut and price of SYMPHONY through an MPS file, only the time of the
+ * budget is limited and there is no incumbent.
+ */
+class symphony_ilp_backend : public ilp_backend
+{
+    public:
+    symphony_ilp_backend();
+    virtual ~symphony_ilp_backend();
+
+    virtual status solve(const ilp_problem& pb, const std::vector< double >& incumbent,
+        const ilp_separator *sep, budget_meter& meter, bool verbose,
+        std::vector< double >& x) const;
+};
+#endif
+
+/**
+ * Solve with an external program: each problem is written to <prefix>-<i>.mps
+ * (or .lp) where i counts the problems, the command is run by the shell with
+ * %m replaced by the problem file and %s by the solution file <prefix>-<i>.sol,
+ * then the solution is read in the CPLEX XML format. Without a command, the
+ * solution is read if it exists: the problems of a first run can be solved
+ * offline and a second run with the same inputs picks up the solutions.
+ * A solution which is not proven optimal is reported as exhausted, and the
+ * solution must give a value to every column. The budget is not enforced.
+ */
+class file_ilp_backend : public ilp_backend
+{
+    public:
+    enum file_format
+    {
+        mps_format,
+        lp_format
+    };
+
+    file_ilp_backend(const std::string& prefix, file_format format = mps_format,
+        const std::string& command = "");
+    virtual ~file_ilp_backend();
+
+    virtual bool uses_names() const;
+    virtual status solve(const ilp_problem& pb, const std::vector< double >& incumbent,
+        const ilp_separator *sep, budget_meter& meter, bool verbose,
+        std::vector< double >& x) const;
+
+    protected:
+    std::string m_prefix;
+    file_format m_format;
+    std::string m_command;
+    mutable unsigned m_nb_problems;
+};
+
+/**
+ * Solution in the CPLEX XML format, the constraints and variables are in the
+ * order of the file.
+ */
+struct cplex_solution
+{
+    enum status_t
+    {
+        /* no status in the file */
+        unknown_status,
+        optimal_status,
+        /* a solution which is not proven optimal */
+        feasible_status,
+        /* no solution: infeasible, unbounded or stopped before finding one */
+        infeasible_status
+    };
+
+    /* from solutionStatusValue, or solutionStatusString without a value */
+    status_t status;
+    double obj;
+    std::vector< std::string > row_names;
+    std::vector< double > row_slacks;
+    std::vector< std::string > col_names;
+    std::vector< double > col_values;
+};
+
+/* return false if the objective value is missing */
+bool read_cplex_solution(std::istream& in, cplex_solution& sol);
+
+}
+
+#endif // __PAMAURY_ILP_HPP__
@@ -4,12 +4,109 @@
 #include <vector>
 #include <map>
 #include <set>
+#include <algorithm>
 #include "config.hpp"
 #include "sched-unit.hpp"
+#include "adt.hpp"
 
 namespace PAMAURY_SCHEDULER_NS
 {
 
+/**
+ * Read-only view of a contiguous list of dependencies, as returned by
+ * get_succs() and get_preds(). Like any pointer obtained from the graph,
+ * it is invalidated by any change to the graph.
+ */
+class schedule_dep_range
+{
+    public:
+    typedef const schedule_dep *const_iterator;
+
+    schedule_dep_range()
+        :m_begin(0), m_end(0) {}
+    schedule_dep_range(const schedule_dep *begin, const schedule_dep *end)
+        :m_begin(begin), m_end(end) {}
+    schedule_dep_range(const std::vector< schedule_dep >& v)
+        :m_begin(v.empty() ? 0 : &v[0]), m_end(v.empty() ? 0 : &v[0] + v.size()) {}
+
+    size_t size() const { return m_end - m_begin; }
+    bool empty() const { return m_begin == m_end; }
+    const schedule_dep& operator[](size_t i) const { return m_begin[i]; }
+    const_iterator begin() const { return m_begin; }
+    const_iterator end() const { return m_end; }
+
+    protected:
+    const schedule_dep *m_begin;
+    const schedule_dep *m_end;
+};
+
+class schedule_dag;
+class reachability_index;
+
+/**
+ * Interface to be notified of the changes of a DAG
+ */
+class schedule_dag_listener
+{
+    public:
+    virtual ~schedule_dag_listener() {}
+
+    virtual void unit_added(const schedule_dag& dag, const schedule_unit *unit) = 0;
+    /* called before the unit and its dependencies are removed */
+    virtual void unit_removed(const schedule_dag& dag, const schedule_unit *unit) = 0;
+    virtual void dependency_added(const schedule_dag& dag, const schedule_dep& dep) = 0;
+    /* called after the dependency is removed */
+    virtual void dependency_removed(const schedule_dag& dag, const schedule_dep& dep) = 0;
+    /* called by fuse_units() instead of notifying each change */
+    virtual void units_fused(const schedule_dag& dag, const schedule_unit *a,
+        const schedule_unit *b, const schedule_unit *c) = 0;
+    virtual void cleared(const schedule_dag& dag) = 0;
+};
+
+/**
+ * Reusable workspace for graph traversals
+ * Units are marked as visited by stamping their index with the epoch of the
+ * current traversal, so starting a traversal does not clear anything and,
+ * once the workspace has grown to the size of the graph, does not allocate.
+ */
+class traversal_scratch
+{
+    public:
+    traversal_scratch();
+
+    /* start a new traversal on a graph of nb_units units */
+    void begin(size_t nb_units);
+    /* mark an index as visited, return false if it already was */
+    bool visit(size_t idx)
+    {
+        assert(idx < m_stamp.size());
+        if(m_stamp[idx] == m_epoch)
+            return false;
+        m_stamp[idx] = m_epoch;
+        return true;
+    }
+    bool visited(size_t idx) const { return m_stamp[idx] == m_epoch; }
+
+    protected:
+    std::vector< unsigned > m_stamp;
+    unsigned m_epoch;
+    std::vector< const schedule_unit * > m_queue;
+
+    friend class schedule_dag;
+};
+
+/**
+ * Callback for the traversal functions of the DAG
+ * NOTE: the graph must not be modified during the traversal
+ */
+class schedule_unit_visitor
+{
+    public:
+    virtual ~schedule_unit_visitor() {}
+
+    virtual void visit(const schedule_unit *unit) = 0;
+};
+
 /**
  * Represent a DAG to schedule with all the data and order dependencies
  */
@@ -17,6 +114,7 @@ class schedule_dag
 {
     public:
     schedule_dag();
+    schedule_dag(const schedule_dag& dag);
     virtual ~schedule_dag();
 
     /**
@@ -33,10 +131,19 @@ class schedule_dag
     virtual const std::vector< const schedule_unit * >& get_leaves() const = 0;
     virtual const std::vector< const schedule_unit * >& get_units() const = 0;
 
-    virtual const std::vector< schedule_dep >& get_succs(const schedule_unit *su) const = 0;
-    virtual const std::vector< schedule_dep >& get_preds(const schedule_unit *su) const = 0;
+    virtual schedule_dep_range get_succs(const schedule_unit *su) const = 0;
+    virtual schedule_dep_range get_preds(const schedule_unit *su) const = 0;
     virtual const std::vector< schedule_dep >& get_deps() const = 0;
 
+    /** Dense unit indexes
+     * The index of a unit is its position in get_units(). Adding a unit gives
+     * it the next index and removing a unit moves the last unit to its index,
+     * so indexes are stable as long as no unit is removed and algorithms can
+     * use plain vectors instead of maps keyed by units.
+     * NOTE: the unit must be in the graph */
+    virtual size_t index_of(const schedule_unit *unit) const = 0;
+    const schedule_unit *unit_at(size_t idx) const { return get_units()[idx]; }
+
     /** State */
     /* keep track of modification state */
     virtual bool modified() const = 0;
@@ -55,6 +162,24 @@ class schedule_dag
      * If several dependencies match the old one, only once is modified */
     virtual void modify_dep(const schedule_dep& old, const schedule_dep& cur);
 
+    /** Batched modifications
+     * Between begin_batch() and commit(), the roots and leaves lists are
+     * not maintained (they are rebuilt if asked for), the modification flag
+     * is only updated at commit and the automatic consistency check, if
+     * enabled, is done once at commit instead of after every change.
+     * Batches can be nested, only the outermost commit() has an effect. */
+    void begin_batch();
+    void commit();
+    bool in_batch() const { return m_batch_depth != 0; }
+
+    /** Listeners
+     * Listeners are notified of each change of the graph. They are not
+     * copied with the graph and must be removed before being destroyed. */
+    void add_listener(schedule_dag_listener *l) const;
+    void remove_listener(schedule_dag_listener *l) const;
+    /* reachability index attached to the graph, if any */
+    const reachability_index *get_reachability_index() const { return m_reach_index; }
+
     /** Massive unit/dev add/removal */
     virtual void add_dependencies(const std::vector< schedule_dep >& deps);
     virtual void remove_dependencies(const std::vector< schedule_dep >& deps);
@@ -80,9 +205,43 @@ class schedule_dag
 
     virtual std::set< const schedule_unit * > get_reachable(
         const schedule_unit *unit, unsigned flags) const;
+    /* same as above but without allocation: the units are passed to the
+     * visitor, or appended to out, in breadth first order */
+    void visit_reachable(const schedule_unit *unit, unsigned flags,
+        traversal_scratch& scratch, schedule_unit_visitor& v) const;
+    void get_reachable(const schedule_unit *unit, unsigned flags,
+        traversal_scratch& scratch, std::vector< const schedule_unit * >& out) const;
+    /* number of distinct immediate predecessors (resp. successors) following
+     * the pred (resp. succ) kinds of flags, ie the size of
+     * get_reachable(unit, flags | rf_immediate), in O(degree) */
+    size_t count_distinct_preds(const schedule_unit *unit, unsigned flags = rf_follow_preds) const;
+    size_t count_distinct_succs(const schedule_unit *unit, unsigned flags = rf_follow_succs) const;
 
     /** Helper functions for register information */
 
+    typedef std::vector< schedule_dep::reg_t > reg_list;
+    /**
+     * Registers of a unit, as sorted lists without duplicates
+     */
+    struct reg_info
+    {
+        reg_list create; /* see get_reg_create */
+        reg_list phys_create;
+        reg_list virt_create;
+        reg_list use; /* see get_reg_use */
+        reg_list phys_use;
+        reg_list virt_use;
+        reg_list destroy; /* see get_reg_destroy */
+    };
+
+    /**
+     * Return the register information of a unit. It is computed on demand
+     * and cached, the cache being updated incrementally as the graph changes.
+     *
+     * NOTE: the reference is invalidated by any change of the graph
+     */
+    const reg_info& get_reg_info(const schedule_unit *unit) const;
+
     /**
      * Compute the set of register created by a schedule unit
      */
@@ -129,6 +288,12 @@ class schedule_dag
      */
     virtual std::set< schedule_dep::reg_t > get_reg_dont_destroy_exact(
         const schedule_unit *unit) const;
+    /**
+     * Same as get_reg_destroy_exact and get_reg_dont_destroy_exact but
+     * the result is stored as a sorted list in out
+     */
+    void get_reg_destroy_exact(const schedule_unit *unit, reg_list& out) const;
+    void get_reg_dont_destroy_exact(const schedule_unit *unit, reg_list& out) const;
 
     /**
      * Fuse two units by removing them from the graph and replacing
@@ -148,6 +313,8 @@ class schedule_dag
 
     /**
      * Duplicate a subgraph of the DAG given by a set of nodes.
+     *
+     * NOTE: use a subgraph_schedule_dag to avoid the copy
      */
     virtual schedule_dag *dup_subgraph(const std::set< const schedule_unit * >& units) const;
 
@@ -172,15 +339,92 @@ class schedule_dag
 
     /**
      * Build a path map for the entire graph.
-     * It builds to objects: first a 2D-table of boolean and second a map.
-     * The [index->unit] map is the one returned by get_units() and the
-     * [unit->index] map is the one built by this function.
+     * It builds a bit matrix indexed by the unit indexes (see index_of),
+     * path_map.test_bit(index_of(a), index_of(b)) is true if and only if
+     * there is a path from a to b (there is always a path from a unit to
+     * itself). Rows are computed in reverse topological order by or'ing the
+     * rows of the successors, column ranges being split between threads on
+     * large graphs.
      *
-     * NOTE: the input table is resized and the name map is cleared */
-    virtual void build_path_map(std::vector< std::vector< bool > >& path_map,
-        std::map< const schedule_unit *, size_t >& name_map) const;
+     * NOTE: the input matrix is resized */
+    virtual void build_path_map(bit_matrix& path_map) const;
 
     virtual bool is_consistent(std::string *out_msg = 0) const = 0;
+
+    protected:
+    /* to be called by implementations after each change of the graph: sets
+     * the modification flag and checks consistency, or records the change
+     * for commit() when in a batch */
+    void end_change(const char *what, bool modified = true);
+    /* called when the outermost batch is committed */
+    virtual void end_batch();
+
+    /* to be called by implementations on each change of the graph */
+    void notify_unit_added(const schedule_unit *unit);
+    void notify_unit_removed(const schedule_unit *unit);
+    void notify_dependency_added(const schedule_dep& dep);
+    void notify_dependency_removed(const schedule_dep& dep);
+    /* the kind or register of the dependency changed */
+    void notify_dependency_modified(const schedule_dep& dep);
+    void notify_cleared();
+
+    /* register information cache, empty if get_reg_info() was never
+     * called, indexed by unit index otherwise */
+    struct reg_info_entry
+    {
+        reg_info_entry():def_use_valid(false), destroy_valid(false) {}
+
+        void swap(reg_info_entry& o)
+        {
+            info.create.swap(o.info.create);
+            info.phys_create.swap(o.info.phys_create);
+            info.virt_create.swap(o.info.virt_create);
+            info.use.swap(o.info.use);
+            info.phys_use.swap(o.info.phys_use);
+            info.virt_use.swap(o.info.virt_use);
+            info.destroy.swap(o.info.destroy);
+            std::swap(def_use_valid, o.def_use_valid);
+            std::swap(destroy_valid, o.destroy_valid);
+        }
+
+        reg_info info;
+        bool def_use_valid;
+        bool destroy_valid;
+    };
+
+    void reg_info_invalidate(const schedule_unit *unit, bool def_use) const;
+    void reg_info_invalidate_users(const schedule_unit *unit) const;
+    void reg_info_dependency_changed(const schedule_dep& dep) const;
+    void reg_info_unit_removed(const schedule_unit *unit) const;
+
+    size_t m_batch_depth;
+    bool m_batch_changed;
+    bool m_batch_modified;
+    mutable std::vector< schedule_dag_listener * > m_listeners;
+    /* notifications are held while fuse_units() is running */
+    size_t m_notify_hold;
+    mutable const reachability_index *m_reach_index;
+    /* workspace of count_distinct_preds/succs */
+    mutable traversal_scratch m_count_scratch;
+    /* workspace of get_reg_destroy_exact/get_reg_dont_destroy_exact */
+    mutable traversal_scratch m_reach_scratch;
+    mutable std::vector< const schedule_unit * > m_reach_units;
+    mutable std::vector< reg_info_entry > m_reg_info;
+
+    friend class reachability_index;
+};
+
+/**
+ * Run the modifications done in a scope as a batch
+ */
+class schedule_dag_batch
+{
+    public:
+    schedule_dag_batch(schedule_dag& dag) : m_dag(dag) { m_dag.begin_batch(); }
+    ~schedule_dag_batch() { m_dag.commit(); }
+
+    protected:
+    schedule_dag& m_dag;
 };
 
 /**
@@ -194,14 +438,16 @@ class generic_schedule_dag : public schedule_dag
 
     virtual generic_schedule_dag *dup() const;
 
-    virtual const std::vector< const schedule_unit *>& get_roots() const { return m_roots; }
-    virtual const std::vector< const schedule_unit *>& get_leaves() const { return m_leaves; }
+    virtual const std::vector< const schedule_unit *>& get_roots() const { if(m_ends_dirty) rebuild_ends(); return m_roots; }
+    virtual const std::vector< const schedule_unit *>& get_leaves() const { if(m_ends_dirty) rebuild_ends(); return m_leaves; }
     virtual const std::vector< const schedule_unit *>& get_units() const { return m_units; }
 
-    virtual const std::vector< schedule_dep >& get_succs(const schedule_unit *su) const { return m_unit_map[su].succs; }
-    virtual const std::vector< schedule_dep >& get_preds(const schedule_unit *su) const { return m_unit_map[su].preds; }
+    virtual schedule_dep_range get_succs(const schedule_unit *su) const { return m_unit_map[su].succs; }
+    virtual schedule_dep_range get_preds(const schedule_unit *su) const { return m_unit_map[su].preds; }
     virtual const std::vector< schedule_dep >& get_deps() const { return m_deps; }
 
+    virtual size_t index_of(const schedule_unit *unit) const;
+
     virtual bool modified() const;
     virtual void set_modified(bool mod);
 
@@ -218,17 +464,216 @@ class generic_schedule_dag : public schedule_dag
     protected:
     struct su_data
     {
+        su_data():root_pos(0), leaf_pos(0) {}
+
         std::vector< schedule_dep > preds, succs;
+        /* position of each dependency in the master list */
+        std::vector< size_t > pred_pos, succ_pos;
+        /* position in the roots list (only valid if there are no predecessors)
+         * and in the leaves list (only valid if there are no successors) */
+        size_t root_pos, leaf_pos;
     };
-    
+
+    virtual void end_batch();
+
+    /* roots and leaves are not maintained while they are dirty */
+    void rebuild_ends() const;
+    void add_root(const schedule_unit *unit);
+    void remove_root(const schedule_unit *unit);
+    void add_leaf(const schedule_unit *unit);
+    void remove_leaf(const schedule_unit *unit);
+    /* remove the dependency at a given position of the master list */
+    void remove_dep_at(size_t pos);
+
     std::vector< const schedule_unit * > m_units;
-    std::vector< const schedule_unit * > m_roots;
-    std::vector< const schedule_unit * > m_leaves;
+    mutable std::vector< const schedule_unit * > m_roots;
+    mutable std::vector< const schedule_unit * > m_leaves;
+    mutable bool m_ends_dirty;
     std::vector< schedule_dep > m_deps;
     mutable std::map< const schedule_unit *, su_data > m_unit_map;
+    /* position of each unit in the master list */
+    ptr_index_map m_index;
     bool m_modified;
 };
 
+/**
+ * Compact implementation of the interface: each unit is given a dense index
+ * (its position in get_units()) and the dependencies are stored in two flat
+ * arrays (compressed sparse row), one for predecessors and one for successors.
+ * Each unit owns a segment of these arrays with some slack so that most edits
+ * are done in place; a segment which overflows is moved to the end of the
+ * array and the holes are reclaimed when they represent a large part of it.
+ *
+ * NOTE: removing a unit moves the last unit into its slot, so the index of a
+ *       unit is only stable until the next removal
+ */
+class compact_schedule_dag : public schedule_dag
+{
+    public:
+    compact_schedule_dag();
+    compact_schedule_dag(const schedule_dag& dag);
+    virtual ~compact_schedule_dag();
+
+    virtual compact_schedule_dag *dup() const;
+
+    virtual const std::vector< const schedule_unit *>& get_roots() const { if(m_ends_dirty) rebuild_ends(); return m_roots; }
+    virtual const std::vector< const schedule_unit *>& get_leaves() const { if(m_ends_dirty) rebuild_ends(); return m_leaves; }
+    virtual const std::vector< const schedule_unit *>& get_units() const { return m_units; }
+
+    virtual schedule_dep_range get_succs(const schedule_unit *su) const;
+    virtual schedule_dep_range get_preds(const schedule_unit *su) const;
+    virtual const std::vector< schedule_dep >& get_deps() const { return m_deps; }
+
+    virtual size_t index_of(const schedule_unit *unit) const;
+
+    virtual bool modified() const;
+    virtual void set_modified(bool mod);
+
+    virtual void add_dependency(schedule_dep d);
+    virtual void remove_dependency(schedule_dep d);
+    virtual void add_unit(const schedule_unit *unit);
+    virtual void remove_unit(const schedule_unit *unit);
+    virtual void modify_dep(const schedule_dep& old, const schedule_dep& cur);
+
+    virtual bool is_consistent(std::string *out_msg = 0) const;
+
+    virtual void clear();
+
+    protected:
+    /* part of a flat array owned by a unit */
+    struct dep_segment
+    {
+        dep_segment():off(0), size(0), cap(0) {}
+        size_t off, size, cap;
+    };
+
+    /* flat array of dependencies split in segments, one per unit; each
+     * entry also records the position of the dependency in the master list */
+    struct dep_pool
+    {
+        dep_pool():garbage(0) {}
+
+        std::vector< schedule_dep > deps;
+        std::vector< size_t > pos;
+        std::vector< dep_segment > segs;
+        /* number of entries which belong to no segment */
+        size_t garbage;
+
+        schedule_dep_range range(size_t idx) const;
+        void push(size_t idx, const schedule_dep& d, size_t p);
+        void pop(size_t idx);
+        bool find(size_t idx, const schedule_dep& d, size_t& p) const;
+        void remove_pos(size_t idx, size_t p);
+        void change_pos(size_t idx, size_t old_p, size_t new_p);
+        void set_dep(size_t idx, size_t p, const schedule_dep& d);
+        void release(size_t idx);
+        void compact();
+    };
+
+    virtual void end_batch();
+
+    /* roots and leaves are not maintained while they are dirty */
+    void rebuild_ends() const;
+    void add_root(size_t idx);
+    void remove_root(size_t idx);
+    void add_leaf(size_t idx);
+    void remove_leaf(size_t idx);
+    /* remove the dependency at a given position of the master list */
+    void remove_dep_at(size_t pos);
+
+    std::vector< const schedule_unit * > m_units;
+    mutable std::vector< const schedule_unit * > m_roots;
+    mutable std::vector< const schedule_unit * > m_leaves;
+    mutable bool m_ends_dirty;
+    std::vector< schedule_dep > m_deps;
+    dep_pool m_preds;
+    dep_pool m_succs;
+    /* position of each unit in the roots/leaves lists (see generic_schedule_dag) */
+    mutable std::vector< size_t > m_root_pos;
+    mutable std::vector< size_t > m_leaf_pos;
+    ptr_index_map m_index;
+    bool m_modified;
+};
+
+/**
+ * View of the subgraph of another DAG given by a set of units: only the
+ * dependencies between units of the set are visible. Building the view costs
+ * the size of the subgraph and its boundary, not the size of the parent, and
+ * the dependency lists of units which are not on the boundary are the ones of
+ * the parent. The first modification of the view turns it into a
+ * compact_schedule_dag of its own and all later calls go to this copy, so it
+ * can be given to schedulers which modify the graph.
+ *
+ * NOTE: the parent must not be modified as long as the view is not materialised
+ */
+class subgraph_schedule_dag : public schedule_dag
+{
+    public:
+    subgraph_schedule_dag(const schedule_dag& parent,
+        const std::set< const schedule_unit * >& units);
+    virtual ~subgraph_schedule_dag();
+
+    /* always return a compact_schedule_dag */
+    virtual schedule_dag *dup() const;
+
+    virtual const std::vector< const schedule_unit *>& get_roots() const;
+    virtual const std::vector< const schedule_unit *>& get_leaves() const;
+    virtual const std::vector< const schedule_unit *>& get_units() const;
+
+    virtual schedule_dep_range get_succs(const schedule_unit *su) const;
+    virtual schedule_dep_range get_preds(const schedule_unit *su) const;
+    virtual const std::vector< schedule_dep >& get_deps() const;
+
+    virtual size_t index_of(const schedule_unit *unit) const;
+
+    virtual bool modified() const;
+    virtual void set_modified(bool mod);
+
+    virtual void add_dependency(schedule_dep d);
+    virtual void remove_dependency(schedule_dep d);
+    virtual void add_unit(const schedule_unit *unit);
+    virtual void remove_unit(const schedule_unit *unit);
+    virtual void modify_dep(const schedule_dep& old, const schedule_dep& cur);
+
+    virtual bool is_consistent(std::string *out_msg = 0) const;
+
+    virtual void clear();
+
+    /* copy the subgraph to a graph of its own, if not already done */
+    void materialise();
+    bool is_materialised() const { return m_own != 0; }
+
+    protected:
+    virtual void end_batch();
+
+    struct su_data
+    {
+        su_data():all_preds(true), all_succs(true) {}
+
+        /* if set, the dependencies are the ones of the parent, otherwise
+         * they are filtered in the lists below */
+        bool all_preds, all_succs;
+        std::vector< schedule_dep > preds, succs;
+    };
+
+    const schedule_dag& m_parent;
+    std::vector< const schedule_unit * > m_units;
+    std::vector< const schedule_unit * > m_roots;
+    std::vector< const schedule_unit * > m_leaves;
+    std::vector< su_data > m_data;
+    ptr_index_map m_index;
+    /* built on demand */
+    mutable std::vector< schedule_dep > m_deps;
+    mutable bool m_has_deps;
+    bool m_modified;
+    compact_schedule_dag *m_own;
+
+    private:
+    /* don't copy views, use dup() */
+    subgraph_schedule_dag(const subgraph_schedule_dag&);
+    subgraph_schedule_dag& operator=(const subgraph_schedule_dag&);
+};
+
 /**
  * Debug functions to print a DAG to a DOT file which can later be rendered
  * by Graphivz
@@ -279,6 +724,80 @@ void dump_schedule_dag_to_dot_file(const schedule_dag& dag,
     const char *filename,
     const std::vector< dag_printer_opt >& opts = std::vector< dag_printer_opt >());
 
+/**
+ * Lifetime of a register in a DAG: the unit which creates it and the ones
+ * which use it, by unit index (see index_of)
+ */
+struct reg_lifetime
+{
+    size_t creator;
+    std::vector< size_t > users;
+};
+
+/**
+ * A register is alive when a unit is scheduled if its creator is an ancestor
+ * of the unit and one of its users is a descendant. Set span[u] to the number
+ * of such registers for each unit u, path being the path map of the DAG (see
+ * build_path_map). The unit adds its internal pressure or its created registers
+ * on top of them, which gives a lower bound on the register pressure of every
+ * schedule.
+ *
+ * NOTE: the output vector is resized */
+void compute_reg_spans(size_t nb_units, const std::vector< reg_lifetime >& regs,
+    const bit_matrix& path, std::vector< size_t >& span);
+
+/**
+ * Reachability index of a DAG, kept up to date with the changes of the graph.
+ * Dependency and unit additions update the index in place, as do fusions of
+ * units. A deletion which might cut a path drops the index, which is then
+ * rebuilt from scratch on the next query. Queries are O(1) otherwise.
+ * At most one index can be attached to a DAG at a time, it is then used by
+ * the DAG helpers to speed up path queries.
+ */
+class reachability_index : public schedule_dag_listener
+{
+    public:
+    reachability_index(const schedule_dag& dag);
+    virtual ~reachability_index();
+
+    /* true if there is a path from a to b, there is always a path from a unit to itself */
+    bool is_reachable(const schedule_unit *a, const schedule_unit *b) const;
+    /* drop the index, it will be rebuilt on the next query */
+    void invalidate();
+    /* stop following the changes of the graph before the index goes out of
+     * scope, typically before handing the graph to another stage */
+    void detach();
+
+    virtual void unit_added(const schedule_dag& dag, const schedule_unit *unit);
+    virtual void unit_removed(const schedule_dag& dag, const schedule_unit *unit);
+    virtual void dependency_added(const schedule_dag& dag, const schedule_dep& dep);
+    virtual void dependency_removed(const schedule_dag& dag, const schedule_dep& dep);
+    virtual void units_fused(const schedule_dag& dag, const schedule_unit *a,
+        const schedule_unit *b, const schedule_unit *c);
+    virtual void cleared(const schedule_dag& dag);
+
+    protected:
+    void rebuild() const;
+    size_t slot_of(const schedule_unit *unit) const;
+    void add_slot(const schedule_unit *unit);
+    void remove_slot(const schedule_unit *unit);
+    /* make everything reaching a reach b and everything reachable from b */
+    void add_paths(size_t a, size_t b);
+
+    const schedule_dag& m_dag;
+    bool m_attached;
+    mutable bool m_valid;
+    /* rows and columns are indexed by slots, the matrix might be bigger
+     * than the number of units to leave room for new ones */
+    mutable bit_matrix m_path;
+    mutable std::vector< const schedule_unit * > m_units;
+    mutable ptr_index_map m_slot;
+
+    private:
+    reachability_index(const reachability_index&);
+    reachability_index& operator=(const reachability_index&);
+};
+
 }
 
 #endif // __PAMAURY_SCHED_DAG_HPP__
@@ -5,6 +5,7 @@
 #include "sched-dag.hpp"
 #include "sched-chain.hpp"
 #include "time-tools.hpp"
+#include "ilp.hpp"
 
 namespace PAMAURY_SCHEDULER_NS
 {
@@ -21,7 +22,13 @@ class scheduler
 
     virtual void schedule(schedule_dag& dag, schedule_chain& sc) const = 0;
 
+    /* budget consumed by the calls to schedule since the last reset, only the
+     * schedulers with a budget report something */
+    const budget_usage& get_budget_usage() const;
+    void reset_budget_usage();
+
     protected:
+    mutable budget_usage m_budget_usage;
 };
 
 /**
@@ -56,38 +63,89 @@ class simple_rp_scheduler : public pasched::scheduler
  * Mimimum Register Instruction Scheduling
  * optimal solution using an alternative ilp
  * formulation
+ * The model is solved by an ILP backend, GLPK by default, which defines the work
+ * of the budget. When the budget is exhausted, the best known schedule is
+ * returned: the incumbent of the backend or the schedule of simple_rp_scheduler
+ * the model starts from. The fallback scheduler is only used on solver errors.
  */
 class mris_ilp_scheduler : public scheduler
 {
     public:
-    /* Timeout in ms, 0 for no timeout */
-    mris_ilp_scheduler(const scheduler *fallback_sched = 0, size_t fallback_timeout = 0, bool verbose = false);
+    mris_ilp_scheduler(const scheduler *fallback_sched = 0, const budget& b = budget(), bool verbose = false);
     virtual ~mris_ilp_scheduler();
 
+    /* the backend is not owned, 0 for GLPK */
+    void set_backend(const ilp_backend *backend);
+
     virtual void schedule(schedule_dag& dag, schedule_chain& sc) const;
 
     protected:
     const scheduler *m_fallback_sched;
-    size_t m_timeout;
+    budget m_budget;
     bool m_verbose;
+    const ilp_backend *m_backend;
 };
 
 /**
- * 
+ * Interface to follow the search of the exp scheduler. The methods can be
+ * called from the threads of the search but never concurrently.
+ */
+class exp_scheduler_listener
+{
+    public:
+    virtual ~exp_scheduler_listener() {}
+
+    /* a better schedule was found, no schedule has a RP below lower_bound */
+    virtual void schedule_improved(const schedule_dag& dag, const schedule_chain& sc,
+        size_t rp, size_t lower_bound) = 0;
+    /* the search is over, the schedule returned has a RP of rp and the gap to
+     * the optimum is at most rp - lower_bound, which is 0 unless the budget was
+     * exhausted */
+    virtual void search_finished(const schedule_dag& dag, size_t rp, size_t lower_bound,
+        bool exhausted) = 0;
+    /* the budget is exhausted with a schedule of RP rp, return true to resume
+     * the search with more work and time on top of what was used */
+    virtual bool budget_exhausted(const schedule_dag& dag, size_t rp, size_t lower_bound,
+        budget& more)
+    {
+        (void) dag;
+        (void) rp;
+        (void) lower_bound;
+        (void) more;
+        return false;
+    }
+};
+
+/**
+ * Exhaustive search of the schedule with the lowest register pressure.
+ * The search starts from the schedule of simple_rp_scheduler and only looks
+ * for better ones, so when the budget is exhausted the best schedule found so
+ * far is returned. The fallback scheduler is only used when no schedule was found.
  */
 class exp_scheduler : public scheduler
 {
     public:
-    /* Timeout in ms, 0 for no timeout */
-    exp_scheduler(const scheduler *fallback_sched = 0, size_t fallback_timeout = 0, bool verbose = false);
+    /* The work of the budget is the number of explored nodes, the schedule
+     * found within a work limit only depends on the input when nb_threads == 1
+     * Memory limit of the cache in bytes
+     * Number of threads exploring the search tree, 0 for one per processor,
+     * only used when compiled with threads and on large enough graphs */
+    exp_scheduler(const scheduler *fallback_sched = 0, const budget& b = budget(), bool verbose = false,
+        size_t cache_mem_limit = 256 * 1024 * 1024, size_t nb_threads = 1);
     virtual ~exp_scheduler();
 
+    /* the listener is not owned, 0 to remove it */
+    void set_listener(exp_scheduler_listener *listener);
+
     virtual void schedule(schedule_dag& dag, schedule_chain& sc) const;
 
     protected:
     const scheduler *m_fallback_sched;
-    size_t m_timeout;
+    budget m_budget;
     bool m_verbose;
+    size_t m_cache_mem_limit;
+    size_t m_nb_threads;
+    exp_scheduler_listener *m_listener;
 };
 
 }
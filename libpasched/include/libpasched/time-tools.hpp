@@ -2,6 +2,7 @@
 #define __PAMAURY_TIME_TOOLS_HPP__
 
 #include "config.hpp"
+#include <stdint.h>
 #include <string>
 #include <vector>
 
@@ -50,6 +51,86 @@ class time_stat
     bool m_registered;
 };
 
+/**
+ * Limits on the work of an algorithm. The work is counted in units which
+ * depend on the algorithm (explored nodes, branch and bound nodes...): unlike
+ * the time, it does not depend on the machine or its load so a work limit
+ * gives the same result on every run of a single threaded algorithm. Several
+ * threads share the work in an order which changes from run to run, and so
+ * does the result. The time is a wall clock time, both limits can be combined
+ * and 0 means no limit.
+ */
+class budget
+{
+    public:
+    budget();
+    budget(uint64_t work_limit, uint64_t time_limit);
+
+    static budget from_work(uint64_t work_limit);
+    /* time limit in ms */
+    static budget from_time(uint64_t time_limit);
+
+    uint64_t get_work_limit() const;
+    uint64_t get_time_limit() const;
+    bool is_limited() const;
+
+    protected:
+    uint64_t m_work_limit;
+    uint64_t m_time_limit;
+};
+
+/**
+ * Consumption of a budget by a run of an algorithm. The time is measured on
+ * a monotonic clock from the call to start.
+ */
+class budget_meter
+{
+    public:
+    budget_meter();
+
+    void start(const budget& b);
+    /* freeze the elapsed time */
+    void stop();
+    /* give more work and time on top of what was already used, the limits
+     * which are 0 in more are removed */
+    void extend(const budget& more);
+
+    /* safe to call from several threads when compiled with threads */
+    void add_work(uint64_t work);
+    uint64_t get_work() const;
+    /* in ms */
+    uint64_t get_elapsed_time() const;
+    /* reads the clock if there is a time limit */
+    bool is_exhausted() const;
+    const budget& get_budget() const;
+
+    protected:
+    budget m_budget;
+    /* only accessed with atomic operations when compiled with threads */
+    uint64_t m_work;
+    uint64_t m_start;
+    uint64_t m_stop;
+    bool m_running;
+};
+
+/**
+ * Budget consumed by several runs, for example all the calls to a scheduler
+ * made by a transformation pipeline.
+ */
+struct budget_usage
+{
+    budget_usage();
+
+    /* exhausted if the run was stopped by its budget */
+    void add(const budget_meter& meter, bool exhausted);
+
+    uint64_t work;
+    uint64_t time; /* in ms */
+    size_t nb_runs;
+    /* number of runs which were stopped by their budget */
+    size_t nb_exhausted;
+};
+
 #define TM_DECLARE(unique_name, name) \
     namespace { ::PAMAURY_SCHEDULER_NS::time_stat unique_name(name); }
 #define TM_START(unique_name) unique_name.get_timer().start();
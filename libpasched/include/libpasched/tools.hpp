@@ -8,6 +8,8 @@
 #include <set>
 #include <map>
 #include <iostream>
+#include <algorithm>
+#include <iterator>
 
 namespace PAMAURY_SCHEDULER_NS
 {
@@ -188,6 +190,39 @@ std::set< T > set_inter(const std::set< T >& a, const std::set< T >& b)
     return c;
 }
 
+/* same on sorted vectors without duplicates, in linear time */
+template<typename T>
+std::vector< T > set_minus(const std::vector< T >& a, const std::vector< T >& b)
+{
+    std::vector< T > c;
+    std::set_difference(a.begin(), a.end(), b.begin(), b.end(), std::back_inserter(c));
+    return c;
+}
+
+template<typename T>
+std::vector< T > set_union(const std::vector< T >& a, const std::vector< T >& b)
+{
+    std::vector< T > c;
+    std::set_union(a.begin(), a.end(), b.begin(), b.end(), std::back_inserter(c));
+    return c;
+}
+
+template<typename T>
+std::vector< T > set_inter(const std::vector< T >& a, const std::vector< T >& b)
+{
+    std::vector< T > c;
+    std::set_intersection(a.begin(), a.end(), b.begin(), b.end(), std::back_inserter(c));
+    return c;
+}
+
+/* sort a vector and remove duplicates */
+template<typename T>
+void sort_unique(std::vector< T >& v)
+{
+    std::sort(v.begin(), v.end());
+    v.erase(std::unique(v.begin(), v.end()), v.end());
+}
+
 template<typename T>
 std::vector< T > set_to_vector(const std::set< T >& s)
 {
@@ -3,6 +3,7 @@
 
 #include "libpasched/tools.hpp"
 #include "libpasched/time-tools.hpp"
+#include "libpasched/ilp.hpp"
 #include "libpasched/scheduler.hpp"
 #include "libpasched/sched-transform.hpp"
 #include "libpasched/ddl.hpp"
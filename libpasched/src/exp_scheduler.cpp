@@ -7,17 +7,27 @@
 #include <stdexcept>
 #include <set>
 #include <queue>
+#include <deque>
 #include <iostream>
 #include <cassert>
 #include <ctime>
+#include <cstring>
+#include <algorithm>
+#ifdef ENABLE_THREADS
+#include <pthread.h>
+#include <unistd.h>
+#include <sched.h>
+#endif
 
 namespace PAMAURY_SCHEDULER_NS
 {
 
 STM_DECLARE(exp_scheduler)
 
-exp_scheduler::exp_scheduler(const scheduler *fallback_sched, size_t fallback_timeout, bool verbose)
-    :m_fallback_sched(fallback_sched), m_timeout(fallback_timeout), m_verbose(verbose)
+exp_scheduler::exp_scheduler(const scheduler *fallback_sched, const budget& b, bool verbose,
+        size_t cache_mem_limit, size_t nb_threads)
+    :m_fallback_sched(fallback_sched), m_budget(b), m_verbose(verbose),
+    m_cache_mem_limit(cache_mem_limit), m_nb_threads(nb_threads), m_listener(0)
 {
 }
 
@@ -25,25 +35,37 @@ exp_scheduler::~exp_scheduler()
 {
 }
 
+void exp_scheduler::set_listener(exp_scheduler_listener *listener)
+{
+    m_listener = listener;
+}
+
 namespace
 {
-    typedef unsigned short unit_idx_t;
+    /* units are numbered from 0 to nb_units - 1, the search itself stores them
+     * with the smallest type that fits, see the kernels */
+    typedef uint32_t unit_idx_t;
+    /* registers are renumbered from 0 to nb_regs - 1 */
+    typedef unsigned int reg_idx_t;
 
-    struct exp_live_reg
-    {
-        schedule_dep::reg_t id;
-        /* number of uses of the register still to be scheduled before the register dies */
-        size_t nb_use_left;
-    };
+    /* don't bother with threads on small graphs */
+    const size_t EXP_PARALLEL_MIN_UNITS = 32;
+    /* don't give away subtrees with fewer units left to schedule */
+    const size_t EXP_SPLIT_MIN_UNITS = 8;
+    /* the interference bound is quadratic in the number of registers */
+    const size_t EXP_INTERFERENCE_MAX_REGS = 2048;
+    /* explored nodes are added to the budget by batches, so that the workers
+     * do not fight over the counter and do not read the clock too often */
+    const size_t EXP_WORK_BATCH = 100;
 
     struct exp_static_unit_info
     {
         /* list of used registers */
-        std::vector< schedule_dep::reg_t > reg_use;
+        std::vector< reg_idx_t > reg_use;
         /* list of created phys registers */
-        std::vector< schedule_dep::reg_t > reg_phys_create;
+        std::vector< reg_idx_t > reg_phys_create;
         /* list of all created registers */
-        std::vector< schedule_dep::reg_t > reg_all_create;
+        std::vector< reg_idx_t > reg_all_create;
         /* number of uses of each created variable */
         std::vector< size_t > reg_all_create_use_count;
         /* list of predecessors */
@@ -54,15 +76,10 @@ namespace
         size_t irp;
     };
 
-    struct exp_dynamic_unit_info
-    {
-        size_t nb_dep_left;
-    };
-
     enum exp_status
     {
         status_success,
-        status_timeout
+        status_exhausted
     };
 
     struct exp_cache_result
@@ -81,7 +98,7 @@ namespace
             /* best achieved RP for the scheduled graph (forward view) */
             size_t achieved_rp;
         }fw;
-        
+
         struct
         {
             /* does it contain valid backward info ? */
@@ -95,508 +112,1846 @@ namespace
         }bw;
     };
 
-    struct exp_state
+    /**
+     * Transposition table of the scheduler
+     * Open addressing hash table keyed by the set of scheduled units. The
+     * table is split in buckets of a few slots, a key living in the bucket
+     * given by its hash. Keys are fully compared on lookup so there is no
+     * false positive. The table grows by doubling up to a memory limit,
+     * after which inserting in a full bucket evicts the entry which was the
+     * cheapest to compute.
+     * When shared between threads, the table is split in stripes which are
+     * independent tables, each protected by its own lock. Entries are
+     * copied in and out so they are never accessed outside of the lock.
+     */
+    class exp_cache
+    {
+        public:
+        exp_cache():m_key_chunks(0), m_concurrent(false) {}
+
+        ~exp_cache()
+        {
+            #ifdef ENABLE_THREADS
+            if(m_concurrent)
+                for(size_t i = 0; i < m_stripes.size(); i++)
+                    pthread_mutex_destroy(&m_stripes[i].lock);
+            #endif
+        }
+
+        /* prepare the table for keys of nb_bits bits, given as arrays of 64-bit
+         * chunks, mem_limit is in bytes */
+        void init(size_t nb_bits, size_t mem_limit, bool concurrent)
+        {
+            assert(m_stripes.size() == 0 && "Cache initialised twice");
+            m_key_chunks = (nb_bits + 63) / 64;
+            m_concurrent = concurrent;
+            m_stripes.resize(concurrent ? NB_STRIPES : 1);
+            size_t stripe_mem = mem_limit / m_stripes.size();
+            size_t bucket_size = WAYS * (sizeof(slot) + m_key_chunks * sizeof(uint64_t));
+            for(size_t i = 0; i < m_stripes.size(); i++)
+            {
+                stripe& s = m_stripes[i];
+                s.max_buckets = 1;
+                while(2 * s.max_buckets * bucket_size <= stripe_mem)
+                    s.max_buckets *= 2;
+                resize(s, std::min(s.max_buckets, (size_t)INITIAL_BUCKETS));
+                #ifdef ENABLE_THREADS
+                if(m_concurrent)
+                    pthread_mutex_init(&s.lock, 0);
+                #endif
+            }
+        }
+
+        /* copy the entry of a key to out, return false if it is not in the table */
+        bool find(const uint64_t *key, uint64_t hash, exp_cache_result& out)
+        {
+            stripe& s = stripe_of(hash);
+            lock(s);
+            size_t sl = find_slot(s, key, hash);
+            if(sl != NO_SLOT)
+            {
+                s.hits++;
+                out = s.slots[sl].res;
+            }
+            else
+                s.misses++;
+            unlock(s);
+            return sl != NO_SLOT;
+        }
+
+        /* store the entry of a key, work is the cost of computing it */
+        void store(const uint64_t *key, uint64_t hash, const exp_cache_result& res, size_t work)
+        {
+            stripe& s = stripe_of(hash);
+            lock(s);
+            size_t sl = find_slot(s, key, hash);
+            if(sl == NO_SLOT)
+            {
+                if(4 * s.size >= 3 * s.slots.size() && nb_buckets(s) < s.max_buckets)
+                    resize(s, 2 * nb_buckets(s));
+                sl = alloc_slot(s, key, hash);
+            }
+            s.slots[sl].res = res;
+            s.slots[sl].work = std::max(s.slots[sl].work, work);
+            unlock(s);
+        }
+
+        /* statistics, only meaningful when no other thread uses the table */
+        size_t hits() const { return sum(&stripe::hits); }
+        size_t misses() const { return sum(&stripe::misses); }
+        size_t evictions() const { return sum(&stripe::evictions); }
+        size_t size() const { return sum(&stripe::size); }
+
+        protected:
+        static const size_t WAYS = 4;
+        static const size_t INITIAL_BUCKETS = 16;
+        static const size_t NB_STRIPES = 64;
+        static const size_t NO_SLOT = SIZE_MAX;
+
+        struct slot
+        {
+            slot():used(false), hash(0), work(0) {}
+
+            bool used;
+            uint64_t hash;
+            size_t work;
+            exp_cache_result res;
+        };
+
+        struct stripe
+        {
+            stripe():max_buckets(0), size(0), hits(0), misses(0), evictions(0)
+            {
+                #ifdef ENABLE_THREADS
+                /* the lock is initialised once the stripes are in place */
+                memset(&lock, 0, sizeof(lock));
+                #endif
+            }
+
+            size_t max_buckets;
+            size_t size;
+            std::vector< slot > slots;
+            std::vector< uint64_t > keys;
+            size_t hits;
+            size_t misses;
+            size_t evictions;
+            #ifdef ENABLE_THREADS
+            pthread_mutex_t lock;
+            #endif
+        };
+
+        /* the stripe is picked with the high bits, the bucket with the low bits */
+        stripe& stripe_of(uint64_t hash) { return m_stripes[(hash >> 58) % m_stripes.size()]; }
+
+        void lock(stripe& s)
+        {
+            #ifdef ENABLE_THREADS
+            if(m_concurrent)
+                pthread_mutex_lock(&s.lock);
+            #else
+            (void) s;
+            #endif
+        }
+
+        void unlock(stripe& s)
+        {
+            #ifdef ENABLE_THREADS
+            if(m_concurrent)
+                pthread_mutex_unlock(&s.lock);
+            #else
+            (void) s;
+            #endif
+        }
+
+        size_t sum(size_t stripe::*field) const
+        {
+            size_t total = 0;
+            for(size_t i = 0; i < m_stripes.size(); i++)
+                total += m_stripes[i].*field;
+            return total;
+        }
+
+        static size_t nb_buckets(const stripe& s) { return s.slots.size() / WAYS; }
+
+        uint64_t *key_of(stripe& s, size_t sl) { return &s.keys[sl * m_key_chunks]; }
+
+        size_t find_slot(stripe& s, const uint64_t *key, uint64_t hash)
+        {
+            size_t first = (hash & (nb_buckets(s) - 1)) * WAYS;
+            for(size_t sl = first; sl < first + WAYS; sl++)
+                if(s.slots[sl].used && s.slots[sl].hash == hash &&
+                        memcmp(key_of(s, sl), key, m_key_chunks * sizeof(uint64_t)) == 0)
+                    return sl;
+            return NO_SLOT;
+        }
+
+        size_t alloc_slot(stripe& s, const uint64_t *key, uint64_t hash)
+        {
+            size_t first = (hash & (nb_buckets(s) - 1)) * WAYS;
+            size_t victim = first;
+            for(size_t sl = first; sl < first + WAYS; sl++)
+            {
+                if(!s.slots[sl].used)
+                {
+                    victim = sl;
+                    break;
+                }
+                if(s.slots[sl].work < s.slots[victim].work)
+                    victim = sl;
+            }
+            if(s.slots[victim].used)
+                s.evictions++;
+            else
+                s.size++;
+            s.slots[victim] = slot();
+            s.slots[victim].used = true;
+            s.slots[victim].hash = hash;
+            memcpy(key_of(s, victim), key, m_key_chunks * sizeof(uint64_t));
+            return victim;
+        }
+
+        void resize(stripe& s, size_t nb_buckets)
+        {
+            std::vector< slot > old_slots;
+            std::vector< uint64_t > old_keys;
+            old_slots.swap(s.slots);
+            old_keys.swap(s.keys);
+            s.slots.resize(nb_buckets * WAYS);
+            s.keys.resize(nb_buckets * WAYS * m_key_chunks);
+            s.size = 0;
+
+            for(size_t sl = 0; sl < old_slots.size(); sl++)
+            {
+                if(!old_slots[sl].used)
+                    continue;
+                size_t first = (old_slots[sl].hash & (nb_buckets - 1)) * WAYS;
+                for(size_t d = first; d < first + WAYS; d++)
+                    if(!s.slots[d].used)
+                    {
+                        s.slots[d] = old_slots[sl];
+                        memcpy(key_of(s, d), &old_keys[sl * m_key_chunks], m_key_chunks * sizeof(uint64_t));
+                        s.size++;
+                        goto Lnext;
+                    }
+                /* the bucket overflowed, drop the entry */
+                s.evictions++;
+                Lnext:
+                continue;
+            }
+        }
+
+        size_t m_key_chunks;
+        bool m_concurrent;
+        std::vector< stripe > m_stripes;
+    };
+
+    #ifdef ENABLE_THREADS
+    struct exp_task_queue
     {
+        pthread_mutex_t lock;
+        /* each task is the prefix of schedule leading to a subtree */
+        std::deque< std::vector< unit_idx_t > > tasks;
+    };
+    #endif
+
+    struct exp_shared;
+
+    /* test a bit of a set given as an array of 64-bit chunks */
+    inline bool exp_test_bit(const uint64_t *chunks, size_t b)
+    {
+        return test_bit(chunks[b / 64], b % 64);
+    }
+
+    /**
+     * Lower bound on the RP of the schedules which complete the partial
+     * schedule of a worker. Bounds must be admissible: no completion
+     * achieves a smaller RP. They must only depend on the set of scheduled
+     * units so that they agree with the cache.
+     */
+    class exp_lower_bound
+    {
+        public:
+        virtual ~exp_lower_bound() {}
+
+        /* called once the static info is computed, path is the path map of the graph */
+        virtual void init(const exp_shared& sh, const bit_matrix& path) = 0;
+        /* scheduled is the set of scheduled units, reg_use_left the number of uses
+         * left of each register */
+        virtual size_t bound(const uint64_t *scheduled, const std::vector< size_t >& reg_use_left) const = 0;
+    };
+
+    /* state shared by all the workers */
+    struct exp_shared
+    {
+        ~exp_shared();
+
         /* global parameters */
         const schedule_dag *dag;
-        size_t timeout;
+        budget_meter meter; /* the work is the number of explored nodes */
         bool verbose;
-        /* for timeout */
-        clock_t clock_start;
-        size_t clock_div;
-        size_t clock_cycle;
+        size_t cache_mem_limit;
         /* [unit_idx_t -> unit] map is dag.get_units() */
-        /* [unit -> unit_idx_t] map follows */
-        std::map< const schedule_unit *, unit_idx_t > unit_idx_map;
+        /* [unit -> unit_idx_t] map is dag.index_of() */
         /* static info used during scheduling */
         size_t nb_units;
         std::vector< exp_static_unit_info> unit_sinfo; /* index by unit_idx_t */
-        /* dynamic info used during scheduling */
-        std::map< schedule_dep::reg_t, exp_live_reg > live_regs;
-        std::vector< unit_idx_t > schedulable;
-        std::vector< exp_dynamic_unit_info > unit_dinfo;
-        size_t cur_rp;
-        std::vector< unit_idx_t > cur_schedule;
-        /* global results */
-        bool has_schedule;
-        size_t best_rp; /* if has_schedule */
-        std::vector< unit_idx_t > best_schedule; /* if has_schedule */
-        bool proven_optimal; /* if has_schedule */
+        std::vector< uint64_t > unit_hash; /* index by unit_idx_t */
+        std::vector< size_t > twin_prev; /* index by unit_idx_t, previous twin or SIZE_MAX */
+        size_t nb_regs;
+        /* lower bounds, owned */
+        std::vector< exp_lower_bound * > bounds;
+        /* lower bound on the RP of any schedule */
+        size_t root_bound;
+        /* notified of each improvement, can be 0 */
+        exp_scheduler_listener *listener;
+        /* global results, best_rp is SIZE_MAX until a schedule is found,
+         * it is read without the lock with exp_best_rp() */
+        size_t best_rp;
+        std::vector< unit_idx_t > best_schedule;
         exp_status status;
-
         /* cache */
-        std::map< bitmap, exp_cache_result > cache_mem;
-        bitmap cache_bm;
+        exp_cache cache;
+        /* set by the first worker which exhausts the budget, accessed with
+         * exp_stopped() and exp_set_stop() */
+        bool stop;
+        /* are there several workers ? */
+        bool parallel;
+        size_t nb_nodes; /* number of explored nodes, for statistics */
+        #ifdef ENABLE_THREADS
+        /* protects best_rp and best_schedule */
+        pthread_mutex_t best_lock;
+        /* one queue per worker, others steal from the front */
+        std::vector< exp_task_queue > queues;
+        /* number of tasks pushed but not finished yet, read with an acquire load */
+        size_t nb_tasks;
+        /* number of workers looking for a task, only a hint for splitting */
+        size_t nb_idle;
+        #endif
+    };
+
+    /* children of a node in a vector: positions pos to end - 1 */
+    struct exp_vector_cursor
+    {
+        size_t pos;
+        size_t end;
+    };
+
+    /* children of a node in a mask: pos and the ones in left */
+    template< size_t W >
+    struct exp_mask_cursor
+    {
+        fixed_bitmap< W > left;
+        size_t pos;
+    };
+
+    /**
+     * The search is instantiated for several representations of the sets of
+     * units. The generic kernel keeps the schedulable units in a vector and
+     * tries them in the order of the vector. The small kernels are used for
+     * graphs of at most 64 * W units: all the sets of units fit in W words and
+     * the schedulable units are tried in index order, found with ctz.
+     * Units of the list are designated by a position: the index in the vector,
+     * or the index of the unit itself in the mask.
+     * The units stored by a worker (schedule, list, successors, dependency
+     * counters) have type unit_t, the smallest which holds all the indexes.
+     */
+    template< typename I >
+    struct exp_generic_kernel
+    {
+        typedef I unit_t;
+        typedef bitmap set_t;
+        typedef std::vector< I > list_t;
+        typedef exp_vector_cursor cursor_t;
+    };
+
+    template< size_t W >
+    struct exp_small_kernel
+    {
+        typedef uint8_t unit_t;
+        typedef fixed_bitmap< W > set_t;
+        typedef fixed_bitmap< W > list_t;
+        typedef exp_mask_cursor< W > cursor_t;
+    };
+
+    template< typename I >
+    inline void exp_list_clear(std::vector< I >& l, size_t nb_units)
+    {
+        (void) nb_units;
+        l.clear();
+    }
+
+    /* first position of the list, or SIZE_MAX */
+    template< typename I >
+    inline size_t exp_list_first(const std::vector< I >& l)
+    {
+        return l.size() != 0 ? 0 : SIZE_MAX;
+    }
+
+    template< typename I >
+    inline size_t exp_list_next(const std::vector< I >& l, size_t pos)
+    {
+        return pos + 1 < l.size() ? pos + 1 : SIZE_MAX;
+    }
+
+    template< typename I >
+    inline unit_idx_t exp_list_unit(const std::vector< I >& l, size_t pos)
+    {
+        return l[pos];
+    }
+
+    template< typename I >
+    inline size_t exp_list_find(const std::vector< I >& l, unit_idx_t unit)
+    {
+        size_t pos = std::find(l.begin(), l.end(), unit) - l.begin();
+        return pos != l.size() ? pos : SIZE_MAX;
+    }
+
+    template< typename I >
+    inline void exp_list_release(std::vector< I >& l, unit_idx_t unit)
+    {
+        l.push_back((I)unit);
+    }
+
+    template< typename I >
+    inline void exp_list_remove(std::vector< I >& l, size_t pos)
+    {
+        unordered_vector_remove(pos, l);
+    }
+
+    /* undo exp_list_release, the units are unreleased in the order they were released */
+    template< typename I >
+    inline void exp_list_unrelease(std::vector< I >& l, unit_idx_t unit, size_t& nb_unreleased)
+    {
+        (void) l;
+        (void) unit;
+        nb_unreleased++;
+    }
+
+    /* undo exp_list_remove once the released units are unreleased */
+    template< typename I >
+    inline void exp_list_restore(std::vector< I >& l, size_t pos, unit_idx_t unit,
+        size_t nb_unreleased)
+    {
+        /* WARNING: you enter dangerous waters here, this
+         *          highly depends on the semantics of
+         *          unordered_vector_remove and how the list
+         *          is updated */
+        assert(l.size() >= nb_unreleased);
+        l.resize(l.size() + 1 - nb_unreleased);
+        l[l.size() - 1] = l[pos];
+        l[pos] = (I)unit;
+    }
+
+    /* start with a single child if forced is a position, or all the list */
+    template< typename I >
+    inline void exp_cursor_start(exp_vector_cursor& c, const std::vector< I >& l,
+        size_t forced)
+    {
+        c.pos = forced == SIZE_MAX ? 0 : forced;
+        c.end = forced == SIZE_MAX ? l.size() : forced + 1;
+    }
+
+    /* position of the current child or SIZE_MAX */
+    inline size_t exp_cursor_pos(const exp_vector_cursor& c)
+    {
+        return c.pos < c.end ? c.pos : SIZE_MAX;
+    }
+
+    inline void exp_cursor_advance(exp_vector_cursor& c)
+    {
+        c.pos++;
+    }
+
+    inline bool exp_cursor_has_more(const exp_vector_cursor& c)
+    {
+        return c.pos + 1 < c.end;
+    }
+
+    /* the children after the current one */
+    template< typename I >
+    inline void exp_cursor_rest(const exp_vector_cursor& c, const std::vector< I >& l,
+        std::vector< unit_idx_t >& units)
+    {
+        units.assign(l.begin() + c.pos + 1, l.begin() + c.end);
+    }
+
+    template< size_t W >
+    inline void exp_list_clear(fixed_bitmap< W >& l, size_t nb_units)
+    {
+        l.set_nb_bits(nb_units);
+    }
+
+    template< size_t W >
+    inline size_t exp_list_first(const fixed_bitmap< W >& l)
+    {
+        size_t pos = l.find_next_bit_set(0);
+        return pos < l.nb_bits() ? pos : SIZE_MAX;
+    }
+
+    template< size_t W >
+    inline size_t exp_list_next(const fixed_bitmap< W >& l, size_t pos)
+    {
+        pos = l.find_next_bit_set(pos + 1);
+        return pos < l.nb_bits() ? pos : SIZE_MAX;
+    }
+
+    template< size_t W >
+    inline unit_idx_t exp_list_unit(const fixed_bitmap< W >& l, size_t pos)
+    {
+        (void) l;
+        return pos;
+    }
+
+    template< size_t W >
+    inline size_t exp_list_find(const fixed_bitmap< W >& l, unit_idx_t unit)
+    {
+        return unit < l.nb_bits() && l.test_bit(unit) ? unit : SIZE_MAX;
+    }
+
+    template< size_t W >
+    inline void exp_list_release(fixed_bitmap< W >& l, unit_idx_t unit)
+    {
+        l.set_bit(unit);
+    }
+
+    template< size_t W >
+    inline void exp_list_remove(fixed_bitmap< W >& l, size_t pos)
+    {
+        l.clear_bit(pos);
+    }
+
+    template< size_t W >
+    inline void exp_list_unrelease(fixed_bitmap< W >& l, unit_idx_t unit, size_t& nb_unreleased)
+    {
+        (void) nb_unreleased;
+        l.clear_bit(unit);
+    }
+
+    template< size_t W >
+    inline void exp_list_restore(fixed_bitmap< W >& l, size_t pos, unit_idx_t unit, size_t nb_unreleased)
+    {
+        (void) unit;
+        (void) nb_unreleased;
+        l.set_bit(pos);
+    }
+
+    template< size_t W >
+    inline void exp_cursor_advance(exp_mask_cursor< W >& c)
+    {
+        c.pos = exp_list_first(c.left);
+        if(c.pos != SIZE_MAX)
+            c.left.clear_bit(c.pos);
+    }
+
+    template< size_t W >
+    inline void exp_cursor_start(exp_mask_cursor< W >& c, const fixed_bitmap< W >& l,
+        size_t forced)
+    {
+        if(forced == SIZE_MAX)
+            c.left = l;
+        else
+        {
+            c.left.set_nb_bits(l.nb_bits());
+            c.left.set_bit(forced);
+        }
+        exp_cursor_advance(c);
+    }
+
+    template< size_t W >
+    inline size_t exp_cursor_pos(const exp_mask_cursor< W >& c)
+    {
+        return c.pos;
+    }
+
+    template< size_t W >
+    inline bool exp_cursor_has_more(const exp_mask_cursor< W >& c)
+    {
+        return exp_list_first(c.left) != SIZE_MAX;
+    }
+
+    template< size_t W >
+    inline void exp_cursor_rest(const exp_mask_cursor< W >& c, const fixed_bitmap< W >& l,
+        std::vector< unit_idx_t >& units)
+    {
+        (void) l;
+        units.clear();
+        for(size_t pos = exp_list_first(c.left); pos != SIZE_MAX; pos = exp_list_next(c.left, pos))
+            units.push_back(pos);
+    }
+
+    /* node of the search being explored */
+    template< typename K >
+    struct exp_frame
+    {
+        /* copy of the cache entry of the node, stored back when the node is done */
+        exp_cache_result cc;
+        /* value of nb_nodes when entering the node */
+        size_t first_node;
+        /* current child and children not tried yet */
+        typename K::cursor_t children;
+        /* RP before scheduling the current child, and instantaneous RP of the child */
+        size_t old_rp;
+        size_t inst_rp;
+        typename K::unit_t unit;
+        /* did we give the remaining units to other workers ? */
+        bool split;
+    };
+
+    /* what the search has to do next on the top frame */
+    enum exp_action
+    {
+        /* the node was just reached */
+        action_enter,
+        /* try the next child */
+        action_next,
+        /* the node is done, return to the parent */
+        action_leave
+    };
+
+    /* state of one worker */
+    /* successors of all the units in one array, with the index type of a kernel */
+    template< typename I >
+    struct exp_release_lists
+    {
+        /* successors of u are units[first[u]] to units[first[u + 1] - 1] */
+        std::vector< size_t > first;
+        std::vector< I > units;
     };
 
-    struct exp_timeout
+    template< typename K >
+    struct exp_state
     {
+        exp_shared *sh;
+        const exp_release_lists< typename K::unit_t > *release; /* shared by the workers */
+        size_t worker;
+        /* explored nodes not added to the budget yet */
+        size_t work_pending;
+        /* dynamic info used during scheduling */
+        /* number of uses left of each register, 0 when it is not alive */
+        std::vector< size_t > reg_use_left; /* index by reg_idx_t */
+        size_t nb_live_regs;
+        typename K::list_t schedulable;
+        /* number of predecessors not scheduled yet */
+        std::vector< typename K::unit_t > nb_dep_left; /* index by unit_idx_t */
+        size_t cur_rp;
+        std::vector< typename K::unit_t > cur_schedule;
+        /* cache */
+        typename K::set_t cache_bm; /* set of scheduled units */
+        uint64_t cache_hash; /* hash of cache_bm */
+        size_t nb_nodes; /* number of explored nodes */
+        /* search stack, one frame per scheduled unit below the root of the search,
+         * it is kept when the search is interrupted so that it can be resumed */
+        std::vector< exp_frame< K > > frames;
+        size_t depth; /* 0 when there is no search in progress */
+        exp_action action;
     };
 
-    void compute_static_info(const schedule_dag& dag, exp_state& st)
+    void map_regs(const schedule_dag::reg_list& regs, std::map< schedule_dep::reg_t, reg_idx_t >& index,
+        std::vector< reg_idx_t >& out)
+    {
+        out.resize(regs.size());
+        for(size_t i = 0; i < regs.size(); i++)
+        {
+            std::map< schedule_dep::reg_t, reg_idx_t >::iterator it = index.find(regs[i]);
+            if(it == index.end())
+                it = index.insert(std::make_pair(regs[i], (reg_idx_t)index.size())).first;
+            out[i] = it->second;
+        }
+    }
+
+    void compute_static_info(const schedule_dag& dag, exp_shared& sh)
     {
-        st.dag = &dag;
-        /* unit_idx_map */
-        for(size_t u = 0; u < dag.get_units().size(); u++)
-            st.unit_idx_map[dag.get_units()[u]] = (unit_idx_t)u;
+        sh.dag = &dag;
         /* nb_units */
-        st.nb_units = dag.get_units().size();
+        sh.nb_units = dag.get_units().size();
         /* unit_sinfo */
-        st.unit_sinfo.resize(st.nb_units);
-        for(unit_idx_t u = 0; u < st.nb_units; u++)
+        sh.unit_sinfo.resize(sh.nb_units);
+        traversal_scratch scratch;
+        std::vector< const schedule_unit * > neigh;
+        /* [reg_t -> reg_idx_t] map */
+        std::map< schedule_dep::reg_t, reg_idx_t > reg_index;
+        for(unit_idx_t u = 0; u < sh.nb_units; u++)
         {
             const schedule_unit *unit = dag.get_units()[u];
-            std::set< const schedule_unit * > set;
-            std::set< schedule_dep::reg_t > rset;
-            std::set< const schedule_unit * >::iterator it;
-            std::set< schedule_dep::reg_t >::iterator rit;
             /* unit_depend */
-            set = dag.get_reachable(unit, schedule_dag::rf_follow_preds | schedule_dag::rf_immediate);
-            st.unit_sinfo[u].unit_depend.reserve(set.size());
-            for(it = set.begin(); it != set.end(); ++it)
-                st.unit_sinfo[u].unit_depend.push_back(st.unit_idx_map[*it]);
+            neigh.clear();
+            dag.get_reachable(unit, schedule_dag::rf_follow_preds | schedule_dag::rf_immediate,
+                scratch, neigh);
+            sh.unit_sinfo[u].unit_depend.reserve(neigh.size());
+            for(size_t i = 0; i < neigh.size(); i++)
+                sh.unit_sinfo[u].unit_depend.push_back((unit_idx_t)dag.index_of(neigh[i]));
+            std::sort(sh.unit_sinfo[u].unit_depend.begin(), sh.unit_sinfo[u].unit_depend.end());
             /* unit_release */
-            set = dag.get_reachable(unit, schedule_dag::rf_follow_succs | schedule_dag::rf_immediate);
-            st.unit_sinfo[u].unit_release.reserve(set.size());
-            for(it = set.begin(); it != set.end(); ++it)
-                st.unit_sinfo[u].unit_release.push_back(st.unit_idx_map[*it]);
-            /* reg_use */
-            rset = dag.get_reg_use(unit);
-            st.unit_sinfo[u].reg_use.reserve(rset.size());
-            for(rit = rset.begin(); rit != rset.end(); ++rit)
-                st.unit_sinfo[u].reg_use.push_back(*rit);
-            /* reg_phys_create */
-            rset = dag.get_reg_phys_create(unit);
-            st.unit_sinfo[u].reg_phys_create.reserve(rset.size());
-            for(rit = rset.begin(); rit != rset.end(); ++rit)
-                st.unit_sinfo[u].reg_phys_create.push_back(*rit);
-            /* reg_all_create */
-            rset = dag.get_reg_create(unit);
-            st.unit_sinfo[u].reg_all_create.reserve(rset.size());
-            for(rit = rset.begin(); rit != rset.end(); ++rit)
-                st.unit_sinfo[u].reg_all_create.push_back(*rit);
+            neigh.clear();
+            dag.get_reachable(unit, schedule_dag::rf_follow_succs | schedule_dag::rf_immediate,
+                scratch, neigh);
+            sh.unit_sinfo[u].unit_release.reserve(neigh.size());
+            for(size_t i = 0; i < neigh.size(); i++)
+                sh.unit_sinfo[u].unit_release.push_back((unit_idx_t)dag.index_of(neigh[i]));
+            std::sort(sh.unit_sinfo[u].unit_release.begin(), sh.unit_sinfo[u].unit_release.end());
+            /* reg_use, reg_phys_create and reg_all_create */
+            const schedule_dag::reg_info& ri = dag.get_reg_info(unit);
+            map_regs(ri.use, reg_index, sh.unit_sinfo[u].reg_use);
+            map_regs(ri.phys_create, reg_index, sh.unit_sinfo[u].reg_phys_create);
+            map_regs(ri.create, reg_index, sh.unit_sinfo[u].reg_all_create);
             /* reg_all_create_use_count */
-            st.unit_sinfo[u].reg_all_create_use_count.resize(rset.size());
-            for(size_t i = 0; i < st.unit_sinfo[u].reg_all_create.size(); i++)
+            sh.unit_sinfo[u].reg_all_create_use_count.resize(ri.create.size());
+            for(size_t i = 0; i < ri.create.size(); i++)
+            {
                 for(size_t j = 0; j < dag.get_succs(unit).size(); j++)
                 {
                     const schedule_dep& dep = dag.get_succs(unit)[j];
-                    if(dep.is_data() && dep.reg() == st.unit_sinfo[u].reg_all_create[i])
-                        st.unit_sinfo[u].reg_all_create_use_count[i]++;
+                    if(dep.is_data() && dep.reg() == ri.create[i])
+                        sh.unit_sinfo[u].reg_all_create_use_count[i]++;
                 }
+                /* a use count of 0 would mean dead */
+                assert(sh.unit_sinfo[u].reg_all_create_use_count[i] > 0 && "Created variable is never used !");
+            }
             /* irp */
-            st.unit_sinfo[u].irp = unit->internal_register_pressure();
+            sh.unit_sinfo[u].irp = unit->internal_register_pressure();
+        }
+        sh.nb_regs = reg_index.size();
+        /* the hash of a set of units is the xor of the hashes of its units,
+         * use a fixed seed so that the search is reproducible */
+        uint64_t seed = 0x9e3779b97f4a7c15ULL;
+        sh.unit_hash.resize(sh.nb_units);
+        for(size_t i = 0; i < sh.nb_units; i++)
+        {
+            uint64_t z = (seed += 0x9e3779b97f4a7c15ULL);
+            z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+            z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+            sh.unit_hash[i] = z ^ (z >> 31);
+        }
+    }
+
+    /* lifetime of a register created by a single unit */
+    struct exp_reg_lifetime
+    {
+        reg_idx_t reg;
+        unit_idx_t creator;
+        std::vector< unit_idx_t > users;
+    };
+
+    void compute_reg_lifetimes(const exp_shared& sh, std::vector< exp_reg_lifetime >& regs)
+    {
+        /* index of each register in regs or SIZE_MAX */
+        std::vector< size_t > index(sh.nb_regs, SIZE_MAX);
+        std::vector< size_t > nb_creators;
+        for(unit_idx_t u = 0; u < sh.nb_units; u++)
+        {
+            const std::vector< reg_idx_t >& create = sh.unit_sinfo[u].reg_all_create;
+            for(size_t i = 0; i < create.size(); i++)
+            {
+                if(index[create[i]] != SIZE_MAX)
+                {
+                    nb_creators[index[create[i]]]++;
+                    continue;
+                }
+                index[create[i]] = regs.size();
+                nb_creators.push_back(1);
+                regs.push_back(exp_reg_lifetime());
+                regs.back().reg = create[i];
+                regs.back().creator = u;
+            }
+        }
+        for(unit_idx_t u = 0; u < sh.nb_units; u++)
+        {
+            const std::vector< reg_idx_t >& use = sh.unit_sinfo[u].reg_use;
+            for(size_t i = 0; i < use.size(); i++)
+                if(index[use[i]] != SIZE_MAX)
+                    regs[index[use[i]]].users.push_back(u);
+        }
+        /* physical registers can be created several times, drop them */
+        size_t j = 0;
+        for(size_t i = 0; i < regs.size(); i++)
+            if(nb_creators[i] == 1 && regs[i].users.size() != 0)
+                regs[j++] = regs[i];
+        regs.resize(j);
+    }
+
+    /* is a created before the last use of b in every schedule ? */
+    bool created_before_last_use(const exp_reg_lifetime& a, const exp_reg_lifetime& b, const bit_matrix& path)
+    {
+        for(size_t i = 0; i < b.users.size(); i++)
+            if(b.users[i] != a.creator && path.test_bit(a.creator, b.users[i]))
+                return true;
+        return false;
+    }
+
+    /**
+     * Bound of each unit given by compute_reg_spans(), the bound is the maximum
+     * over the unscheduled units.
+     */
+    class exp_span_bound : public exp_lower_bound
+    {
+        public:
+        virtual void init(const exp_shared& sh, const bit_matrix& path)
+        {
+            std::vector< exp_reg_lifetime > regs;
+            compute_reg_lifetimes(sh, regs);
+            std::vector< reg_lifetime > lifetimes(regs.size());
+            for(size_t r = 0; r < regs.size(); r++)
+            {
+                lifetimes[r].creator = regs[r].creator;
+                lifetimes[r].users.assign(regs[r].users.begin(), regs[r].users.end());
+            }
+            std::vector< size_t > span;
+            compute_reg_spans(sh.nb_units, lifetimes, path, span);
+            m_order.resize(sh.nb_units);
+            for(unit_idx_t u = 0; u < sh.nb_units; u++)
+            {
+                const exp_static_unit_info& si = sh.unit_sinfo[u];
+                m_order[u].first = span[u] + std::max(si.irp, si.reg_all_create.size());
+                m_order[u].second = u;
+            }
+            /* largest bound first */
+            std::sort(m_order.rbegin(), m_order.rend());
+        }
+
+        virtual size_t bound(const uint64_t *scheduled, const std::vector< size_t >& reg_use_left) const
+        {
+            (void) reg_use_left;
+            for(size_t i = 0; i < m_order.size(); i++)
+                if(!exp_test_bit(scheduled, m_order[i].second))
+                    return m_order[i].first;
+            return 0;
+        }
+
+        protected:
+        std::vector< std::pair< size_t, unit_idx_t > > m_order;
+    };
+
+    /**
+     * Two registers interfere in every schedule if each one is created before
+     * the last use of the other. Lifetimes are intervals so registers which
+     * pairwise interfere are all alive at the same time. The bound is the number
+     * of registers of such a set, built greedily, which are not dead yet.
+     */
+    class exp_interference_bound : public exp_lower_bound
+    {
+        public:
+        virtual void init(const exp_shared& sh, const bit_matrix& path)
+        {
+            std::vector< exp_reg_lifetime > regs;
+            compute_reg_lifetimes(sh, regs);
+            if(regs.size() > EXP_INTERFERENCE_MAX_REGS)
+                return;
+            bit_matrix interfere(regs.size(), regs.size());
+            for(size_t a = 0; a < regs.size(); a++)
+                for(size_t b = a + 1; b < regs.size(); b++)
+                    if(created_before_last_use(regs[a], regs[b], path) &&
+                            created_before_last_use(regs[b], regs[a], path))
+                    {
+                        interfere.set_bit(a, b);
+                        interfere.set_bit(b, a);
+                    }
+            /* most interfering registers first */
+            std::vector< std::pair< size_t, size_t > > order(regs.size());
+            for(size_t r = 0; r < regs.size(); r++)
+                order[r] = std::make_pair(interfere.nb_bits_set_in_row(r), r);
+            std::sort(order.rbegin(), order.rend());
+            std::vector< size_t > clique;
+            for(size_t i = 0; i < order.size(); i++)
+            {
+                size_t r = order[i].second;
+                size_t j = 0;
+                while(j < clique.size() && interfere.test_bit(r, clique[j]))
+                    j++;
+                if(j != clique.size())
+                    continue;
+                clique.push_back(r);
+                m_regs.push_back(std::make_pair(regs[r].reg, regs[r].creator));
+            }
+        }
+
+        virtual size_t bound(const uint64_t *scheduled, const std::vector< size_t >& reg_use_left) const
+        {
+            size_t count = 0;
+            for(size_t i = 0; i < m_regs.size(); i++)
+                if(!exp_test_bit(scheduled, m_regs[i].second) || reg_use_left[m_regs[i].first] != 0)
+                    count++;
+            return count;
+        }
+
+        protected:
+        /* register and its creator */
+        std::vector< std::pair< reg_idx_t, unit_idx_t > > m_regs;
+    };
+
+    exp_shared::~exp_shared()
+    {
+        for(size_t i = 0; i < bounds.size(); i++)
+            delete bounds[i];
+    }
+
+    void init_bounds(exp_shared& sh)
+    {
+        bit_matrix path;
+        sh.dag->build_path_map(path);
+        sh.bounds.push_back(new exp_span_bound);
+        sh.bounds.push_back(new exp_interference_bound);
+        for(size_t i = 0; i < sh.bounds.size(); i++)
+            sh.bounds[i]->init(sh, path);
+    }
+
+    /**
+     * Two units are twins when they have the same predecessors, successors, used
+     * registers and internal pressure, and create registers with the same users.
+     * Swapping twins in a schedule does not change its RP so they are only
+     * scheduled in index order.
+     */
+    void compute_twins(exp_shared& sh)
+    {
+        std::vector< exp_reg_lifetime > regs;
+        compute_reg_lifetimes(sh, regs);
+        std::vector< size_t > index(sh.nb_regs, SIZE_MAX);
+        for(size_t r = 0; r < regs.size(); r++)
+            index[regs[r].reg] = r;
+
+        /* last unit seen with each signature */
+        std::map< std::vector< size_t >, size_t > last;
+        sh.twin_prev.assign(sh.nb_units, SIZE_MAX);
+        for(unit_idx_t u = 0; u < sh.nb_units; u++)
+        {
+            const exp_static_unit_info& si = sh.unit_sinfo[u];
+            if(si.reg_phys_create.size() != 0)
+                continue;
+            /* created registers are described by their users */
+            std::vector< std::vector< size_t > > created;
+            for(size_t i = 0; i < si.reg_all_create.size(); i++)
+            {
+                size_t r = index[si.reg_all_create[i]];
+                if(r == SIZE_MAX)
+                    goto Lnext;
+                created.push_back(std::vector< size_t >(regs[r].users.begin(), regs[r].users.end()));
+                created.back().push_back(si.reg_all_create_use_count[i]);
+            }
+            std::sort(created.begin(), created.end());
+            {
+                std::vector< size_t > sig;
+                sig.push_back(si.irp);
+                sig.push_back(si.unit_depend.size());
+                sig.insert(sig.end(), si.unit_depend.begin(), si.unit_depend.end());
+                sig.push_back(si.unit_release.size());
+                sig.insert(sig.end(), si.unit_release.begin(), si.unit_release.end());
+                sig.push_back(si.reg_use.size());
+                sig.insert(sig.end(), si.reg_use.begin(), si.reg_use.end());
+                for(size_t i = 0; i < created.size(); i++)
+                {
+                    sig.push_back(created[i].size());
+                    sig.insert(sig.end(), created[i].begin(), created[i].end());
+                }
+
+                std::map< std::vector< size_t >, size_t >::iterator it = last.find(sig);
+                if(it != last.end())
+                {
+                    sh.twin_prev[u] = it->second;
+                    it->second = u;
+                }
+                else
+                    last[sig] = u;
+            }
+            Lnext:
+            continue;
         }
     }
 
-    inline void start_timer(exp_state& st)
+    template< typename K >
+    size_t remainder_bound(const exp_state< K >& st)
     {
-        /* set the diviser to 100, this will cause the expire check to call clock
-         * only once in 100 times, to avoid too much overhead */
-        st.clock_div = 100;
-        st.clock_cycle = st.clock_div;
-        st.clock_start = clock();
+        size_t lb = 0;
+        for(size_t i = 0; i < st.sh->bounds.size(); i++)
+            lb = std::max(lb, st.sh->bounds[i]->bound(st.cache_bm.chunks(), st.reg_use_left));
+        return lb;
     }
 
-    inline bool exp_ire(exp_state& st)
+    /* the workers read the best RP without taking the lock, it is published
+     * after the best schedule */
+    inline size_t exp_best_rp(const exp_shared& sh)
     {
-        if(st.timeout == 0)
+        return __atomic_load_n(&sh.best_rp, __ATOMIC_ACQUIRE);
+    }
+
+    inline bool exp_stopped(const exp_shared& sh)
+    {
+        return __atomic_load_n(&sh.stop, __ATOMIC_ACQUIRE);
+    }
+
+    inline void exp_set_stop(exp_shared& sh, bool stop)
+    {
+        __atomic_store_n(&sh.stop, stop, __ATOMIC_RELEASE);
+    }
+
+    template< typename K >
+    inline void flush_work(exp_state< K >& st)
+    {
+        st.sh->meter.add_work(st.work_pending);
+        st.work_pending = 0;
+    }
+
+    /* count a node, return true if the search must stop */
+    template< typename K >
+    inline bool exp_ire(exp_state< K >& st)
+    {
+        if(exp_stopped(*st.sh))
+            return true;
+        if(++st.work_pending < EXP_WORK_BATCH)
             return false;
-        st.clock_cycle--;
-        if(st.clock_cycle == 0)
+        flush_work(st);
+        if(st.sh->meter.is_exhausted())
         {
-            st.clock_cycle = st.clock_div;
-            clock_t c = clock();
-            if((c - st.clock_start) >= (long)((CLOCKS_PER_SEC / 1000) * st.timeout))
-                return true;
+            exp_set_stop(*st.sh, true);
+            return true;
         }
-        
+
         return false;
     }
 
-    void init_state(exp_state& st)
+    /* put the worker back at the root of the search tree */
+    template< typename K >
+    void reset_state(exp_state< K >& st)
     {
-        /* set global state */
-        st.has_schedule = false;
+        const exp_shared& sh = *st.sh;
         st.cur_rp = 0;
+        st.reg_use_left.assign(sh.nb_regs, 0);
+        st.nb_live_regs = 0;
+        st.cur_schedule.clear();
         /* compute root nodes */
-        for(size_t i = 0; i < st.nb_units; i++)
-            if(st.unit_sinfo[i].unit_depend.size() == 0)
-                st.schedulable.push_back(i);
+        exp_list_clear(st.schedulable, sh.nb_units);
+        for(size_t i = 0; i < sh.nb_units; i++)
+            if(sh.unit_sinfo[i].unit_depend.size() == 0)
+                exp_list_release(st.schedulable, i);
         /* each nodes still depends on all its predecessors */
-        st.unit_dinfo.resize(st.nb_units);
-        for(size_t i = 0; i < st.nb_units; i++)
-            st.unit_dinfo[i].nb_dep_left = st.unit_sinfo[i].unit_depend.size();
-        /* start timer */
-        start_timer(st);
+        st.nb_dep_left.resize(sh.nb_units);
+        for(size_t i = 0; i < sh.nb_units; i++)
+            st.nb_dep_left[i] = sh.unit_sinfo[i].unit_depend.size();
+
+        st.cache_bm.set_nb_bits(sh.nb_units);
+        st.cache_hash = 0;
+        st.depth = 0;
+    }
+
+    template< typename I >
+    void build_release_lists(const exp_shared& sh, exp_release_lists< I >& rl)
+    {
+        rl.first.resize(sh.nb_units + 1);
+        rl.units.clear();
+        for(size_t u = 0; u < sh.nb_units; u++)
+        {
+            const std::vector< unit_idx_t >& rel = sh.unit_sinfo[u].unit_release;
+            rl.first[u] = rl.units.size();
+            for(size_t j = 0; j < rel.size(); j++)
+                rl.units.push_back((I)rel[j]);
+        }
+        rl.first[sh.nb_units] = rl.units.size();
+    }
+
+    template< typename K >
+    void init_state(exp_state< K >& st, exp_shared *sh,
+        const exp_release_lists< typename K::unit_t > *release, size_t worker)
+    {
+        st.sh = sh;
+        st.release = release;
+        st.worker = worker;
+        st.nb_nodes = 0;
+        st.work_pending = 0;
+        reset_state(st);
+    }
+
+    /* check that a unit does not create a physical register that is already alive */
+    template< typename K >
+    bool can_schedule(exp_state< K >& st, unit_idx_t unit)
+    {
+        const exp_static_unit_info& si = st.sh->unit_sinfo[unit];
+        for(size_t j = 0; j < si.reg_phys_create.size(); j++)
+        {
+            reg_idx_t reg = si.reg_phys_create[j];
+            if(st.reg_use_left[reg] == 0)
+                continue; /* safe, it's not alive */
+            /* unsafe, it is alive, so for the unit to be schedulable we must make sure
+             * that it also destroys the register, that is, that this is the last use of
+             * the register */
+            if(st.reg_use_left[reg] == 1 && container_contains(si.reg_use, reg))
+                continue; /* safe */
+            /* the unit is not schedulable */
+            return false;
+        }
+        return true;
+    }
+
+    /* are the twins of a unit with a smaller index already scheduled ? */
+    template< typename K >
+    inline bool is_canonical(const exp_state< K >& st, unit_idx_t unit)
+    {
+        size_t prev = st.sh->twin_prev[unit];
+        return prev == SIZE_MAX || st.cache_bm.test_bit(prev);
+    }
+
+    /**
+     * A unit which creates no register and kills at least as many registers as
+     * its internal pressure never goes above the current number of live registers.
+     * Scheduling it earlier only shortens lifetimes so it can be scheduled right
+     * away without trying the other units. This does not depend on the current RP
+     * so it agrees with the cache. Return its position or SIZE_MAX.
+     */
+    template< typename K >
+    size_t find_forced_unit(exp_state< K >& st)
+    {
+        for(size_t pos = exp_list_first(st.schedulable); pos != SIZE_MAX;
+                pos = exp_list_next(st.schedulable, pos))
+        {
+            unit_idx_t unit = exp_list_unit(st.schedulable, pos);
+            const exp_static_unit_info& si = st.sh->unit_sinfo[unit];
+            if(si.reg_all_create.size() != 0 || !is_canonical(st, unit))
+                continue;
+            size_t kills = 0;
+            for(size_t j = 0; j < si.reg_use.size(); j++)
+            {
+                assert(st.reg_use_left[si.reg_use[j]] > 0 && "Used variable is not alive !");
+                if(st.reg_use_left[si.reg_use[j]] == 1)
+                    kills++;
+            }
+            if(si.irp <= kills)
+                return pos;
+        }
+        return SIZE_MAX;
+    }
+
+    /* schedule the schedulable unit at a position, return its instantaneous RP */
+    template< typename K >
+    size_t schedule_unit(exp_state< K >& st, size_t pos)
+    {
+        unit_idx_t unit = exp_list_unit(st.schedulable, pos);
+        const exp_static_unit_info& si = st.sh->unit_sinfo[unit];
+
+        /* mark unit as scheduled */
+        st.cache_bm.set_bit(unit);
+        st.cache_hash ^= st.sh->unit_hash[unit];
+
+        /* remove unit from schedulables */
+        exp_list_remove(st.schedulable, pos);
+        /* and add it to current schedule */
+        st.cur_schedule.push_back(unit);
+
+        /* update regs and kill regs */
+        for(size_t j = 0; j < si.reg_use.size(); j++)
+        {
+            reg_idx_t reg = si.reg_use[j];
+            assert(st.reg_use_left[reg] > 0 && "Used variable is not alive !");
+
+            /* dead ? */
+            if(--st.reg_use_left[reg] == 0)
+                st.nb_live_regs--;
+        }
+
+        /* compute RP */
+        size_t inst_rp = st.nb_live_regs + si.irp;
+
+        /* create regs */
+        for(size_t j = 0; j < si.reg_all_create.size(); j++)
+        {
+            reg_idx_t reg = si.reg_all_create[j];
+            assert(st.reg_use_left[reg] == 0 && "Created variable is already alive !");
+
+            st.reg_use_left[reg] = si.reg_all_create_use_count[j];
+        }
+        st.nb_live_regs += si.reg_all_create.size();
+
+        /* compute RP */
+        inst_rp = std::max(inst_rp, st.nb_live_regs);
+        st.cur_rp = std::max(st.cur_rp, inst_rp);
+
+        /* update deps and release units */
+        const exp_release_lists< typename K::unit_t >& rl = *st.release;
+        for(size_t j = rl.first[unit]; j < rl.first[unit + 1]; j++)
+        {
+            unit_idx_t rel = rl.units[j];
+            assert(st.nb_dep_left[rel] > 0 && "Released unit has no dependencies left !");
+
+            /* Free ? */
+            if(--st.nb_dep_left[rel] == 0)
+                exp_list_release(st.schedulable, rel);
+        }
+
+        return inst_rp;
+    }
+
+    /* undo schedule_unit(st, pos), except for the RP which is restored by the caller */
+    template< typename K >
+    void unschedule_unit(exp_state< K >& st, size_t pos)
+    {
+        unit_idx_t unit = st.cur_schedule.back();
+        const exp_static_unit_info& si = st.sh->unit_sinfo[unit];
+
+        st.cur_schedule.pop_back();
+        /* unmark unit as scheduled */
+        st.cache_bm.clear_bit(unit);
+        st.cache_hash ^= st.sh->unit_hash[unit];
+
+        size_t nb_unreleased = 0;
+        /* deupdate deps and unrelease units */
+        const exp_release_lists< typename K::unit_t >& rl = *st.release;
+        for(size_t j = rl.first[unit]; j < rl.first[unit + 1]; j++)
+        {
+            unit_idx_t rel = rl.units[j];
+
+            if((++st.nb_dep_left[rel]) == 1)
+                exp_list_unrelease(st.schedulable, rel, nb_unreleased);
+        }
+        exp_list_restore(st.schedulable, pos, unit, nb_unreleased);
+
+        /* uncreate regs */
+        for(size_t j = 0; j < si.reg_all_create.size(); j++)
+        {
+            reg_idx_t reg = si.reg_all_create[j];
+            assert(st.reg_use_left[reg] == si.reg_all_create_use_count[j]
+                    && "Created variable has wrong use count !");
+            st.reg_use_left[reg] = 0;
+        }
+        st.nb_live_regs -= si.reg_all_create.size();
+
+        /* deupdate regs and unkill regs */
+        for(size_t j = 0; j < si.reg_use.size(); j++)
+            if((++st.reg_use_left[si.reg_use[j]]) == 1)
+                st.nb_live_regs++;
+    }
+
+    /* schedule a prefix from the root, return false if it is not a valid schedule */
+    template< typename K >
+    bool replay_schedule(exp_state< K >& st, const std::vector< unit_idx_t >& sched)
+    {
+        reset_state(st);
+        for(size_t k = 0; k < sched.size(); k++)
+        {
+            size_t pos = exp_list_find(st.schedulable, sched[k]);
+            if(pos == SIZE_MAX || !can_schedule(st, sched[k]))
+                return false;
+            schedule_unit(st, pos);
+        }
+        return true;
+    }
+
+    /* replace the best schedule if rp improves it */
+    template< typename I >
+    void update_best(exp_shared& sh, size_t rp, const std::vector< I >& sched)
+    {
+        #ifdef ENABLE_THREADS
+        if(sh.parallel)
+            pthread_mutex_lock(&sh.best_lock);
+        #endif
+        if(rp < sh.best_rp)
+        {
+            sh.best_schedule.assign(sched.begin(), sched.end());
+            __atomic_store_n(&sh.best_rp, rp, __ATOMIC_RELEASE);
+
+            #ifdef ENABLE_SCHED_AUTO_CHECK_RP
+            {
+                assert(sh.best_schedule.size() == sh.nb_units);
+                generic_schedule_chain chain;
+                for(size_t i = 0; i < sh.best_schedule.size(); i++)
+                    chain.append_unit(sh.dag->get_units()[sh.best_schedule[i]]);
+                assert(chain.get_unit_count() == sh.nb_units);
+                if(chain.compute_rp_against_dag(*sh.dag) != sh.best_rp)
+                {
+                    std::cout << "claimed: " << sh.best_rp << "\n";
+                    std::cout << "actual: " << chain.compute_rp_against_dag(*sh.dag) << "\n";
+                    assert(false);
+                }
+            }
+            #endif
+
+            /* no schedule can do better, stop everything */
+            if(rp <= sh.root_bound)
+                exp_set_stop(sh, true);
+
+            if(sh.listener)
+            {
+                generic_schedule_chain chain;
+                for(size_t i = 0; i < sched.size(); i++)
+                    chain.append_unit(sh.dag->get_units()[sched[i]]);
+                sh.listener->schedule_improved(*sh.dag, chain, rp, sh.root_bound);
+            }
+        }
+        #ifdef ENABLE_THREADS
+        if(sh.parallel)
+            pthread_mutex_unlock(&sh.best_lock);
+        #endif
+    }
+
+    #ifdef ENABLE_THREADS
+    template< typename K >
+    void push_task(exp_state< K >& st, const std::vector< unit_idx_t >& prefix)
+    {
+        exp_task_queue& q = st.sh->queues[st.worker];
+        /* count the task before anyone can pick it */
+        __sync_fetch_and_add(&st.sh->nb_tasks, 1);
+        pthread_mutex_lock(&q.lock);
+        q.tasks.push_back(prefix);
+        pthread_mutex_unlock(&q.lock);
+    }
+
+    /* take the newest task of our queue, or steal the oldest one of another worker */
+    template< typename K >
+    bool pop_task(exp_state< K >& st, std::vector< unit_idx_t >& prefix)
+    {
+        std::vector< exp_task_queue >& queues = st.sh->queues;
+        for(size_t k = 0; k < queues.size(); k++)
+        {
+            exp_task_queue& q = queues[(st.worker + k) % queues.size()];
+            bool found = false;
+            pthread_mutex_lock(&q.lock);
+            if(q.tasks.size() != 0)
+            {
+                found = true;
+                if(k == 0)
+                {
+                    prefix.swap(q.tasks.back());
+                    q.tasks.pop_back();
+                }
+                else
+                {
+                    prefix.swap(q.tasks.front());
+                    q.tasks.pop_front();
+                }
+            }
+            pthread_mutex_unlock(&q.lock);
+            if(found)
+                return true;
+        }
+        return false;
+    }
+    #endif
 
-        st.cache_bm.set_nb_bits(st.nb_units);
+    /* start a search below the current schedule */
+    template< typename K >
+    void start_search(exp_state< K >& st)
+    {
+        /* preallocate the frames so that the search never allocates them */
+        st.frames.resize(st.sh->nb_units - st.cur_schedule.size() + 1);
+        st.depth = 1;
+        st.action = action_enter;
     }
 
-    void do_schedule(exp_state& st)
+    /* handle a node which was just reached, return the next action */
+    template< typename K >
+    exp_action enter_node(exp_state< K >& st, exp_frame< K >& f)
     {
+        exp_shared& sh = *st.sh;
         assert(st.cache_bm.nb_bits_set() == st.cur_schedule.size() && "Inconsistent bitmap");
         #ifdef ENABLE_EXPENSIVE_SCHED_AUTO_CHECK_RP
         {
             generic_schedule_chain chain;
             for(size_t i = 0; i < st.cur_schedule.size(); i++)
-                chain.append_unit(st.dag->get_units()[st.cur_schedule[i]]);
-            if(chain.compute_rp_against_dag(*st.dag, false) != st.cur_rp)
+                chain.append_unit(sh.dag->get_units()[st.cur_schedule[i]]);
+            if(chain.compute_rp_against_dag(*sh.dag, false) != st.cur_rp)
             {
                 std::cout << "claimed: " << st.cur_rp << "\n";
-                std::cout << "actual " << chain.compute_rp_against_dag(*st.dag, false) << "\n";
+                std::cout << "actual " << chain.compute_rp_against_dag(*sh.dag, false) << "\n";
                 assert(false);
             }
         }
         #endif
-        /* timer */
-        if(exp_ire(st))
-            throw exp_timeout();
-        /* cache entry */
-        exp_cache_result& cc = st.cache_mem[st.cache_bm];
+        /* cache entry: work on a copy because the entry can be evicted
+         * by the children or by other workers, it is stored back at the end */
+        exp_cache_result& cc = f.cc;
+        cc = exp_cache_result();
+        sh.cache.find(st.cache_bm.chunks(), st.cache_hash, cc);
         /* if we are in the same situation as before but without a best RP, stop now */
         if(cc.fw.valid && cc.fw.achieved_rp <= st.cur_rp)
-            return;
+            return action_leave;
         cc.fw.valid = true;
         cc.fw.achieved_rp = st.cur_rp;
+        sh.cache.store(st.cache_bm.chunks(), st.cache_hash, cc, 0);
+        f.first_node = st.nb_nodes++;
         /* if the current RP is already higher than the best, stop now */
-        if(st.has_schedule && st.cur_rp >= st.best_rp)
-            return;
+        if(st.cur_rp >= exp_best_rp(sh))
+            return action_leave;
+        /* same if the remaining units cannot be scheduled without reaching the best */
+        if(remainder_bound(st) >= exp_best_rp(sh))
+            return action_leave;
         /* do we have some cached result ? */
         if(cc.bw.valid)
         {
             /* see if it would produce a best result */
             size_t new_rp = std::max(st.cur_rp, cc.bw.achieved_rp);
 
-            if(st.has_schedule && new_rp >= st.best_rp)
+            if(new_rp >= exp_best_rp(sh))
             {
                 /* no, then if the result is optimal, just stop */
                 if(cc.bw.optimal)
-                    return;
+                    return action_leave;
                 /* no, but the backward result is not optimal so let's try to improve it */
                 goto Lcompute;
             }
             /* yes, then rebuild a schedule from cache */
-            bitmap bm(st.cache_bm);
-            std::vector< unit_idx_t > sched = st.cur_schedule;
+            typename K::set_t bm(st.cache_bm);
+            uint64_t hash = st.cache_hash;
+            std::vector< unit_idx_t > sched(st.cur_schedule.begin(), st.cur_schedule.end());
 
             /* note: if the result has been cached for st.cache_bm,
-             *       then it must have been for all the subsequent subgraph,
-             *       so there is not need to check */
-            while(sched.size() < st.nb_units)
+             *       then it has been for all the subsequent subgraphs,
+             *       but some of them might have been evicted since */
+            while(sched.size() < sh.nb_units)
             {
-                assert(st.cache_mem[bm].bw.valid && "Cached result with non-cached best path ?");
-                unit_idx_t unit = st.cache_mem[bm].bw.best_unit;
+                exp_cache_result ce;
+                if(!sh.cache.find(bm.chunks(), hash, ce) || !ce.bw.valid)
+                    goto Lcompute;
+                unit_idx_t unit = ce.bw.best_unit;
                 sched.push_back(unit);
                 bm.set_bit(unit);
+                hash ^= sh.unit_hash[unit];
             }
-            /* sanity checks */
-            #ifdef ENABLE_SCHED_AUTO_CHECK_RP
-            generic_schedule_chain chain;
-            for(size_t i = 0; i < sched.size(); i++)
-                chain.append_unit(st.dag->get_units()[sched[i]]);
-            assert(sched.size() == st.nb_units);
-            if(chain.compute_rp_against_dag(*st.dag) != new_rp)
+            /* the entries along the chain might have been overwritten by more
+             * recent computations since the entry of this node was built so
+             * compute the actual RP of the schedule */
             {
-                std::cout << "claimed: " << new_rp << "\n";
-                std::cout << "actual " << chain.compute_rp_against_dag(*st.dag) << "\n";
-                assert(false);
+                exp_state< K > chk;
+                chk.sh = &sh;
+                chk.release = st.release;
+                if(!replay_schedule(chk, sched))
+                    goto Lcompute;
+                new_rp = chk.cur_rp;
             }
-            #endif
-
-            //std::cout << "cc new RP=" << new_rp << "\n";
+            if(new_rp >= exp_best_rp(sh))
+                goto Lcompute;
 
             /* update best */
-            st.best_rp = new_rp;
-            st.best_schedule = sched;
-            
+            update_best(sh, new_rp, sched);
+
             /* stop */
-            return;
+            return action_leave;
         }
         /* either we have no cached result or not good enough cache, so let's compute something */
         Lcompute:
-        
+
         /* base case: no more schedulable units */
-        if(st.schedulable.size() == 0)
+        if(st.cur_schedule.size() == sh.nb_units)
         {
-            assert(st.live_regs.size() == 0 && "Variables still alive at end of schedule !");
+            assert(st.nb_live_regs == 0 && "Variables still alive at end of schedule !");
 
-            /* if we are there, we should always improve */
-            assert((!st.has_schedule || st.cur_rp < st.best_rp) && "Why the hell are we there if we do not improve best ?");
-            
-            //std::cout << "new RP=" << st.cur_rp << "\n";
-            /* update best */
-            st.has_schedule = true;
-            st.best_rp = st.cur_rp;
-            st.best_schedule = st.cur_schedule;
+            /* if we are there, we should always improve, unless another worker
+             * found something better in the meantime */
+            assert((sh.parallel || st.cur_rp < exp_best_rp(sh)) && "Why the hell are we there if we do not improve best ?");
 
-            #ifdef ENABLE_SCHED_AUTO_CHECK_RP
-            {
-                assert(st.best_schedule.size() == st.nb_units);
-                generic_schedule_chain chain;
-                for(size_t i = 0; i < st.best_schedule.size(); i++)
-                    chain.append_unit(st.dag->get_units()[st.best_schedule[i]]);
-                assert(chain.get_unit_count() == st.nb_units);
-                if(chain.compute_rp_against_dag(*st.dag) != st.best_rp)
-                {
-                    std::cout << "claimed: " << st.best_rp << "\n";
-                    std::cout << "actual: " << chain.compute_rp_against_dag(*st.dag) << "\n";
-                    assert(false);
-                }
-            }
-            #endif
+            /* update best */
+            update_best(sh, st.cur_rp, st.cur_schedule);
 
             /* no cached for leaves */
-            return;
+            return action_leave;
         }
 
         /* normal case: there are things to schedule */
-        #define OPTIMIZE_SAVE_RESTORE
-
         cc.bw.valid = false;
         cc.bw.optimal = true;
         cc.bw.best_unit = SIZE_MAX;
         cc.bw.achieved_rp = SIZE_MAX;
-        /* try each schedulable unit */
-        for(size_t i = 0; i < st.schedulable.size(); i++)
-        {
-            #ifndef OPTIMIZE_SAVE_RESTORE
-            /* save live regs */
-            std::map< schedule_dep::reg_t, exp_live_reg > old_live = st.live_regs;
-            /* save schedulable */
-            std::vector< unit_idx_t > old_schedulable = st.schedulable;
-            /* save dynamic info */
-            std::vector< exp_dynamic_unit_info > old_dinfo = st.unit_dinfo;
-            #endif
-            /* save RP */
-            size_t old_rp = st.cur_rp;
-
-            unit_idx_t unit = st.schedulable[i];
+        f.split = false;
+        /* try each schedulable unit, or only the forced one if any */
+        exp_cursor_start(f.children, st.schedulable, find_forced_unit(st));
+        return action_next;
+    }
 
-            /* Even before trying, check that this unit does not create a physical register that
-             * is already alive */
-            bool phys_prevent_sched = false;
-            for(size_t j = 0; j < st.unit_sinfo[unit].reg_phys_create.size(); j++)
+    /* schedule the next child of a node, return false if there is none left */
+    template< typename K >
+    bool next_child(exp_state< K >& st, exp_frame< K >& f)
+    {
+        for(; exp_cursor_pos(f.children) != SIZE_MAX; exp_cursor_advance(f.children))
+        {
+            size_t pos = exp_cursor_pos(f.children);
+            #ifdef ENABLE_THREADS
+            /* if some workers are starving, give them the subtrees of the remaining
+             * units and only handle the current one */
+            exp_shared& sh = *st.sh;
+            if(sh.parallel && !f.split && __atomic_load_n(&sh.nb_idle, __ATOMIC_RELAXED) > 0 && exp_cursor_has_more(f.children) &&
+                    sh.nb_units - st.cur_schedule.size() >= EXP_SPLIT_MIN_UNITS)
             {
-                schedule_dep::reg_t reg = st.unit_sinfo[unit].reg_phys_create[j];
-                if(st.live_regs.find(reg) == st.live_regs.end())
-                    continue; /* safe, it's not alive */
-                /* unsafe, it is alive, so for the unit to be schedulable we must make sure
-                 * that it also destroys the register, that is, that this is the last use of
-                 * the register */
-                if(container_contains(st.unit_sinfo[unit].reg_use, reg) &&
-                        st.live_regs[reg].nb_use_left == 1)
-                    continue; /* safe */
-                /* the unit is not schedulable */
-                phys_prevent_sched = true;
+                std::vector< unit_idx_t > rest;
+                exp_cursor_rest(f.children, st.schedulable, rest);
+                std::vector< unit_idx_t > prefix(st.cur_schedule.begin(), st.cur_schedule.end());
+                prefix.push_back(0);
+                for(size_t j = 0; j < rest.size(); j++)
+                {
+                    if(!is_canonical(st, rest[j]))
+                        continue;
+                    prefix.back() = rest[j];
+                    push_task(st, prefix);
+                }
+                /* the entry will only cover part of the subtree */
+                f.split = true;
+                f.cc.bw.optimal = false;
             }
-            if(phys_prevent_sched)
-                continue;
+            #endif
+            f.unit = exp_list_unit(st.schedulable, pos);
 
-            /* mark unit as scheduled */
-            st.cache_bm.set_bit(unit);
-            /* get caching state */
-            const exp_cache_result& rec_cc = st.cache_mem[st.cache_bm];
-            
-            /* remove unit from schedulables */
-            unordered_vector_remove(i, st.schedulable);
-            /* and add it to current schedule */
-            st.cur_schedule.push_back(unit);
-
-            /* update regs and kill regs */
-            for(size_t j = 0; j < st.unit_sinfo[unit].reg_use.size(); j++)
+            /* Even before trying, check that this unit does not create a physical register that
+             * is already alive, and only keep one order of twins */
+            if(!is_canonical(st, f.unit) || !can_schedule(st, f.unit))
             {
-                schedule_dep::reg_t reg = st.unit_sinfo[unit].reg_use[j];
-                assert(st.live_regs.find(reg) != st.live_regs.end() && "Used variable is not alive !");
-                assert(st.live_regs[reg].id == reg && "Inconsistent reg map !");
-                assert(st.live_regs[reg].nb_use_left > 0 && "Variable has more use than expected !");
-                
-                st.live_regs[reg].nb_use_left--;
-                /* dead ? */
-                if(st.live_regs[reg].nb_use_left == 0)
-                    st.live_regs.erase(reg);
+                if(f.split)
+                    return false;
+                continue;
             }
 
-            /* compute RP */
-            size_t inst_rp = st.live_regs.size() + st.unit_sinfo[unit].irp;
+            /* save RP */
+            f.old_rp = st.cur_rp;
+            f.inst_rp = schedule_unit(st, pos);
+            return true;
+        }
+        return false;
+    }
 
-            /* create regs */
-            for(size_t j = 0; j < st.unit_sinfo[unit].reg_all_create.size(); j++)
+    /* undo the current child of a node once its subtree is explored, return false
+     * if the node is done */
+    template< typename K >
+    bool child_done(exp_state< K >& st, exp_frame< K >& f)
+    {
+        exp_shared& sh = *st.sh;
+        exp_cache_result& cc = f.cc;
+        /* get caching state */
+        exp_cache_result rec_cc;
+        bool has_rec_cc = sh.cache.find(st.cache_bm.chunks(), st.cache_hash, rec_cc);
+        /* don't bother if it's not valid */
+        if(has_rec_cc && rec_cc.bw.valid)
+        {
+            /* now we have something valid to cache */
+            cc.bw.valid = true;
+            /* optimality is not easy to get */
+            cc.bw.optimal = cc.bw.optimal && rec_cc.bw.optimal;
+            /* is it better than current ? */
+            size_t achieved_rp = std::max(rec_cc.bw.achieved_rp, f.inst_rp);
+            if(achieved_rp < cc.bw.achieved_rp)
             {
-                schedule_dep::reg_t reg = st.unit_sinfo[unit].reg_all_create[j];
-                assert(st.live_regs.find(reg) == st.live_regs.end() && "Created variable is already alive !");
-
-                st.live_regs[reg].id = reg;
-                st.live_regs[reg].nb_use_left = st.unit_sinfo[unit].reg_all_create_use_count[j];
+                cc.bw.achieved_rp = achieved_rp;
+                cc.bw.best_unit = f.unit;
             }
+        }
+        else
+        {
+            /* if we can't get a valid entry, then we can't claim optimality */
+            cc.bw.optimal = false;
+        }
 
-            /* compute RP */
-            inst_rp = std::max(inst_rp, st.live_regs.size());
-            st.cur_rp = std::max(st.cur_rp, inst_rp);
+        /* restore everything */
+        st.cur_rp = f.old_rp;
+        unschedule_unit(st, exp_cursor_pos(f.children));
 
-            /* update deps and release units */
-            for(size_t j = 0; j < st.unit_sinfo[unit].unit_release.size(); j++)
-            {
-                unit_idx_t rel = st.unit_sinfo[unit].unit_release[j];
-                assert(st.unit_dinfo[rel].nb_dep_left > 0 && "Released unit has no dependencies left !");
+        /* the other units are handled by other workers */
+        if(f.split)
+            return false;
+
+        /* At this point, we have an opportunity to stop
+         * Indeed, if the current register pressure is already higher than the best,
+         * we can stop now and mark the caching as suboptimal. If it happens than we
+         * need a better one later on, then we'll continue the computation
+         *
+         * note: this is just a speedup trick because it will already happen when the
+         *       child is entered but we will avoid lots of computations
+         *
+         * Of course, don't do it if this is the last schedulable unit ! */
+        if(st.cur_rp >= exp_best_rp(sh) && exp_cursor_has_more(f.children))
+        {
+            cc.bw.optimal = false;
+            return false;
+        }
+        exp_cursor_advance(f.children);
+        return true;
+    }
 
-                st.unit_dinfo[rel].nb_dep_left--;
-                /* Free ? */
-                if(st.unit_dinfo[rel].nb_dep_left == 0)
-                    st.schedulable.push_back(rel);
+    /**
+     * Depth first search below the schedule given to start_search. The recursion
+     * is unrolled on st.frames: the top frame is the current node and the frame
+     * below it is its parent, whose current child is the last scheduled unit.
+     * Return true when the search is over, and false when it was stopped by the
+     * budget or by another worker; calling it again then resumes the search
+     * where it stopped.
+     */
+    template< typename K >
+    bool run_search(exp_state< K >& st)
+    {
+        exp_shared& sh = *st.sh;
+        while(st.depth != 0)
+        {
+            exp_frame< K >& f = st.frames[st.depth - 1];
+            switch(st.action)
+            {
+                case action_enter:
+                    /* budget */
+                    if(exp_ire(st))
+                        return false;
+                    st.action = enter_node(st, f);
+                    break;
+                case action_next:
+                    if(next_child(st, f))
+                    {
+                        st.depth++;
+                        st.action = action_enter;
+                    }
+                    else
+                    {
+                        sh.cache.store(st.cache_bm.chunks(), st.cache_hash, f.cc, st.nb_nodes - f.first_node);
+                        st.action = action_leave;
+                    }
+                    break;
+                case action_leave:
+                    st.depth--;
+                    if(st.depth != 0 && !child_done(st, st.frames[st.depth - 1]))
+                    {
+                        exp_frame< K >& p = st.frames[st.depth - 1];
+                        sh.cache.store(st.cache_bm.chunks(), st.cache_hash, p.cc, st.nb_nodes - p.first_node);
+                        /* the parent is done as well */
+                        st.action = action_leave;
+                    }
+                    else
+                        st.action = action_next;
+                    break;
             }
+        }
+        return true;
+    }
+
+    #ifdef ENABLE_THREADS
+    /* explore the subtree below each prefix until there is no work left */
+    template< typename K >
+    void exp_worker(exp_state< K >& st)
+    {
+        exp_shared& sh = *st.sh;
+        std::vector< unit_idx_t > prefix;
+        bool idle = false;
 
-            /* schedule */
-            do_schedule(st);
-            /* unmark unit as scheduled */
-            st.cache_bm.clear_bit(unit);
-            /* don't bother if it's not valid */
-            if(rec_cc.bw.valid)
+        while(!exp_stopped(sh))
+        {
+            /* a task interrupted by the budget is resumed first */
+            if(st.depth == 0)
             {
-                /* now we have something valid to cache */
-                cc.bw.valid = true;
-                /* optimality is not easy to get */
-                cc.bw.optimal = cc.bw.optimal && rec_cc.bw.optimal;
-                /* is it better than current ? */
-                size_t achieved_rp = std::max(rec_cc.bw.achieved_rp, inst_rp);
-                if(achieved_rp < cc.bw.achieved_rp)
+                if(!pop_task(st, prefix))
                 {
-                    cc.bw.achieved_rp = achieved_rp;
-                    cc.bw.best_unit = unit;
+                    /* no more tasks and nobody can create one */
+                    if(__atomic_load_n(&sh.nb_tasks, __ATOMIC_ACQUIRE) == 0)
+                        break;
+                    if(!idle)
+                    {
+                        idle = true;
+                        __sync_fetch_and_add(&sh.nb_idle, 1);
+                    }
+                    sched_yield();
+                    continue;
                 }
+                if(idle)
+                {
+                    idle = false;
+                    __sync_fetch_and_sub(&sh.nb_idle, 1);
+                }
+                if(!replay_schedule(st, prefix))
+                {
+                    __sync_fetch_and_sub(&sh.nb_tasks, 1);
+                    continue;
+                }
+                start_search(st);
             }
-            else
-            {
-                /* if we can't get a valid entry, then we can't claim optimality */
-                cc.bw.optimal = false;
-            }
+            if(run_search(st))
+                __sync_fetch_and_sub(&sh.nb_tasks, 1);
+        }
+        if(idle)
+            __sync_fetch_and_sub(&sh.nb_idle, 1);
+    }
 
-            /* restore everything */
-            st.cur_rp = old_rp;
-            st.cur_schedule.pop_back();
+    template< typename K >
+    void *exp_worker_thread(void *st)
+    {
+        exp_worker(*(exp_state< K > *)st);
+        return 0;
+    }
 
-            #ifdef OPTIMIZE_SAVE_RESTORE
-            size_t to_remove = 0;
-            /* deupdate deps and unrelease units */
-            for(size_t j = 0; j < st.unit_sinfo[unit].unit_release.size(); j++)
-            {
-                unit_idx_t rel = st.unit_sinfo[unit].unit_release[j];
+    /* run the workers until there is no work left or the search is stopped,
+     * return true if the search is over */
+    template< typename K >
+    bool exp_parallel_search(exp_shared& sh, std::vector< exp_state< K > >& states)
+    {
+        /* the calling thread is the first worker */
+        std::vector< pthread_t > threads(states.size());
+        std::vector< bool > started(states.size(), false);
+        for(size_t t = 1; t < states.size(); t++)
+            started[t] = pthread_create(&threads[t], 0, &exp_worker_thread< K >, &states[t]) == 0;
+        exp_worker(states[0]);
+        for(size_t t = 1; t < states.size(); t++)
+            if(started[t])
+                pthread_join(threads[t], 0);
+        return __atomic_load_n(&sh.nb_tasks, __ATOMIC_ACQUIRE) == 0;
+    }
+    #endif
 
-                if((++st.unit_dinfo[rel].nb_dep_left) == 1)
-                    to_remove++;
-            }
-            /* WARNING: you enter dangerous waters here, this
-             *          highly depends on the semantics of
-             *          unordered_vector_remove and how st.schedulable
-             *          is updated */
-            assert(st.schedulable.size() >= to_remove);
-            st.schedulable.resize(st.schedulable.size() + 1 - to_remove);
-            st.schedulable[st.schedulable.size() - 1] = st.schedulable[i];
-            st.schedulable[i] = unit;
-
-            /* uncreate regs */
-            for(size_t j = 0; j < st.unit_sinfo[unit].reg_all_create.size(); j++)
-            {
-                schedule_dep::reg_t reg = st.unit_sinfo[unit].reg_all_create[j];
-                assert(st.live_regs.find(reg) != st.live_regs.end() && "Created variable is not alive !");
-                assert(st.live_regs[reg].nb_use_left ==  st.unit_sinfo[unit].reg_all_create_use_count[j]
-                        && "Created variable has wrong use count !");
-                st.live_regs.erase(reg);
-            }
+    /* search with the kernel K, the cache and the bounds are ready */
+    template< typename K >
+    void exp_search(exp_shared& sh, size_t nb_threads, const std::vector< unit_idx_t >& heuristic)
+    {
+        exp_release_lists< typename K::unit_t > release;
+        build_release_lists(sh, release);
+        /* bound the whole graph and start from the heuristic schedule */
+        {
+            exp_state< K > root;
+            init_state(root, &sh, &release, 0);
+            sh.root_bound = remainder_bound(root);
+            if(heuristic.size() == sh.nb_units && replay_schedule(root, heuristic))
+                update_best(sh, root.cur_rp, heuristic);
+        }
 
-            /* deupdate regs and unkill regs */
-            for(size_t j = 0; j < st.unit_sinfo[unit].reg_use.size(); j++)
-            {
-                schedule_dep::reg_t reg = st.unit_sinfo[unit].reg_use[j];
-                if((++st.live_regs[reg].nb_use_left) == 1)
-                    st.live_regs[reg].id = reg;
-            }
-            #else
-            st.live_regs = old_live;
-            st.schedulable = old_schedulable;
-            st.unit_dinfo = old_dinfo;
-            #endif
+        std::vector< exp_state< K > > states(nb_threads);
+        for(size_t t = 0; t < nb_threads; t++)
+            init_state(states[t], &sh, &release, t);
+        #ifdef ENABLE_THREADS
+        if(sh.parallel)
+        {
+            sh.queues.resize(nb_threads);
+            for(size_t t = 0; t < nb_threads; t++)
+                pthread_mutex_init(&sh.queues[t].lock, 0);
+            sh.nb_tasks = 0;
+            sh.nb_idle = 0;
+            /* the root task is the empty schedule */
+            push_task(states[0], std::vector< unit_idx_t >());
+        }
+        else
+        #endif
+            start_search(states[0]);
 
-            /* At this point, we have an opportunity to stop
-             * Indeed, if the current register pressure is already higher than the best,
-             * we can stop now and mark the caching as suboptimal. If it happens than we
-             * need a better one later on, then we'll continue the computation
-             *
-             * note: this is just a speedup trick because it will already happen when the recurse
-             *       call is done we will avoid lots of computations
-             *
-             * Of course, don't do it if this is the last schedulable unit ! */
-            if(st.cur_rp >= st.best_rp && (i + 1) < st.schedulable.size())
-            {
-                cc.bw.optimal = false;
+        /* nothing to search if the heuristic is already optimal */
+        sh.status = status_success;
+        while(!exp_stopped(sh))
+        {
+            bool done;
+            #ifdef ENABLE_THREADS
+            if(sh.parallel)
+                done = exp_parallel_search(sh, states);
+            else
+            #endif
+                done = run_search(states[0]);
+            for(size_t t = 0; t < nb_threads; t++)
+                flush_work(states[t]);
+            /* stopped because the best schedule meets the bound */
+            if(done || sh.best_rp <= sh.root_bound)
                 break;
-            }
+            /* the listener can give more budget to resume the search */
+            sh.status = status_exhausted;
+            budget more;
+            if(!sh.listener || !sh.listener->budget_exhausted(*sh.dag, sh.best_rp, sh.root_bound, more))
+                break;
+            if(sh.verbose)
+                debug() << "Budget exhausted ! Resume for " << more.get_work_limit() << " nodes, "
+                    << more.get_time_limit() << " ms\n";
+            sh.status = status_success;
+            sh.meter.extend(more);
+            exp_set_stop(sh, false);
         }
+
+        sh.nb_nodes = 0;
+        for(size_t t = 0; t < nb_threads; t++)
+            sh.nb_nodes += states[t].nb_nodes;
+        #ifdef ENABLE_THREADS
+        if(sh.parallel)
+            for(size_t t = 0; t < nb_threads; t++)
+                pthread_mutex_destroy(&sh.queues[t].lock);
+        #endif
     }
 
-    void exp_schedule(exp_state& st)
+    void exp_schedule(exp_shared& sh, size_t nb_threads, const std::vector< unit_idx_t >& heuristic)
     {
-        init_state(st);
-        try
+        sh.best_rp = SIZE_MAX;
+        sh.stop = false;
+        sh.parallel = false;
+        #ifdef ENABLE_THREADS
+        if(nb_threads == 0)
         {
-            do_schedule(st);
-            /* status */
-            st.status = status_success;
+            long nb_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+            nb_threads = nb_cpus > 1 ? (size_t)nb_cpus : 1;
         }
-        catch(exp_timeout& et)
+        sh.parallel = nb_threads > 1 && sh.nb_units >= EXP_PARALLEL_MIN_UNITS;
+        #endif
+        if(!sh.parallel)
+            nb_threads = 1;
+        sh.cache.init(sh.nb_units, sh.cache_mem_limit, sh.parallel);
+        #ifdef ENABLE_THREADS
+        if(sh.parallel)
+            pthread_mutex_init(&sh.best_lock, 0);
+        #endif
+
+        init_bounds(sh);
+        compute_twins(sh);
+        /* small graphs keep their sets of units in one or two words, the other
+         * ones use the smallest index type that fits */
+        if(sh.nb_units <= 64)
+            exp_search< exp_small_kernel< 1 > >(sh, nb_threads, heuristic);
+        else if(sh.nb_units <= 128)
+            exp_search< exp_small_kernel< 2 > >(sh, nb_threads, heuristic);
+        else if(sh.nb_units <= UINT8_MAX)
+            exp_search< exp_generic_kernel< uint8_t > >(sh, nb_threads, heuristic);
+        else if(sh.nb_units <= UINT16_MAX)
+            exp_search< exp_generic_kernel< uint16_t > >(sh, nb_threads, heuristic);
+        else
+            exp_search< exp_generic_kernel< uint32_t > >(sh, nb_threads, heuristic);
+
+        #ifdef ENABLE_THREADS
+        if(sh.parallel)
+            pthread_mutex_destroy(&sh.best_lock);
+        #endif
+
+        if(sh.verbose)
         {
-            if(st.verbose)
-                debug() << "Timeout !\n";
-            /* status */
-            st.status = status_timeout;
+            if(sh.status == status_exhausted)
+                debug() << "Budget exhausted !\n";
+            debug() << "Bound: " << sh.root_bound << ", best: " << sh.best_rp << "\n";
+            if(sh.status == status_exhausted && sh.best_rp != SIZE_MAX)
+                debug() << "Gap: " << (sh.best_rp - sh.root_bound) << "\n";
+            debug() << "Search: " << nb_threads << " threads, " << sh.nb_nodes << " nodes\n";
+            debug() << "Cache: " << sh.cache.size() << " entries, " << sh.cache.hits() << " hits, "
+                << sh.cache.misses() << " misses, " << sh.cache.evictions() << " evictions\n";
         }
     }
 }
 
 void exp_scheduler::schedule(schedule_dag& dag, schedule_chain& sc) const
 {
-    exp_state st;
-    st.timeout = m_timeout;
-    st.verbose = m_verbose;
+    exp_shared sh;
+    sh.meter.start(m_budget);
+    sh.verbose = m_verbose;
+    sh.cache_mem_limit = m_cache_mem_limit;
+    sh.listener = m_listener;
 
     STM_START(exp_scheduler)
-    compute_static_info(dag, st);
-    exp_schedule(st);
+    compute_static_info(dag, sh);
+    /* start from a fast heuristic: it gives a first bound to prune with,
+     * a schedule to return when the budget is exhausted, and it might even be optimal */
+    std::vector< unit_idx_t > heuristic;
+    {
+        simple_rp_scheduler srp;
+        generic_schedule_chain hsc;
+        srp.schedule(dag, hsc);
+        for(size_t i = 0; i < hsc.get_unit_count(); i++)
+            heuristic.push_back(dag.index_of(hsc.get_unit_at(i)));
+    }
+    exp_schedule(sh, m_nb_threads, heuristic);
+    sh.meter.stop();
+    m_budget_usage.add(sh.meter, sh.status == status_exhausted);
 
-    if(st.status == status_success ||
-            (st.status == status_timeout && st.has_schedule))
+    if(sh.status == status_success ||
+            (sh.status == status_exhausted && sh.best_rp != SIZE_MAX))
     {
         generic_schedule_chain gsc;
-        assert(st.has_schedule && "Success but not valid schedule ?!");
-        assert(st.best_schedule.size() == st.nb_units && "Schedule has the wrong size !");
-        for(size_t i = 0; i < st.best_schedule.size(); i++)
-            gsc.append_unit(dag.get_units()[st.best_schedule[i]]);
-            
+        assert(sh.best_rp != SIZE_MAX && "Success but not valid schedule ?!");
+        assert(sh.best_schedule.size() == sh.nb_units && "Schedule has the wrong size !");
+        for(size_t i = 0; i < sh.best_schedule.size(); i++)
+            gsc.append_unit(dag.get_units()[sh.best_schedule[i]]);
+
         #ifdef ENABLE_SCHED_AUTO_CHECK_RP
-        assert(st.best_rp == gsc.compute_rp_against_dag(dag) && "Mismatch between announced and actual RP in exp_scheduler");
+        assert(sh.best_rp == gsc.compute_rp_against_dag(dag) && "Mismatch between announced and actual RP in exp_scheduler");
         #endif
 
         STM_STOP(exp_scheduler)
 
-        if(st.status == status_timeout && false)
-        {
-            /* Okay, with have a schedule but because of the timeout, it might be of a bad quality,
-             * so try to run the fallback scheduler and compare results */
-            generic_schedule_chain alt_gsc;
-            m_fallback_sched->schedule(dag, alt_gsc);
-
-            size_t exp_rp = gsc.compute_rp_against_dag(dag);
-            size_t alt_rp = alt_gsc.compute_rp_against_dag(dag);
-
-            if(alt_rp < exp_rp)
-            {
-                gsc.clear();
-                gsc.insert_units_at(0, alt_gsc.get_units());
-                std::cout << "Fallback schedule is better: " << alt_rp << " vs " << exp_rp << "\n";
-            }
-            else
-                std::cout << "Exp (timeout) schedule is better: " << exp_rp << " vs " << alt_rp << "\n";
-        }
+        /* when the budget is exhausted, the schedule is still at least as good
+         * as the heuristic one since the search started from it */
+        if(m_listener)
+            m_listener->search_finished(dag, sh.best_rp,
+                sh.status == status_success ? sh.best_rp : sh.root_bound,
+                sh.status == status_exhausted);
 
         assert(gsc.check_against_dag(dag) && "Produced schedule is invalid");
         sc.insert_units_at(sc.get_unit_count(), gsc.get_units());
@@ -605,6 +1960,7 @@ void exp_scheduler::schedule(schedule_dag& dag, schedule_chain& sc) const
     {
         STM_STOP(exp_scheduler)
         /* fallback */
+        assert(m_fallback_sched != 0 && "exp_scheduler found no schedule and has no fallback");
         m_fallback_sched->schedule(dag, sc);
     }
 }
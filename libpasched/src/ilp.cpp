@@ -0,0 +1,734 @@
+#include "ilp.hpp"
+#include "tools.hpp"
+#include <glpk.h>
+#ifdef HAS_SYMPHONY
+#include <coin/symphony.h>
+#endif /* HAS_SYMPHONY */
+#include <cstdio>
+#include <cstdlib>
+#include <unistd.h>
+#include <cstdarg>
+#include <cassert>
+#include <climits>
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <map>
+
+namespace PAMAURY_SCHEDULER_NS
+{
+
+/**
+ * ilp_problem
+ */
+
+ilp_problem::ilp_problem(bool with_names)
+    :m_with_names(with_names), m_nz_rows(1, 0), m_nz_cols(1, 0), m_nz_values(1, 0.0)
+{
+}
+
+ilp_problem::~ilp_problem()
+{
+}
+
+void ilp_problem::reserve(size_t nb_rows, size_t nb_nz)
+{
+    m_rows.reserve(nb_rows);
+    m_nz_rows.reserve(nb_nz + 1);
+    m_nz_cols.reserve(nb_nz + 1);
+    m_nz_values.reserve(nb_nz + 1);
+}
+
+int ilp_problem::add_col(col_kind kind, bound_type type, double lb, double ub)
+{
+    col_t c;
+    c.kind = kind;
+    c.type = kind == binary_col ? double_bnd : type;
+    c.lb = kind == binary_col ? 0 : lb;
+    c.ub = kind == binary_col ? 1 : ub;
+    c.obj = 0.0;
+    m_cols.push_back(c);
+    return m_cols.size();
+}
+
+void ilp_problem::set_obj_coef(int col, double coef)
+{
+    m_cols[col - 1].obj = coef;
+}
+
+int ilp_problem::add_row(bound_type type, double lb, double ub, size_t len, const int *cols, const double *coefs)
+{
+    row_t r;
+    r.type = type;
+    r.lb = lb;
+    r.ub = ub;
+    m_rows.push_back(r);
+    for(size_t i = 0; i < len; i++)
+    {
+        m_nz_rows.push_back(m_rows.size());
+        m_nz_cols.push_back(cols[i]);
+        m_nz_values.push_back(coefs[i]);
+    }
+    return m_rows.size();
+}
+
+namespace
+{
+    void ilp_set_name(std::vector< std::string >& names, int idx, const char *fmt, va_list ap)
+    {
+        char buf[64];
+        vsnprintf(buf, sizeof(buf), fmt, ap);
+        if((int)names.size() < idx)
+            names.resize(idx);
+        names[idx - 1] = buf;
+    }
+}
+
+void ilp_problem::set_col_name(int col, const char *fmt, ...)
+{
+    if(!m_with_names)
+        return;
+    va_list ap;
+    va_start(ap, fmt);
+    ilp_set_name(m_col_names, col, fmt, ap);
+    va_end(ap);
+}
+
+void ilp_problem::set_row_name(int row, const char *fmt, ...)
+{
+    if(!m_with_names || row == 0)
+        return;
+    va_list ap;
+    va_start(ap, fmt);
+    ilp_set_name(m_row_names, row, fmt, ap);
+    va_end(ap);
+}
+
+bool ilp_problem::has_names() const
+{
+    return m_with_names;
+}
+
+size_t ilp_problem::get_col_count() const
+{
+    return m_cols.size();
+}
+
+size_t ilp_problem::get_row_count() const
+{
+    return m_rows.size();
+}
+
+ilp_problem::col_kind ilp_problem::get_col_kind(int col) const
+{
+    return m_cols[col - 1].kind;
+}
+
+ilp_problem::bound_type ilp_problem::get_col_type(int col) const
+{
+    return m_cols[col - 1].type;
+}
+
+double ilp_problem::get_col_lb(int col) const
+{
+    return m_cols[col - 1].lb;
+}
+
+double ilp_problem::get_col_ub(int col) const
+{
+    return m_cols[col - 1].ub;
+}
+
+double ilp_problem::get_obj_coef(int col) const
+{
+    return m_cols[col - 1].obj;
+}
+
+std::string ilp_problem::get_col_name(int col) const
+{
+    return col <= (int)m_col_names.size() ? m_col_names[col - 1] : std::string();
+}
+
+ilp_problem::bound_type ilp_problem::get_row_type(int row) const
+{
+    return m_rows[row - 1].type;
+}
+
+double ilp_problem::get_row_lb(int row) const
+{
+    return m_rows[row - 1].lb;
+}
+
+double ilp_problem::get_row_ub(int row) const
+{
+    return m_rows[row - 1].ub;
+}
+
+std::string ilp_problem::get_row_name(int row) const
+{
+    return row <= (int)m_row_names.size() ? m_row_names[row - 1] : std::string();
+}
+
+const std::vector< int >& ilp_problem::get_nz_rows() const
+{
+    return m_nz_rows;
+}
+
+const std::vector< int >& ilp_problem::get_nz_cols() const
+{
+    return m_nz_cols;
+}
+
+const std::vector< double >& ilp_problem::get_nz_values() const
+{
+    return m_nz_values;
+}
+
+/**
+ * GLPK helpers
+ */
+
+namespace
+{
+    int glpk_bnds(ilp_problem::bound_type type)
+    {
+        switch(type)
+        {
+            case ilp_problem::free_bnd: return GLP_FR;
+            case ilp_problem::lower_bnd: return GLP_LO;
+            case ilp_problem::upper_bnd: return GLP_UP;
+            case ilp_problem::double_bnd: return GLP_DB;
+            case ilp_problem::fixed_bnd: return GLP_FX;
+            default: assert(false && "Unknown bound type !"); return GLP_FR;
+        }
+    }
+
+    int glpk_kind(ilp_problem::col_kind kind)
+    {
+        switch(kind)
+        {
+            case ilp_problem::continuous_col: return GLP_CV;
+            case ilp_problem::integer_col: return GLP_IV;
+            case ilp_problem::binary_col: return GLP_BV;
+            default: assert(false && "Unknown column kind !"); return GLP_CV;
+        }
+    }
+
+    /* the rows of pb are appended, the columns must already be there */
+    void glpk_add_rows(glp_prob *p, const ilp_problem& pb)
+    {
+        int first_row = glp_get_num_rows(p);
+        int nb_rows = pb.get_row_count();
+        if(nb_rows == 0)
+            return;
+        glp_add_rows(p, nb_rows);
+        for(int i = 1; i <= nb_rows; i++)
+        {
+            glp_set_row_bnds(p, first_row + i, glpk_bnds(pb.get_row_type(i)), pb.get_row_lb(i), pb.get_row_ub(i));
+            if(pb.has_names())
+                glp_set_row_name(p, first_row + i, pb.get_row_name(i).c_str());
+        }
+        if(first_row == 0)
+        {
+            glp_load_matrix(p, pb.get_nz_rows().size() - 1, &pb.get_nz_rows()[0],
+                &pb.get_nz_cols()[0], &pb.get_nz_values()[0]);
+            return;
+        }
+        /* glp_load_matrix would replace the existing rows, the triplets are sorted by row */
+        const std::vector< int >& ia = pb.get_nz_rows();
+        std::vector< int > ind(1, 0);
+        std::vector< double > val(1, 0.0);
+        for(size_t k = 1; k < ia.size(); k++)
+        {
+            ind.push_back(pb.get_nz_cols()[k]);
+            val.push_back(pb.get_nz_values()[k]);
+            if(k + 1 == ia.size() || ia[k + 1] != ia[k])
+            {
+                glp_set_mat_row(p, first_row + ia[k], ind.size() - 1, &ind[0], &val[0]);
+                ind.resize(1);
+                val.resize(1);
+            }
+        }
+    }
+
+    glp_prob *glpk_create_prob(const ilp_problem& pb)
+    {
+        glp_prob *p = glp_create_prob();
+        glp_set_obj_dir(p, GLP_MIN);
+        glp_set_obj_name(p, "obj");
+        int nb_cols = pb.get_col_count();
+        if(nb_cols != 0)
+            glp_add_cols(p, nb_cols);
+        for(int j = 1; j <= nb_cols; j++)
+        {
+            glp_set_col_bnds(p, j, glpk_bnds(pb.get_col_type(j)), pb.get_col_lb(j), pb.get_col_ub(j));
+            glp_set_col_kind(p, j, glpk_kind(pb.get_col_kind(j)));
+            if(pb.get_obj_coef(j) != 0.0)
+                glp_set_obj_coef(p, j, pb.get_obj_coef(j));
+            if(pb.has_names())
+                glp_set_col_name(p, j, pb.get_col_name(j).c_str());
+        }
+        glpk_add_rows(p, pb);
+        return p;
+    }
+
+    /* glp_term_out is global to GLPK, set it for a scope and restore it after */
+    class glpk_term_out_scope
+    {
+        public:
+        glpk_term_out_scope(bool verbose) :m_old(glp_term_out(verbose ? GLP_ON : GLP_OFF)) {}
+        ~glpk_term_out_scope() { glp_term_out(m_old); }
+
+        protected:
+        int m_old;
+    };
+
+    /* the time left in the budget, in ms, or INT_MAX */
+    int glpk_tm_lim(const budget_meter& meter)
+    {
+        uint64_t lim = meter.get_budget().get_time_limit();
+        if(lim == 0)
+            return INT_MAX;
+        uint64_t used = meter.get_elapsed_time();
+        return (int)std::min(lim > used ? lim - used : 1, (uint64_t)INT_MAX);
+    }
+
+    struct glpk_callback_info
+    {
+        budget_meter *meter;
+        const ilp_separator *sep;
+        /* given as the first incumbent, 0 once it is */
+        const std::vector< double > *incumbent;
+        bool with_names;
+    };
+
+    void glpk_callback(glp_tree *tree, void *info)
+    {
+        glpk_callback_info& ci = *(glpk_callback_info *)info;
+        switch(glp_ios_reason(tree))
+        {
+            /* the work of the budget is the number of branch and bound nodes */
+            case GLP_ISELECT:
+                ci.meter->add_work(1);
+                break;
+            case GLP_IROWGEN:
+                if(ci.sep != 0)
+                {
+                    glp_prob *p = glp_ios_get_prob(tree);
+                    std::vector< double > x(glp_get_num_cols(p) + 1, 0.0);
+                    for(size_t j = 1; j < x.size(); j++)
+                        x[j] = glp_get_col_prim(p, j);
+                    ilp_problem rows(ci.with_names);
+                    if(ci.sep->separate(x, rows) != 0)
+                        glpk_add_rows(p, rows);
+                }
+                break;
+            case GLP_IHEUR:
+                if(ci.incumbent != 0)
+                    glp_ios_heur_sol(tree, &(*ci.incumbent)[0]);
+                ci.incumbent = 0;
+                break;
+            default:
+                break;
+        }
+        if(ci.meter->is_exhausted())
+            glp_ios_terminate(tree);
+    }
+}
+
+/**
+ * glpk_ilp_backend
+ */
+
+glpk_ilp_backend::glpk_ilp_backend()
+{
+}
+
+glpk_ilp_backend::~glpk_ilp_backend()
+{
+}
+
+bool glpk_ilp_backend::has_lazy_rows() const
+{
+    return true;
+}
+
+ilp_backend::status glpk_ilp_backend::solve(const ilp_problem& pb, const std::vector< double >& incumbent,
+    const ilp_separator *sep, budget_meter& meter, bool verbose, std::vector< double >& x) const
+{
+    glpk_term_out_scope term_out(verbose);
+    glp_prob *p = glpk_create_prob(pb);
+
+    // the callback works on the columns of the problem, so no presolver and
+    // the relaxation must be solved first
+    glp_smcp smcp;
+    glp_init_smcp(&smcp);
+    smcp.msg_lev = verbose ? GLP_MSG_ALL : GLP_MSG_OFF;
+    smcp.tm_lim = glpk_tm_lim(meter);
+    int sts = glp_simplex(p, &smcp);
+    if(sts != 0 || glp_get_status(p) != GLP_OPT)
+    {
+        glp_delete_prob(p);
+        return sts == GLP_ETMLIM ? exhausted : failed;
+    }
+
+    glpk_callback_info ci;
+    ci.meter = &meter;
+    ci.sep = sep;
+    ci.incumbent = incumbent.empty() ? 0 : &incumbent;
+    ci.with_names = pb.has_names();
+
+    glp_iocp cp;
+    glp_init_iocp(&cp);
+    cp.presolve = GLP_OFF;
+    cp.gmi_cuts = GLP_ON;
+    cp.mir_cuts = GLP_ON;
+    cp.cov_cuts = GLP_ON;
+    cp.clq_cuts = GLP_ON;
+    cp.msg_lev = verbose ? GLP_MSG_ALL : GLP_MSG_OFF;
+    cp.cb_func = &glpk_callback;
+    cp.cb_info = &ci;
+    /* the primal heuristics accept any integer point which satisfies the rows
+     * already in the problem, so with lazy rows they could find an incumbent
+     * which breaks the others and prune the actual optimum: every incumbent
+     * must then come from a relaxation seen by the separator, or be the one
+     * given by the caller */
+    if(sep != 0)
+    {
+        #if GLP_MAJOR_VERSION > 4 || (GLP_MAJOR_VERSION == 4 && GLP_MINOR_VERSION >= 57)
+        cp.sr_heur = GLP_OFF;
+        #endif
+        cp.fp_heur = GLP_OFF;
+        #if GLP_MAJOR_VERSION > 4 || (GLP_MAJOR_VERSION == 4 && GLP_MINOR_VERSION >= 50)
+        cp.ps_heur = GLP_OFF;
+        #endif
+    }
+    /* the callback is not called while solving a relaxation */
+    cp.tm_lim = glpk_tm_lim(meter);
+
+    sts = glp_intopt(p, &cp);
+    status ret = failed;
+    bool has_sol = false;
+    if(sts == GLP_ESTOP || sts == GLP_ETMLIM)
+    {
+        ret = exhausted;
+        /* the best integer solution found so far, if any */
+        has_sol = glp_mip_status(p) == GLP_FEAS;
+    }
+    else if(sts == 0 && glp_mip_status(p) == GLP_OPT)
+    {
+        ret = optimal;
+        has_sol = true;
+    }
+    if(has_sol)
+    {
+        x.resize(pb.get_col_count() + 1);
+        for(size_t j = 1; j < x.size(); j++)
+            x[j] = glp_mip_col_val(p, j);
+    }
+    glp_delete_prob(p);
+    return ret;
+}
+
+#ifdef HAS_SYMPHONY
+/**
+ * symphony_ilp_backend
+ */
+
+symphony_ilp_backend::symphony_ilp_backend()
+{
+}
+
+symphony_ilp_backend::~symphony_ilp_backend()
+{
+}
+
+ilp_backend::status symphony_ilp_backend::solve(const ilp_problem& pb, const std::vector< double >& incumbent,
+    const ilp_separator *sep, budget_meter& meter, bool verbose, std::vector< double >& x) const
+{
+    (void) incumbent;
+    (void) sep;
+    glpk_term_out_scope term_out(verbose);
+    const char *tmp_dir = getenv("TMPDIR");
+    std::string mps_tmpl = std::string(tmp_dir != NULL ? tmp_dir : P_tmpdir) + "/pasched-XXXXXX";
+    std::vector< char > name(mps_tmpl.begin(), mps_tmpl.end());
+    name.push_back(0);
+    /* the file is created empty so that nobody else can take the name */
+    int fd = mkstemp(&name[0]);
+    if(fd < 0)
+        return failed;
+    close(fd);
+    std::string mps_name(&name[0]);
+    glp_prob *p = glpk_create_prob(pb);
+    int sts = glp_write_mps(p, GLP_MPS_FILE, 0, mps_name.c_str());
+    glp_delete_prob(p);
+    if(sts != 0)
+    {
+        remove(mps_name.c_str());
+        return failed;
+    }
+
+    sym_environment *env = sym_open_environment();
+    if(env == NULL)
+    {
+        remove(mps_name.c_str());
+        return failed;
+    }
+    status ret = failed;
+    if(sym_set_defaults(env) == FUNCTION_TERMINATED_NORMALLY &&
+            sym_read_mps(env, &name[0]) == FUNCTION_TERMINATED_NORMALLY)
+    {
+        sym_set_int_param(env, "verbosity", verbose ? 0 : -2);
+        if(meter.get_budget().get_time_limit() != 0)
+            sym_set_dbl_param(env, "time_limit", glpk_tm_lim(meter) / 1000.0);
+        switch(sym_solve(env))
+        {
+            case TM_OPTIMAL_SOLUTION_FOUND:
+                x.resize(pb.get_col_count() + 1);
+                if(sym_get_col_solution(env, &x[1]) == FUNCTION_TERMINATED_NORMALLY)
+                    ret = optimal;
+                break;
+            case TM_TIME_LIMIT_EXCEEDED:
+                ret = exhausted;
+                break;
+            default:
+                break;
+        }
+    }
+    sym_close_environment(env);
+    remove(mps_name.c_str());
+    return ret;
+}
+#endif
+
+/**
+ * file_ilp_backend
+ */
+
+file_ilp_backend::file_ilp_backend(const std::string& prefix, file_format format,
+        const std::string& command)
+    :m_prefix(prefix), m_format(format), m_command(command), m_nb_problems(0)
+{
+}
+
+file_ilp_backend::~file_ilp_backend()
+{
+}
+
+bool file_ilp_backend::uses_names() const
+{
+    return true;
+}
+
+ilp_backend::status file_ilp_backend::solve(const ilp_problem& pb, const std::vector< double >& incumbent,
+    const ilp_separator *sep, budget_meter& meter, bool verbose, std::vector< double >& x) const
+{
+    (void) incumbent;
+    (void) sep;
+    (void) meter;
+    std::ostringstream oss;
+    oss << m_prefix << "-" << m_nb_problems++;
+    std::string pb_name = oss.str() + (m_format == mps_format ? ".mps" : ".lp");
+    std::string sol_name = oss.str() + ".sol";
+
+    int sts;
+    {
+        glpk_term_out_scope term_out(verbose);
+        glp_prob *p = glpk_create_prob(pb);
+        if(m_format == mps_format)
+            sts = glp_write_mps(p, GLP_MPS_FILE, 0, pb_name.c_str());
+        else
+            sts = glp_write_lp(p, 0, pb_name.c_str());
+        glp_delete_prob(p);
+    }
+    if(sts != 0)
+        return failed;
+
+    if(!m_command.empty())
+    {
+        std::string cmd;
+        for(size_t i = 0; i < m_command.size(); i++)
+        {
+            if(m_command[i] == '%' && i + 1 < m_command.size() && m_command[i + 1] == 'm')
+                cmd += pb_name;
+            else if(m_command[i] == '%' && i + 1 < m_command.size() && m_command[i + 1] == 's')
+                cmd += sol_name;
+            else
+            {
+                cmd += m_command[i];
+                continue;
+            }
+            i++;
+        }
+        if(verbose)
+            debug() << "file_ilp_backend: " << cmd << "\n";
+        if(system(cmd.c_str()) != 0)
+            return failed;
+    }
+
+    std::ifstream fin(sol_name.c_str());
+    cplex_solution sol;
+    if(!fin || !read_cplex_solution(fin, sol) || sol.status == cplex_solution::infeasible_status)
+        return failed;
+    /* the variables of an LP file are numbered in order of appearance */
+    std::map< std::string, int > cols;
+    for(size_t j = 1; j <= pb.get_col_count(); j++)
+        cols[pb.get_col_name(j)] = j;
+    std::vector< double > sol_x(pb.get_col_count() + 1, 0.0);
+    std::vector< bool > assigned(pb.get_col_count() + 1, false);
+    size_t nb_assigned = 0;
+    for(size_t i = 0; i < sol.col_names.size(); i++)
+    {
+        std::map< std::string, int >::iterator it = cols.find(sol.col_names[i]);
+        if(it == cols.end())
+            return failed;
+        sol_x[it->second] = sol.col_values[i];
+        if(!assigned[it->second])
+            nb_assigned++;
+        assigned[it->second] = true;
+    }
+    if(nb_assigned < pb.get_col_count())
+        return failed;
+    x.swap(sol_x);
+    /* a solution without status is not trusted to be optimal */
+    return sol.status == cplex_solution::optimal_status ? optimal : exhausted;
+}
+
+/**
+ * CPLEX solutions
+ */
+
+namespace
+{
+    /* parse attr="value" at the beginning of line and remove it */
+    bool read_xml_attr(std::string& line, const std::string& attr, std::string& value)
+    {
+        std::string s = attr + "=\"";
+        if(line.size() <= s.size() || line.substr(0, s.size()) != s)
+            return false;
+        line = line.substr(s.size());
+        size_t pos = line.find('\"');
+        if(pos == std::string::npos)
+            return false;
+        value = line.substr(0, pos);
+        line = trim(line.substr(pos + 1));
+        return true;
+    }
+
+    /* parse <tag name="..." index="..." attr="..." */
+    bool read_xml_entry(std::string line, const std::string& tag, const std::string& attr,
+        std::string& name, double& val)
+    {
+        std::string s = "<" + tag + " ";
+        if(line.size() <= s.size() || line.substr(0, s.size()) != s)
+            return false;
+        line = trim(line.substr(s.size()));
+
+        std::string idx_str, val_str;
+        int idx;
+        if(!read_xml_attr(line, "name", name) || !read_xml_attr(line, "index", idx_str) ||
+                !read_xml_attr(line, attr, val_str))
+            return false;
+        std::istringstream iss(idx_str);
+        if(!(iss >> idx) || !iss.eof())
+            return false;
+        std::istringstream iss2(val_str);
+        return (bool)(iss2 >> val);
+    }
+
+    /* parse attr="value" at the beginning of line */
+    bool read_xml_header_attr(const std::string& line, const std::string& attr, std::string& value)
+    {
+        std::string s = attr + "=\"";
+        if(line.size() <= s.size() || line.substr(0, s.size()) != s)
+            return false;
+        size_t pos = line.find('\"', s.size());
+        if(pos == std::string::npos)
+            return false;
+        value = line.substr(s.size(), pos - s.size());
+        return true;
+    }
+
+    /* status codes of CPLEX */
+    cplex_solution::status_t cplex_status(int value)
+    {
+        switch(value)
+        {
+            /* optimal, MIP optimal, MIP optimal within the tolerance */
+            case 1: case 101: case 102:
+                return cplex_solution::optimal_status;
+            /* infeasible or unbounded, and the MIP limits reached without any
+             * integer solution */
+            case 2: case 3: case 4: case 103: case 106: case 108: case 110:
+            case 112: case 114: case 117: case 118: case 119:
+                return cplex_solution::infeasible_status;
+            default:
+                return cplex_solution::feasible_status;
+        }
+    }
+
+    cplex_solution::status_t cplex_status(const std::string& str)
+    {
+        if(str.find("infeasible") != std::string::npos || str.find("unbounded") != std::string::npos)
+            return cplex_solution::infeasible_status;
+        if(str.find("optimal") != std::string::npos)
+            return cplex_solution::optimal_status;
+        return cplex_solution::feasible_status;
+    }
+}
+
+bool read_cplex_solution(std::istream& in, cplex_solution& sol)
+{
+    bool has_obj = false;
+    bool has_status_value = false;
+    std::string line;
+    sol.status = cplex_solution::unknown_status;
+    while(std::getline(in, line))
+    {
+        std::string name;
+        std::string str;
+        double val;
+
+        line = trim(line);
+        if(read_xml_header_attr(line, "solutionStatusValue", str))
+        {
+            int value;
+            std::istringstream iss(str);
+            if((iss >> value) && iss.eof())
+            {
+                sol.status = cplex_status(value);
+                has_status_value = true;
+            }
+            continue;
+        }
+        if(read_xml_header_attr(line, "solutionStatusString", str))
+        {
+            if(!has_status_value)
+                sol.status = cplex_status(str);
+            continue;
+        }
+        if(read_xml_entry(line, "constraint", "slack", name, val))
+        {
+            sol.row_names.push_back(name);
+            sol.row_slacks.push_back(val);
+            continue;
+        }
+        if(read_xml_entry(line, "variable", "value", name, val))
+        {
+            sol.col_names.push_back(name);
+            sol.col_values.push_back(val);
+            continue;
+        }
+
+        if(read_xml_header_attr(line, "objectiveValue", str))
+        {
+            std::istringstream iss(str);
+            if(!(iss >> sol.obj) || !iss.eof())
+                continue;
+            has_obj = true;
+        }
+    }
+    return has_obj;
+}
+
+}
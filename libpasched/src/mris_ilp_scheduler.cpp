@@ -1,9 +1,5 @@
 #include "scheduler.hpp"
 #include "tools.hpp"
-#include <glpk.h>
-#ifdef HAS_SYMPHONY
-#include <coin/symphony.h>
-#endif /* HAS_SYMPHONY */
 #include <cstdlib>
 #include <cstdio>
 #include <stdexcept>
@@ -13,31 +9,32 @@
 #include <cassert>
 #include <fstream>
 #include <sstream>
-
-#ifdef HAS_SYMPHONY
-/* #define SOLVE_WITH_SYMPHONY */
-#define SOLVE_WITH_GLPK
-#else
-#define SOLVE_WITH_GLPK
-#endif
+#include <climits>
+#include <algorithm>
 
 //#define DEBUG_ILP_CREATION
 
 //#define USE_FU
 #define USE_WUV_TRANSITIVITY
-//#define POST_GEN_OPT
+/* on large graphs, only add the transitivity constraints violated by the
+ * relaxations met during the branch and cut, if the backend can */
+#define LAZY_WUV_TRANSITIVITY
 
 #if !defined(USE_FU) && !defined(USE_WUV_TRANSITIVITY)
 #error You must choose to use f(u) variable or w(u,v) transitivity
 #endif
 
+#if defined(LAZY_WUV_TRANSITIVITY) && !defined(USE_WUV_TRANSITIVITY)
+#error Lazy w(u,v) transitivity needs w(u,v) transitivity
+#endif
+
 namespace PAMAURY_SCHEDULER_NS
 {
 
 STM_DECLARE(mris_ilp_scheduler)
 
-mris_ilp_scheduler::mris_ilp_scheduler(const scheduler *fallback, size_t fallback_timeout, bool verbose)
-    :m_fallback_sched(fallback), m_timeout(fallback_timeout), m_verbose(verbose)
+mris_ilp_scheduler::mris_ilp_scheduler(const scheduler *fallback, const budget& b, bool verbose)
+    :m_fallback_sched(fallback), m_budget(b), m_verbose(verbose), m_backend(0)
 {
 }
 
@@ -45,6 +42,11 @@ mris_ilp_scheduler::~mris_ilp_scheduler()
 {
 }
 
+void mris_ilp_scheduler::set_backend(const ilp_backend *backend)
+{
+    m_backend = backend;
+}
+
 struct reg_info_t
 {
     reg_info_t(unsigned id) : id(id) {}
@@ -62,39 +64,303 @@ struct instr_regs_info_t
     std::vector< reg_info_t > reg_info;
 };
 
+namespace
+{
+    /* binary of the model: a constant, a column, or one minus a column */
+    struct ilp_lit
+    {
+        ilp_lit() :col(0), neg(false), value(0) {}
+
+        static ilp_lit constant(unsigned value)
+        {
+            ilp_lit l;
+            l.value = value;
+            return l;
+        }
+
+        static ilp_lit column(int col, bool neg)
+        {
+            ilp_lit l;
+            l.col = col;
+            l.neg = neg;
+            return l;
+        }
+
+        bool is_constant() const { return col == 0; }
+
+        int col;
+        bool neg;
+        unsigned value;
+    };
+
+    ilp_lit ilp_not(const ilp_lit& l)
+    {
+        if(l.is_constant())
+            return ilp_lit::constant(1 - l.value);
+        return ilp_lit::column(l.col, !l.neg);
+    }
+
+    unsigned ilp_sol_val(const std::vector< double >& x, const ilp_lit& l)
+    {
+        if(l.is_constant())
+            return l.value;
+        unsigned val = x[l.col] > 0.5 ? 1 : 0;
+        return l.neg ? 1 - val : val;
+    }
+
+    /* linear expression, the constant is moved to the bounds of the row */
+    struct ilp_expr
+    {
+        ilp_expr() :ind(1, 0), val(1, 0.0), cst(0.0), binary(true) {}
+
+        void add_col(int col, double coef, bool is_binary)
+        {
+            binary = binary && is_binary;
+            for(size_t i = 1; i < ind.size(); i++)
+                if(ind[i] == col)
+                {
+                    val[i] += coef;
+                    return;
+                }
+            ind.push_back(col);
+            val.push_back(coef);
+        }
+
+        void add(const ilp_lit& l, double coef)
+        {
+            if(l.is_constant())
+                cst += coef * l.value;
+            else if(l.neg)
+            {
+                cst += coef;
+                add_col(l.col, -coef, true);
+            }
+            else
+                add_col(l.col, coef, true);
+        }
+
+        /* 1-based, like GLPK */
+        std::vector< int > ind;
+        std::vector< double > val;
+        double cst;
+        /* if all the columns are binaries, the rows it can't violate are dropped */
+        bool binary;
+    };
+
+    /* turn lb <= e <= ub, or only one side depending on type, into the bounds of
+     * a row, return false if it is always satisfied */
+    bool ilp_row_bnds(ilp_problem::bound_type& type, double& lb, double& ub, const ilp_expr& e)
+    {
+        bool need_lb = type == ilp_problem::lower_bnd || type == ilp_problem::double_bnd ||
+            type == ilp_problem::fixed_bnd;
+        bool need_ub = type == ilp_problem::upper_bnd || type == ilp_problem::double_bnd ||
+            type == ilp_problem::fixed_bnd;
+        if(e.binary)
+        {
+            double min = e.cst;
+            double max = e.cst;
+            for(size_t i = 1; i < e.ind.size(); i++)
+            {
+                if(e.val[i] < 0)
+                    min += e.val[i];
+                else
+                    max += e.val[i];
+            }
+            need_lb = need_lb && min < lb;
+            need_ub = need_ub && max > ub;
+            assert((e.ind.size() > 1 || (!need_lb && !need_ub)) && "Inconsistent ILP model !");
+        }
+        if(!need_lb && !need_ub)
+            return false;
+
+        if(need_lb && need_ub)
+            type = type == ilp_problem::fixed_bnd ? ilp_problem::fixed_bnd : ilp_problem::double_bnd;
+        else
+            type = need_lb ? ilp_problem::lower_bnd : ilp_problem::upper_bnd;
+        lb = need_lb ? lb - e.cst : 0;
+        ub = need_ub ? ub - e.cst : 0;
+        return true;
+    }
+
+    /* add lb <= e <= ub, or only one side depending on type, return the row or 0
+     * if it is always satisfied */
+    int ilp_add_row(ilp_problem& pb, ilp_problem::bound_type type, double lb, double ub, const ilp_expr& e)
+    {
+        if(!ilp_row_bnds(type, lb, ub, e))
+            return 0;
+        return pb.add_row(type, lb, ub, e.ind.size() - 1, &e.ind[1], &e.val[1]);
+    }
+
+    /* set the column of a binary in a solution vector */
+    void ilp_set_val(std::vector< double >& x, const ilp_lit& l, unsigned value)
+    {
+        assert((!l.is_constant() || l.value == value) && "Solution contradicts a fixed binary !");
+        if(!l.is_constant())
+            x[l.col] = l.neg ? 1 - value : value;
+    }
+
+    /* maximum over the units of the bound given by compute_reg_spans(), the
+     * killers of a register being its users */
+    size_t ilp_rp_lower_bound(const std::vector< const schedule_unit * >& units,
+        const std::vector< instr_regs_info_t >& reg_created, const bit_matrix& path)
+    {
+        std::vector< reg_lifetime > regs;
+        for(unsigned v = 0; v < units.size(); v++)
+            for(size_t i = 0; i < reg_created[v].reg_info.size(); i++)
+            {
+                const std::vector< unsigned >& killers = reg_created[v].reg_info[i].killers;
+                regs.push_back(reg_lifetime());
+                regs.back().creator = v;
+                regs.back().users.assign(killers.begin(), killers.end());
+            }
+        std::vector< size_t > span;
+        compute_reg_spans(units.size(), regs, path, span);
+        size_t lb = 0;
+        for(unsigned u = 0; u < units.size(); u++)
+            lb = std::max(lb, span[u] + std::max((size_t)units[u]->internal_register_pressure(),
+                reg_created[u].reg_info.size()));
+        return lb;
+    }
+
+    /* rebuild the order of the units from the w(u,v) of a solution, return false
+     * if they are not a total order */
+    bool ilp_sol_placement(const std::vector< double >& x, const std::vector< std::vector< ilp_lit > >& w_u_v,
+        std::vector< unsigned >& placement)
+    {
+        unsigned n = w_u_v.size();
+        std::set< unsigned > to_be_placed;
+        for(unsigned u = 0; u < n; u++)
+            to_be_placed.insert(u);
+
+        placement.clear();
+        for(unsigned u = 0; u < n; u++)
+        {
+            /* pick an instruction not already placement */
+            unsigned cur_inst = *to_be_placed.begin();
+            //std::cout << "Cur instruction: " << units[cur_inst]->to_string() << "\n";
+            /* for each instruction X to be placed */
+            std::set< unsigned >::iterator it = to_be_placed.begin();
+            for(; it != to_be_placed.end(); ++it)
+            {
+                /* if w(X,cur_inst)=1, then select X */
+                unsigned val = ilp_sol_val(x, w_u_v[*it][cur_inst]);
+                if(val)
+                {
+                    cur_inst = *it;
+                    //std::cout << "  Switch to: " << units[cur_inst]->to_string() << "\n";
+                }
+            }
+            /* check cur_inst is okay (sanity check) */
+            for(size_t i = 0; i < placement.size(); i++)
+            {
+                unsigned val = ilp_sol_val(x, w_u_v[placement[i]][cur_inst]);
+                if(val != 1)
+                    return false;
+            }
+            /* check already scheduled instruction should have been scheduled before ! */
+            it = to_be_placed.begin();
+            for(; it != to_be_placed.end(); ++it)
+            {
+                unsigned val = ilp_sol_val(x, w_u_v[cur_inst][*it]);
+                if(cur_inst != *it && val != 1)
+                    return false;
+            }
+            /* add instruction */
+            //std::cout << "  Emit: " << units[cur_inst]->to_string() << "\n";
+            placement.push_back(cur_inst);
+            to_be_placed.erase(cur_inst);
+        }
+        return true;
+    }
+
+    #ifdef LAZY_WUV_TRANSITIVITY
+    /* graphs with fewer units get all the transitivity constraints upfront */
+    const unsigned ILP_LAZY_MIN_UNITS = 64;
+    /* maximum number of transitivity constraints added for one relaxation */
+    const size_t ILP_LAZY_MAX_ROWS = 500;
+    const double ILP_LAZY_EPS = 1e-6;
+
+    double ilp_relax_val(const std::vector< double >& x, const ilp_lit& l)
+    {
+        if(l.is_constant())
+            return l.value;
+        return l.neg ? 1.0 - x[l.col] : x[l.col];
+    }
+
+    /* the constraints (2) violated by a relaxation, an integer solution with a
+     * cycle always violates one of them */
+    class wuv_transitivity_separator : public ilp_separator
+    {
+        public:
+        wuv_transitivity_separator(const std::vector< std::vector< ilp_lit > >& w_u_v)
+            :m_w_u_v(w_u_v) {}
+
+        virtual size_t separate(const std::vector< double >& sol, ilp_problem& rows) const
+        {
+            const std::vector< std::vector< ilp_lit > >& w_u_v = m_w_u_v;
+            unsigned n = w_u_v.size();
+            size_t nb_rows = 0;
+
+            for(unsigned u = 0; u < n; u++)
+                for(unsigned x = u + 1; x < n; x++)
+                    for(unsigned v = x + 1; v < n; v++)
+                    {
+                        double val = ilp_relax_val(sol, w_u_v[u][x]) + ilp_relax_val(sol, w_u_v[x][v]) -
+                            ilp_relax_val(sol, w_u_v[u][v]);
+                        if(val >= -ILP_LAZY_EPS && val <= 1.0 + ILP_LAZY_EPS)
+                            continue;
+                        ilp_expr e;
+                        e.add(w_u_v[u][x], 1.0);
+                        e.add(w_u_v[x][v], 1.0);
+                        e.add(w_u_v[u][v], -1.0);
+                        int row = ilp_add_row(rows, ilp_problem::double_bnd, 0, 1, e);
+                        if(row == 0)
+                            continue;
+                        rows.set_row_name(row, "(2)(%u,%u,%u)", u, x, v);
+                        if(++nb_rows == ILP_LAZY_MAX_ROWS)
+                            return nb_rows;
+                    }
+            return nb_rows;
+        }
+
+        protected:
+        const std::vector< std::vector< ilp_lit > >& m_w_u_v;
+    };
+    #endif
+}
+
 void mris_ilp_scheduler::schedule(schedule_dag& dag, schedule_chain& sc) const
 {
-    #define ILP_ERROR(msg) { std::cout << "ILP_ERROR: " << msg << "\n"; glp_delete_prob(p); goto Lerror; }
+    #define ILP_ERROR(msg) { std::cout << "ILP_ERROR: " << msg << "\n"; goto Lerror; }
 
+    glpk_ilp_backend glpk_backend;
+    const ilp_backend& backend = m_backend != 0 ? *m_backend : glpk_backend;
+    budget_meter meter;
+    bool exhausted = false;
+    meter.start(m_budget);
     STM_START(mris_ilp_scheduler)
     {
-        char name[32];
         // column of z
         int z_col;
         #ifdef USE_FU
         // columns of the f(u)
         std::vector< int> f_u_col;
         #endif
-        // columns of the w(u,v)
-        std::vector< std::vector< int > > w_u_v_col;
-        // columns of the vnd(u(ri),v)
-        std::vector< std::vector< std::vector< int > > > vnd_u_i_v_col;
-        // columns of the va(u(ri),v)
-        std::vector< std::vector< std::vector< int > > > va_u_i_v_col;
+        // w(u,v)
+        std::vector< std::vector< ilp_lit > > w_u_v;
+        // vnd(u(ri),v)
+        std::vector< std::vector< std::vector< ilp_lit > > > vnd_u_i_v;
+        // va(u(ri),v)
+        std::vector< std::vector< std::vector< ilp_lit > > > va_u_i_v;
         // columns of the rp(u)
         std::vector< int> rp_u_col;
         // shortcut
         const std::vector< const schedule_unit * > units = dag.get_units();
-        // unit map
-        std::map< const schedule_unit *, unsigned > unit_map;
         // for each instruction, store a list of created registers and killers
         std::vector< instr_regs_info_t > reg_created;
 
         
         size_t n = dag.get_units().size();
-        /* build unit map */
-        for(unsigned u = 0; u < n; u++)
-            unit_map[dag.get_units()[u]] = u;
         
         /* compute register informations */
         reg_created.resize(n);
@@ -119,7 +385,7 @@ void mris_ilp_scheduler::schedule(schedule_dag& dag, schedule_chain& sc) const
                     rc.reg_info.push_back(reg_info_t(dep.reg()));
                 }
                 // add S to the list of killers of U(R)
-                rc.reg_info[rc.reg_map[dep.reg()]].killers.push_back(unit_map[dep.to()]);
+                rc.reg_info[rc.reg_map[dep.reg()]].killers.push_back(dag.index_of(dep.to()));
             }
 
             #ifdef DEBUG_ILP_CREATION
@@ -135,146 +401,97 @@ void mris_ilp_scheduler::schedule(schedule_dag& dag, schedule_chain& sc) const
             #endif
         }
 
-        // create variables tables
-        w_u_v_col.resize(n);
-        vnd_u_i_v_col.resize(n);
-        va_u_i_v_col.resize(n);
-        rp_u_col.resize(n);
-        #ifdef USE_FU
-        f_u_col.resize(n);
-        #endif
-        for(unsigned u = 0; u < n; u++)
+        // every pair of comparable units has a fixed order
+        bit_matrix path;
+        dag.build_path_map(path);
+        // a heuristic schedule bounds the register pressure, it is optimal if
+        // it meets the lower bound
+        generic_schedule_chain heur_sc;
         {
-            w_u_v_col[u].resize(n);
-            vnd_u_i_v_col[u].resize(reg_created[u].reg_info.size());
-            va_u_i_v_col[u].resize(reg_created[u].reg_info.size());
-            
-            for(unsigned i = 0; i < reg_created[u].reg_info.size(); i++)
-            {
-                vnd_u_i_v_col[u][i].resize(n);
-                va_u_i_v_col[u][i].resize(n);
-            }
+            simple_rp_scheduler srp;
+            srp.schedule(dag, heur_sc);
         }
-        
-        // create the problem
-        glp_prob *p = glp_create_prob();
-        glp_set_prob_name(p, "mris_alt");
-        // set objective name
-        glp_set_obj_name(p, "min_reg_pres");
-        // set objective direction
-        glp_set_obj_dir(p, GLP_MIN);
+        size_t heur_rp = heur_sc.compute_rp_against_dag(dag);
+        size_t lower_rp = ilp_rp_lower_bound(units, reg_created, path);
+        if(lower_rp >= heur_rp)
+        {
+            if(m_verbose)
+                debug() << "mris_ilp: heuristic schedule meets the lower bound " << lower_rp << "\n";
+            for(size_t i = 0; i < heur_sc.get_unit_count(); i++)
+                sc.append_unit(heur_sc.get_unit_at(i));
+            STM_STOP(mris_ilp_scheduler)
+            meter.stop();
+            m_budget_usage.add(meter, false);
+            return;
+        }
+        // the transitivity constraints are either all in the model or added by the callback
+        bool lazy_transitivity = false;
+        #ifdef LAZY_WUV_TRANSITIVITY
+        lazy_transitivity = backend.has_lazy_rows() && n >= ILP_LAZY_MIN_UNITS;
+        #endif
+
+        // create the model, the transitivity constraints are most of it
+        #ifdef DEBUG_ILP_CREATION
+        ilp_problem m(true);
+        #else
+        ilp_problem m(backend.uses_names());
+        #endif
+        size_t nb_triples = lazy_transitivity ? 0 : n * (n - 1) * (n - 2) / 6;
+        m.reserve(nb_triples, 3 * nb_triples);
         // create the only objective variable
-        z_col = glp_add_cols(p, 1);
-        glp_set_col_name(p, z_col, "z");
-        glp_set_col_bnds(p, z_col, GLP_FR, 0, 0); // free variable
-        glp_set_col_kind(p, z_col, GLP_IV); // integer variable
-        glp_set_obj_coef(p, z_col, 1.0); // objective is z
+        z_col = m.add_col(ilp_problem::integer_col, ilp_problem::double_bnd, lower_rp, heur_rp); // lower_rp <= z <= heur_rp
+        m.set_col_name(z_col, "z");
+        m.set_obj_coef(z_col, 1.0); // objective is z
         // create rp(u) variables
         // and f(u) if neeeded
+        rp_u_col.resize(n);
+        #ifdef USE_FU
+        f_u_col.resize(n);
+        #endif
         for(unsigned u = 0; u < n; u++)
         {
             #ifdef USE_FU
-            sprintf(name, "f(%u)", u);
-            
-            f_u_col[u] = glp_add_cols(p, 1);
-            glp_set_col_name(p, f_u_col[u], name);
-            glp_set_col_kind(p, f_u_col[u], GLP_IV); // intger variable
             // add constraints (1) 1 <= f(u) <= n
-            glp_set_col_bnds(p, f_u_col[u], GLP_DB, 1, n); // 1 <= f(u) <= n
+            f_u_col[u] = m.add_col(ilp_problem::integer_col, ilp_problem::double_bnd, 1, n); // 1 <= f(u) <= n
+            m.set_col_name(f_u_col[u], "f(%u)", u);
             #endif
             // rp(u)
-            sprintf(name, "rp(%u)", u);
-            
-            rp_u_col[u] = glp_add_cols(p, 1);
-            glp_set_col_name(p, rp_u_col[u], name);
-            glp_set_col_kind(p, rp_u_col[u], GLP_IV); // integer variable
-            glp_set_col_bnds(p, rp_u_col[u], GLP_LO, 0, 0); // 0 <= rp(u)
+            rp_u_col[u] = m.add_col(ilp_problem::integer_col, ilp_problem::lower_bnd, 0, 0); // 0 <= rp(u)
+            m.set_col_name(rp_u_col[u], "rp(%u)", u);
         }
         // create w(u,v) variables
+        // w(u,v) is fixed if u and v are comparable, otherwise there is only one
+        // variable for the pair: w(v,u) = 1 - w(u,v) replaces the constraints (1a)
+        w_u_v.resize(n, std::vector< ilp_lit >(n)); // w(u,u) = 0
         for(unsigned u = 0; u < n; u++)
-            for(unsigned v = 0; v < n; v++)
+            for(unsigned v = u + 1; v < n; v++)
             {
-                // w(u,v)
-                w_u_v_col[u][v] = glp_add_cols(p, 1);
-                sprintf(name, "w(%u,%u)", u, v);
-
-                glp_set_col_name(p, w_u_v_col[u][v], name);
-                glp_set_col_bnds(p, w_u_v_col[u][v], GLP_FR, 0, 0);// free variable
-                glp_set_col_kind(p, w_u_v_col[u][v], GLP_BV); // binary variable
-
-                if(u == v)
-                    glp_set_col_bnds(p, w_u_v_col[u][v], GLP_FX, 0, 0);// w(u,u) = 0
-            }
-        
-        // create va(u(ri),v), vnd(u(ri),v) variables
-        for(unsigned u = 0; u < n; u++)
-            for(unsigned i = 0; i < reg_created[u].reg_info.size(); i++)
-                for(unsigned v = 0; v < n; v++)
+                if(path.test_bit(u, v) || path.test_bit(v, u))
                 {
-                    // va(u(ri)v)
-                    va_u_i_v_col[u][i][v] = glp_add_cols(p, 1);
-                    sprintf(name, "va(%u(r%u),%u)", u, reg_created[u].reg_info[i].id, v);
-
-                    glp_set_col_name(p, va_u_i_v_col[u][i][v], name);
-                    glp_set_col_bnds(p, va_u_i_v_col[u][i][v], GLP_FR, 0, 0);// free variable
-                    glp_set_col_kind(p, va_u_i_v_col[u][i][v], GLP_BV); // binary variable
-
-                    // vnd(u(ri),v)
-                    vnd_u_i_v_col[u][i][v] = glp_add_cols(p, 1);
-                    sprintf(name, "vnd(%u(r%u),%u)", u, reg_created[u].reg_info[i].id, v);
-
-                    glp_set_col_name(p, vnd_u_i_v_col[u][i][v], name);
-                    glp_set_col_bnds(p, vnd_u_i_v_col[u][i][v], GLP_FR, 0, 0);// free variable
-                    glp_set_col_kind(p, vnd_u_i_v_col[u][i][v], GLP_BV); // binary variable
-                }
-        // add scheduling constraints: w(u,v)=not w(v,u)
-        // not necessary but gives a speedup
-        for(unsigned u = 0; u < n; u++)
-            for(unsigned v = 0; v < n; v++)
-            {
-                // skip u=v because neither is true
-                if(u == v)
+                    w_u_v[u][v] = ilp_lit::constant(path.test_bit(u, v));
+                    w_u_v[v][u] = ilp_lit::constant(path.test_bit(v, u));
                     continue;
-                // w(u,v) + w(v,u) = 1
-                {
-                    int row = glp_add_rows(p, 1);
-
-                    sprintf(name, "(1a)(%u,%u)", u, v);
-                    glp_set_row_name(p, row, name);
-                    glp_set_row_bnds(p, row, GLP_FX, 1, 1);
-                    int idx[3];
-                    idx[1] = w_u_v_col[u][v];
-                    idx[2] = w_u_v_col[v][u];
-                    double val[3];
-                    val[1] = 1.0;
-                    val[2] = 1.0;
-                    glp_set_mat_row(p, row, 2, idx, val);
                 }
+                // w(u,v)
+                int col = m.add_col(ilp_problem::binary_col, ilp_problem::double_bnd, 0, 1); // binary variable
+                m.set_col_name(col, "w(%u,%u)", u, v);
+                w_u_v[u][v] = ilp_lit::column(col, false);
+                w_u_v[v][u] = ilp_lit::column(col, true);
             }
         #ifdef USE_WUV_TRANSITIVITY
         // add scheduling constraints: w(u,x) /\ w(x,v) => w(u,v)
-        for(unsigned u = 0; u < n; u++)
-            for(unsigned x = 0; x < n; x++)
-                for(unsigned v = 0; v < n; v++)
+        // with w(v,u) = 1 - w(u,v), the six orders of {u,x,v} give the two sides of
+        // 0 <= w(u,x) + w(x,v) - w(u,v) <= 1 for u < x < v
+        for(unsigned u = 0; u < n && !lazy_transitivity; u++)
+            for(unsigned x = u + 1; x < n; x++)
+                for(unsigned v = x + 1; v < n; v++)
                 {
-                    if(u==v || u==x || v==x)
-                        continue;
-                    // w(u,x) + w(x,v) <= 1 + w(u,v)
-                    // <=> w(u,x) + w(x,v) - w(u,v) <= 1
-                    int row = glp_add_rows(p, 1);
-
-                    sprintf(name, "(2)(%u,%u,%u)", u, x, v);
-                    glp_set_row_name(p, row, name);
-                    glp_set_row_bnds(p, row, GLP_UP, 0, 1);
-                    int idx[4];
-                    idx[1] = w_u_v_col[u][x];
-                    idx[2] = w_u_v_col[x][v];
-                    idx[3] = w_u_v_col[u][v];
-                    double val[4];
-                    val[1] = 1.0;
-                    val[2] = 1.0;
-                    val[3] = -1.0;
-                    glp_set_mat_row(p, row, 3, idx, val);
+                    ilp_expr e;
+                    e.add(w_u_v[u][x], 1.0);
+                    e.add(w_u_v[x][v], 1.0);
+                    e.add(w_u_v[u][v], -1.0);
+                    int row = ilp_add_row(m, ilp_problem::double_bnd, 0, 1, e);
+                    m.set_row_name(row, "(2)(%u,%u,%u)", u, x, v);
                 }
         #endif
         #ifdef USE_FU
@@ -287,175 +504,129 @@ void mris_ilp_scheduler::schedule(schedule_dag& dag, schedule_chain& sc) const
                 // f(u) - f(v) > -n*w(u,v)
                 // <=> f(u) - f(v) + n*w(u,v) >= 1
                 {
-                    int row = glp_add_rows(p, 1);
-
-                    sprintf(name, "(2a)(%u,%u)", u, v);
-                    glp_set_row_name(p, row, name);
-                    glp_set_row_bnds(p, row, GLP_LO, 1, 0);
-                    int idx[4];
-                    idx[1] = f_u_col[u];
-                    idx[2] = f_u_col[v];
-                    idx[3] = w_u_v_col[u][v];
-                    double val[4];
-                    val[1] = 1.0;
-                    val[2] = -1.0;
-                    val[3] = (double)n;
-                    glp_set_mat_row(p, row, 3, idx, val);
+                    ilp_expr e;
+                    e.add_col(f_u_col[u], 1.0, false);
+                    e.add_col(f_u_col[v], -1.0, false);
+                    e.add(w_u_v[u][v], (double)n);
+                    int row = ilp_add_row(m, ilp_problem::lower_bnd, 1, 0, e);
+                    m.set_row_name(row, "(2a)(%u,%u)", u, v);
                 }
 
                 // f(v) - f(u) > -n*(1 - w(u,v))
                 // <=> f(v) - f(u) - n*w(u,v) >= 1-n
                 {
-                    int row = glp_add_rows(p, 1);
-
-                    sprintf(name, "(2b)(%u,%u)", u, v);
-                    glp_set_row_name(p, row, name);
-                    glp_set_row_bnds(p, row, GLP_LO, 1.0-n, 0);
-                    int idx[4];
-                    idx[1] = f_u_col[v];
-                    idx[2] = f_u_col[u];
-                    idx[3] = w_u_v_col[u][v];
-                    double val[4];
-                    val[1] = 1.0;
-                    val[2] = -1.0;
-                    val[3] = -(double)n;
-                    glp_set_mat_row(p, row, 3, idx, val);
+                    ilp_expr e;
+                    e.add_col(f_u_col[v], 1.0, false);
+                    e.add_col(f_u_col[u], -1.0, false);
+                    e.add(w_u_v[u][v], -(double)n);
+                    int row = ilp_add_row(m, ilp_problem::lower_bnd, 1.0 - n, 0, e);
+                    m.set_row_name(row, "(2b)(%u,%u)", u, v);
                 }
             }
         #endif
-        // for each (u,v) arc, fix the w(u,v) variable to 1 or 0
-        for(size_t i = 0; i < dag.get_deps().size(); i++)
-        {
-            const schedule_dep& dep = dag.get_deps()[i];
-            unsigned u = unit_map[dep.from()];
-            unsigned v = unit_map[dep.to()];
-
-            glp_set_col_bnds(p, w_u_v_col[u][v], GLP_FX, 1.0, 1.0);
-            glp_set_col_bnds(p, w_u_v_col[v][u], GLP_FX, 0.0, 0.0);
-        }
-        // add live ranges constraints
+        // create va(u(ri),v), vnd(u(ri),v) variables and the constraints defining them,
+        // the reachability to the killers of u(ri) often fixes them
+        vnd_u_i_v.resize(n);
+        va_u_i_v.resize(n);
         for(unsigned u = 0; u < n; u++)
         {
-            // rp(u) >= sum_over_creators(v) sum_over_reg_created(v(ri)) va(v(ri),u)
-            // <=> rp(u) - sum_over_creators(v) sum_over_reg_created(v(ri)) va(v(ri),u) >= 0
-            {
-                int row = glp_add_rows(p, 1);
-
-                sprintf(name, "(3)(%u)", u);
-                glp_set_row_name(p, row, name);
-                glp_set_row_bnds(p, row, GLP_LO, 0, 0);
-
-                std::vector< unsigned > col_indices;
-                for(unsigned v = 0; v < n; v++)
-                    for(unsigned i = 0; i < reg_created[v].reg_info.size(); i++)
-                        col_indices.push_back(va_u_i_v_col[v][i][u]);
-
-                unsigned k = col_indices.size();
-                int *idx = new int[2 + k];
-                double *val = new double[2 + k];
-                idx[1] = rp_u_col[u];
-                val[1] = 1.0;
-                for(size_t i = 0; i < k; i++)
-                {
-                    idx[2 + i] = col_indices[i];
-                    val[2 + i] = -1.0;
-                }
-                glp_set_mat_row(p, row, 1 + k, idx, val);
-
-                delete[] idx;
-                delete[] val;
-            }
+            vnd_u_i_v[u].resize(reg_created[u].reg_info.size(), std::vector< ilp_lit >(n));
+            va_u_i_v[u].resize(reg_created[u].reg_info.size(), std::vector< ilp_lit >(n));
 
             for(unsigned i = 0; i < reg_created[u].reg_info.size(); i++)
+            {
+                const std::vector< unsigned >& killers = reg_created[u].reg_info[i].killers;
+
                 for(unsigned v = 0; v < n; v++)
                 {
-                    // (1-w(v,u)) + vnd(u(ri),v) >= 2*va(u(ri),v)
-                    // <=> 2*va(u(ri),v) + w(v,u) - vnd(u(ri),v) <= 1
+                    // v before u: ri is not alive
+                    if(v != u && path.test_bit(v, u))
+                        continue; // va(u(ri),v) = 0
+                    // vnd(u(ri),v) = 1 iff a killer is after v
+                    bool killer_after = false;
+                    bool all_killers_before = true;
+                    for(size_t j = 0; j < killers.size(); j++)
                     {
-                        int row = glp_add_rows(p, 1);
-
-                        sprintf(name, "(4a)(%u(r%d),%u)", u, reg_created[u].reg_info[i].id, v);
-                        glp_set_row_name(p, row, name);
-                        glp_set_row_bnds(p, row, GLP_UP, 0, 1);
-                        int idx[4];
-                        idx[1] = va_u_i_v_col[u][i][v];
-                        idx[2] = w_u_v_col[v][u];
-                        idx[3] = vnd_u_i_v_col[u][i][v];
-                        double val[4];
-                        val[1] = 2.0;
-                        val[2] = 1.0;
-                        val[3] = -1.0;
-                        glp_set_mat_row(p, row, 3, idx, val);
+                        if(killers[j] != v && path.test_bit(v, killers[j]))
+                            killer_after = true;
+                        if(!path.test_bit(killers[j], v))
+                            all_killers_before = false;
                     }
-                    // (1-w(v,u)) + vnd(u(ri),v) <= 1 + va(u(ri),v)
-                    // <=> va(u(ri),v) + w(v,u(ri)) - vnd(u(ri),v) >= 0
+                    if(all_killers_before)
+                        continue; // va(u(ri),v) = 0
+                    if(killer_after)
                     {
-                        int row = glp_add_rows(p, 1);
-
-                        sprintf(name, "(4b)(%u(r%d),%u)", u, reg_created[u].reg_info[i].id, v);
-                        glp_set_row_name(p, row, name);
-                        glp_set_row_bnds(p, row, GLP_LO, 0, 0);
-                        int idx[4];
-                        idx[1] = w_u_v_col[v][u];
-                        idx[2] = vnd_u_i_v_col[u][i][v];
-                        idx[3] = va_u_i_v_col[u][i][v];
-                        double val[4];
-                        val[1] = 1.0;
-                        val[2] = -1.0;
-                        val[3] = 1.0;
-                        glp_set_mat_row(p, row, 3, idx, val);
+                        // va(u(ri),v) = 1 - w(v,u)
+                        va_u_i_v[u][i][v] = ilp_not(w_u_v[v][u]);
+                        continue;
                     }
+                    // vnd(u(ri),v)
+                    int vnd_col = m.add_col(ilp_problem::binary_col, ilp_problem::double_bnd, 0, 1); // binary variable
+                    m.set_col_name(vnd_col, "vnd(%u(r%u),%u)", u, reg_created[u].reg_info[i].id, v);
+                    vnd_u_i_v[u][i][v] = ilp_lit::column(vnd_col, false);
+
                     // sum_over_killers(u(ri))(x) w(v,x) >= vnd(u(ri),v)
                     // <=> sum_over_killers(u(ri))(x) w(v,x) - vnd(u(ri),v) >= 0
-                    {
-                        int row = glp_add_rows(p, 1);
-
-                        sprintf(name, "(5a)(%u(r%d),%u)", u, reg_created[u].reg_info[i].id, v);
-                        glp_set_row_name(p, row, name);
-                        glp_set_row_bnds(p, row, GLP_LO, 0, 0);
-
-                        unsigned k = reg_created[u].reg_info[i].killers.size();
-                        int *idx = new int[2 + k];
-                        double *val = new double[2 + k];
-                        idx[1] = vnd_u_i_v_col[u][i][v];
-                        val[1] = -1.0;
-                        for(unsigned j = 0; j < k; j++)
-                        {
-                            unsigned x = reg_created[u].reg_info[i].killers[j];
-                            idx[2 + j] = w_u_v_col[v][x];
-                            val[2 + j] = 1.0;
-                        }
-                        glp_set_mat_row(p, row, 1 + k, idx, val);
-
-                        delete[] idx;
-                        delete[] val;
-                    }
                     // sum_over_killers(u(ri))(x) w(v,x) <= nb_killers * vnd(u(ri),v)
                     // <=> sum_over_killers(u(ri))(x) w(v,x) - nb_killers * vnd(u(ri),v) <= 0
+                    for(int side = 0; side < 2; side++)
                     {
-                        int row = glp_add_rows(p, 1);
+                        ilp_expr e;
+                        unsigned k = killers.size();
+                        e.add(vnd_u_i_v[u][i][v], side == 0 ? -1.0 : -(double)k);
+                        for(unsigned j = 0; j < k; j++)
+                            e.add(w_u_v[v][killers[j]], 1.0);
+                        int row = ilp_add_row(m, side == 0 ? ilp_problem::lower_bnd : ilp_problem::upper_bnd, 0, 0, e);
+                        m.set_row_name(row, "(5%c)(%u(r%d),%u)", side == 0 ? 'a' : 'b', u,
+                            reg_created[u].reg_info[i].id, v);
+                    }
 
-                        sprintf(name, "(5b)(%u(r%d),%u)", u, reg_created[u].reg_info[i].id, v);
-                        glp_set_row_name(p, row, name);
-                        glp_set_row_bnds(p, row, GLP_UP, 0, 0);
+                    // u before v: va(u(ri),v) = vnd(u(ri),v)
+                    if(w_u_v[v][u].is_constant())
+                    {
+                        va_u_i_v[u][i][v] = vnd_u_i_v[u][i][v];
+                        continue;
+                    }
+                    // va(u(ri)v)
+                    int va_col = m.add_col(ilp_problem::binary_col, ilp_problem::double_bnd, 0, 1); // binary variable
+                    m.set_col_name(va_col, "va(%u(r%u),%u)", u, reg_created[u].reg_info[i].id, v);
+                    va_u_i_v[u][i][v] = ilp_lit::column(va_col, false);
 
-                        unsigned k = reg_created[u].reg_info[i].killers.size();
-                        int *idx = new int[2 + k];
-                        double *val = new double[2 + k];
-                        idx[1] = vnd_u_i_v_col[u][i][v];
-                        val[1] = -(double)k;
-                        for(unsigned j = 0; j < k; j++)
-                        {
-                            unsigned x = reg_created[u].reg_info[i].killers[j];
-                            idx[2 + j] = w_u_v_col[v][x];
-                            val[2 + j] = 1.0;
-                        }
-                        glp_set_mat_row(p, row, 1 + k, idx, val);
-
-                        delete[] idx;
-                        delete[] val;
+                    // (1-w(v,u)) + vnd(u(ri),v) >= 2*va(u(ri),v)
+                    // <=> 2*va(u(ri),v) + w(v,u) - vnd(u(ri),v) <= 1
+                    {
+                        ilp_expr e;
+                        e.add(va_u_i_v[u][i][v], 2.0);
+                        e.add(w_u_v[v][u], 1.0);
+                        e.add(vnd_u_i_v[u][i][v], -1.0);
+                        int row = ilp_add_row(m, ilp_problem::upper_bnd, 0, 1, e);
+                        m.set_row_name(row, "(4a)(%u(r%d),%u)", u, reg_created[u].reg_info[i].id, v);
+                    }
+                    // (1-w(v,u)) + vnd(u(ri),v) <= 1 + va(u(ri),v)
+                    // <=> va(u(ri),v) + w(v,u(ri)) - vnd(u(ri),v) >= 0
+                    {
+                        ilp_expr e;
+                        e.add(w_u_v[v][u], 1.0);
+                        e.add(vnd_u_i_v[u][i][v], -1.0);
+                        e.add(va_u_i_v[u][i][v], 1.0);
+                        int row = ilp_add_row(m, ilp_problem::lower_bnd, 0, 0, e);
+                        m.set_row_name(row, "(4b)(%u(r%d),%u)", u, reg_created[u].reg_info[i].id, v);
                     }
                 }
+            }
+        }
+        // add live ranges constraints
+        for(unsigned u = 0; u < n; u++)
+        {
+            // rp(u) >= sum_over_creators(v) sum_over_reg_created(v(ri)) va(v(ri),u)
+            // <=> rp(u) - sum_over_creators(v) sum_over_reg_created(v(ri)) va(v(ri),u) >= 0
+            ilp_expr e;
+            e.add_col(rp_u_col[u], 1.0, false);
+            for(unsigned v = 0; v < n; v++)
+                for(unsigned i = 0; i < reg_created[v].reg_info.size(); i++)
+                    e.add(va_u_i_v[v][i][u], -1.0);
+            int row = ilp_add_row(m, ilp_problem::lower_bnd, 0, 0, e);
+            m.set_row_name(row, "(3)(%u)", u);
         }
         // register pressure synthesis
         for(unsigned u = 0; u < n; u++)
@@ -463,188 +634,95 @@ void mris_ilp_scheduler::schedule(schedule_dag& dag, schedule_chain& sc) const
             // z >= rp(u) + MAX(0, irp(u) - var_created(u))
             // <=> z - rp(u) >= MAX(0, irp(u) - var_created(u))
             {
-                int row = glp_add_rows(p, 1);
-                
                 double lo = std::max(0, (int)units[u]->internal_register_pressure() - (int)reg_created[u].reg_info.size());
-                
-                sprintf(name, "(6)(%u)", u);
-                glp_set_row_name(p, row, name);
-                glp_set_row_bnds(p, row, GLP_LO, lo, 0);
-                int idx[3];
-                idx[1] = z_col;
-                idx[2] = rp_u_col[u];
-                double val[3];
-                val[1] = 1.0;
-                val[2] = -1.0;
-                glp_set_mat_row(p, row, 2, idx, val);
+
+                ilp_expr e;
+                e.add_col(z_col, 1.0, false);
+                e.add_col(rp_u_col[u], -1.0, false);
+                int row = ilp_add_row(m, ilp_problem::lower_bnd, lo, 0, e);
+                m.set_row_name(row, "(6)(%u)", u);
             }
         }
-        #ifdef POST_GEN_OPT
-        // add post generation additional constraint to speedup
+
+        if(m_verbose)
+            debug() << "mris_ilp: " << m.get_row_count() << " rows, " << m.get_col_count()
+                << " columns for " << n << " units\n";
+
+        // the heuristic schedule as a solution of the model, it is the first incumbent
+        std::vector< double > heur_x(m.get_col_count() + 1, 0.0);
         {
-            std::vector< std::vector< bool > > path;
-            path.resize(n);
+            std::vector< size_t > pos(n);
+            for(size_t i = 0; i < n; i++)
+                pos[dag.index_of(heur_sc.get_unit_at(i))] = i;
+            #ifdef USE_FU
             for(unsigned u = 0; u < n; u++)
-                path[u].resize(n);
-            // compute path map
+                heur_x[f_u_col[u]] = pos[u] + 1;
+            #endif
             for(unsigned u = 0; u < n; u++)
-            {
-                std::queue< unsigned > q;
-                q.push(u);
-
-                while(!q.empty())
+                for(unsigned v = u + 1; v < n; v++)
+                    ilp_set_val(heur_x, w_u_v[u][v], pos[u] < pos[v]);
+            std::vector< unsigned > rp_u(n, 0);
+            for(unsigned u = 0; u < n; u++)
+                for(unsigned i = 0; i < reg_created[u].reg_info.size(); i++)
                 {
-                    unsigned v = q.front();
-                    q.pop();
-                    if(path[u][v])
-                        continue;
-                    path[u][v] = true;
-                    for(size_t i = 0; i < dag.get_succs(units[v]).size(); i++)
-                        q.push(unit_map[dag.get_succs(units[v])[i].to()]);
+                    const std::vector< unsigned >& killers = reg_created[u].reg_info[i].killers;
+                    for(unsigned v = 0; v < n; v++)
+                    {
+                        bool killer_after = false;
+                        for(size_t j = 0; j < killers.size(); j++)
+                            killer_after = killer_after || pos[v] < pos[killers[j]];
+                        bool alive = pos[u] <= pos[v] && killer_after;
+                        if(!vnd_u_i_v[u][i][v].is_constant())
+                            ilp_set_val(heur_x, vnd_u_i_v[u][i][v], killer_after);
+                        ilp_set_val(heur_x, va_u_i_v[u][i][v], alive);
+                        rp_u[v] += alive;
+                    }
                 }
-            }
-        }
-        #endif
-        
-        #if 0
-        std::ifstream fin("test.sol");
-        if(fin)
-        {
-            int r, c;
-            std::string line;
-            std::getline(fin, line);
-            std::istringstream iss(line);
-            iss >> r >> c;
-            assert(r == glp_get_num_rows(p) && c == glp_get_num_cols(p));
-            int count = 1 + r;
-            while(count-- > 0)
-                std::getline(fin, line);
-            std::cout << "zcol=" << z_col << "\n";
-            for(int i = 0; i < c; i++)
+            unsigned z = 0;
+            for(unsigned u = 0; u < n; u++)
             {
-                std::getline(fin, line);
-                std::istringstream iss(line);
-                int val;
-                iss >> val;
-                glp_set_col_bnds(p, i + 1, GLP_FX, val, val);
+                heur_x[rp_u_col[u]] = rp_u[u];
+                z = std::max(z, rp_u[u] + std::max(0, (int)units[u]->internal_register_pressure() -
+                    (int)reg_created[u].reg_info.size()));
             }
-            fin.close();
-        }
-        #endif
-
-        glp_term_out(m_verbose ? GLP_ON : GLP_OFF);
-        //glp_write_lp(p, 0, "test.lp");
-        //glp_write_mps(p, GLP_MPS_FILE, 0, "test.mps");
-
-        #if 0
-        glp_read_mip(p, "test.sol");
-        #undef SOLVE_WITH_GLPK
-        #undef SOLVE_WITH_SYMPHONY
-        #endif
-
-        #ifdef SOLVE_WITH_GLPK
-
-        /*
-        glp_iptcp pre_cp;
-        glp_init_iptcp(&pre_cp);
-        pre_cp.msg_lev = m_verbose ? GLP_MSG_ALL : GLP_MSG_OFF;
-        pre_cp.ord_alg = GLP_ORD_NONE;
-
-        int sts = glp_interior(p, &pre_cp);
-        if(sts != 0)
-            ILP_ERROR("LP relaxation solver error !");
-        switch(glp_ipt_status(p))
-        {
-            case GLP_UNDEF: ILP_ERROR("LP relaxation solution is undefined !");
-            case GLP_NOFEAS: ILP_ERROR("LP relaxation has no solution !");
-            case GLP_INFEAS: ILP_ERROR("LP relaxation cannot be solved using interior point !");
-            default: break;
+            heur_x[z_col] = z;
         }
-        */
 
-        glp_iocp cp;
-        glp_init_iocp(&cp);
-        cp.presolve = GLP_ON;
-        cp.gmi_cuts = GLP_ON;
-        cp.mir_cuts = GLP_ON;
-        cp.cov_cuts = GLP_ON;
-        cp.clq_cuts = GLP_ON;
-        cp.msg_lev = m_verbose ? GLP_MSG_ALL : GLP_MSG_OFF;
-        if(m_timeout)
-            cp.tm_lim = m_timeout;
-
-        int sts = glp_intopt(p, &cp);
-        if(sts != 0)
-            ILP_ERROR("ILP solver error !");
-        switch(glp_mip_status(p))
+        std::vector< double > x;
         {
-            case GLP_OPT: break;
-            default: ILP_ERROR("ILP no solution found or no solution !");
-        }
-
-        #elif defined(SOLVE_WITH_SYMPHONY)
-        sym_environment *env = sym_open_environment();
-        if(env == NULL)
-            ILP_ERROR("Cannot init SYMPHONY library !");
-        if(sym_set_defaults(env) != FUNCTION_TERMINATED_NORMALLY)
-            ILP_ERROR("Cannot set default parameters for SYMPHOMY !");
-        if(sym_read_mps(env, "test.mps") != FUNCTION_TERMINATED_NORMALLY)
-            ILP_ERROR("Cannot load MPS file in SYMPHOMY !");
-        int ret = sym_solve(env);
-        switch(ret)
-        {
-            case TM_OPTIMAL_SOLUTION_FOUND: break;
-            default: ILP_ERROR("ILP solver error !");
+            #ifdef LAZY_WUV_TRANSITIVITY
+            wuv_transitivity_separator sep(w_u_v);
+            const ilp_separator *lazy_sep = lazy_transitivity ? &sep : 0;
+            #else
+            const ilp_separator *lazy_sep = 0;
+            #endif
+            switch(backend.solve(m, heur_x, lazy_sep, meter, m_verbose, x))
+            {
+                case ilp_backend::optimal: break;
+                case ilp_backend::exhausted:
+                    // keep the best known schedule: the incumbent of the backend
+                    // if it has one, or the heuristic schedule the model starts from
+                    exhausted = true;
+                    if(m_verbose)
+                        debug() << "mris_ilp: budget exhausted, keep the best known schedule\n";
+                    if(x.empty() || x[z_col] > heur_x[z_col])
+                        x = heur_x;
+                    break;
+                default: ILP_ERROR("ILP solver error or no solution !");
+            }
         }
-        sym_close_environment(env);
-        #else
-        #warning You need to specify a solve !
-        #endif
 
-        //glp_write_mip(p, "test.sol");
 
         /* retrieve solution */
         std::vector< unsigned > placement;
-        std::set< unsigned > to_be_placed;
-        for(unsigned u = 0; u < n; u++)
-            to_be_placed.insert(u);
-
-        for(unsigned u = 0; u < n; u++)
+        if(!ilp_sol_placement(x, w_u_v, placement))
         {
-            /* pick an instruction not already placement */
-            unsigned cur_inst = *to_be_placed.begin();
-            //std::cout << "Cur instruction: " << units[cur_inst]->to_string() << "\n";
-            /* for each instruction X to be placed */
-            std::set< unsigned >::iterator it = to_be_placed.begin();
-            for(; it != to_be_placed.end(); ++it)
-            {
-                /* if w(X,cur_inst)=1, then select X */
-                unsigned val = glp_mip_col_val(p, w_u_v_col[*it][cur_inst]);
-                if(val)
-                {
-                    cur_inst = *it;
-                    //std::cout << "  Switch to: " << units[cur_inst]->to_string() << "\n";
-                }
-            }
-            /* check cur_inst is okay (sanity check) */
-            for(size_t i = 0; i < placement.size(); i++)
-            {
-                unsigned val = glp_mip_col_val(p, w_u_v_col[placement[i]][cur_inst]);
-                if(val != 1)
-                    ILP_ERROR("ILP solver went mad ! (1)");
-            }
-            /* check already scheduled instruction should have been scheduled before ! */
-            it = to_be_placed.begin();
-            for(; it != to_be_placed.end(); ++it)
-            {
-                unsigned val = glp_mip_col_val(p, w_u_v_col[cur_inst][*it]);
-                if(cur_inst != *it && val != 1)
-                    ILP_ERROR("ILP solver went mad ! (2)");
-            }
-            /* add instruction */
-            //std::cout << "  Emit: " << units[cur_inst]->to_string() << "\n";
-            placement.push_back(cur_inst);
-            to_be_placed.erase(cur_inst);
+            // safety net: the backends must not return a solution which breaks
+            // the transitivity rows not added yet, but the heuristic schedule
+            // is still valid if the budget was exhausted
+            if(!exhausted || !ilp_sol_placement(heur_x, w_u_v, placement))
+                ILP_ERROR("ILP solver went mad !");
+            x = heur_x;
         }
 
         /*
@@ -664,18 +742,23 @@ void mris_ilp_scheduler::schedule(schedule_dag& dag, schedule_chain& sc) const
             for(unsigned u = 0; u < n; u++)
                 gsc.append_unit(units[placement[u]]);
 
-            assert(glp_mip_obj_val(p) == gsc.compute_rp_against_dag(dag) &&
+            /* the z of a solution which is not optimal only bounds the RP */
+            assert((exhausted ? x[z_col] >= gsc.compute_rp_against_dag(dag) :
+                    x[z_col] == gsc.compute_rp_against_dag(dag)) &&
                     "Mismatch between announced and actual RP in mris_ilp_scheduler");
         }
         #endif
-        
-        glp_delete_prob(p);
+
         STM_STOP(mris_ilp_scheduler)
+        meter.stop();
+        m_budget_usage.add(meter, exhausted);
         return;
     }
 
     Lerror:
     STM_STOP(mris_ilp_scheduler)
+    meter.stop();
+    m_budget_usage.add(meter, exhausted);
     debug() << "mris_schedule fallback\n";
     if(m_fallback_sched)
         m_fallback_sched->schedule(dag, sc);
@@ -0,0 +1,584 @@
+#include "sched-dag.hpp"
+#include "tools.hpp"
+#include <stdexcept>
+#include <cassert>
+
+namespace PAMAURY_SCHEDULER_NS
+{
+
+/**
+ * Dependency pool
+ */
+schedule_dep_range compact_schedule_dag::dep_pool::range(size_t idx) const
+{
+    const dep_segment& seg = segs[idx];
+    if(seg.size == 0)
+        return schedule_dep_range();
+    const schedule_dep *p = &deps[seg.off];
+    return schedule_dep_range(p, p + seg.size);
+}
+
+void compact_schedule_dag::dep_pool::push(size_t idx, const schedule_dep& d, size_t p)
+{
+    dep_segment& seg = segs[idx];
+    if(seg.size == seg.cap)
+    {
+        /* segment is full: move it to the end of the array with twice the room */
+        size_t new_cap = seg.cap < 2 ? 4 : 2 * seg.cap;
+        size_t new_off = deps.size();
+        deps.resize(new_off + new_cap);
+        pos.resize(new_off + new_cap);
+        for(size_t i = 0; i < seg.size; i++)
+        {
+            deps[new_off + i] = deps[seg.off + i];
+            pos[new_off + i] = pos[seg.off + i];
+        }
+        garbage += seg.cap;
+        seg.off = new_off;
+        seg.cap = new_cap;
+    }
+    deps[seg.off + seg.size] = d;
+    pos[seg.off + seg.size] = p;
+    seg.size++;
+
+    if(garbage > 64 && 2 * garbage > deps.size())
+        compact();
+}
+
+void compact_schedule_dag::dep_pool::pop(size_t idx)
+{
+    segs[idx].size--;
+}
+
+bool compact_schedule_dag::dep_pool::find(size_t idx, const schedule_dep& d, size_t& p) const
+{
+    const dep_segment& seg = segs[idx];
+    for(size_t i = seg.off; i < seg.off + seg.size; i++)
+        if(deps[i] == d)
+        {
+            p = pos[i];
+            return true;
+        }
+    return false;
+}
+
+void compact_schedule_dag::dep_pool::remove_pos(size_t idx, size_t p)
+{
+    dep_segment& seg = segs[idx];
+    size_t last = seg.off + seg.size - 1;
+    for(size_t i = seg.off; i <= last; i++)
+        if(pos[i] == p)
+        {
+            deps[i] = deps[last];
+            pos[i] = pos[last];
+            seg.size--;
+            return;
+        }
+    assert(false && "dependency is not attached to its unit");
+}
+
+void compact_schedule_dag::dep_pool::change_pos(size_t idx, size_t old_p, size_t new_p)
+{
+    const dep_segment& seg = segs[idx];
+    for(size_t i = seg.off; i < seg.off + seg.size; i++)
+        if(pos[i] == old_p)
+        {
+            pos[i] = new_p;
+            return;
+        }
+    assert(false && "dependency is not attached to its unit");
+}
+
+void compact_schedule_dag::dep_pool::set_dep(size_t idx, size_t p, const schedule_dep& d)
+{
+    const dep_segment& seg = segs[idx];
+    for(size_t i = seg.off; i < seg.off + seg.size; i++)
+        if(pos[i] == p)
+        {
+            deps[i] = d;
+            return;
+        }
+    assert(false && "dependency is not attached to its unit");
+}
+
+void compact_schedule_dag::dep_pool::release(size_t idx)
+{
+    garbage += segs[idx].cap;
+    segs[idx] = dep_segment();
+}
+
+void compact_schedule_dag::dep_pool::compact()
+{
+    /* rebuild the array in unit order, keeping the slack of each segment */
+    size_t total = 0;
+    for(size_t u = 0; u < segs.size(); u++)
+        total += segs[u].cap;
+    std::vector< schedule_dep > new_deps(total);
+    std::vector< size_t > new_pos(total);
+    size_t off = 0;
+    for(size_t u = 0; u < segs.size(); u++)
+    {
+        dep_segment& seg = segs[u];
+        for(size_t i = 0; i < seg.size; i++)
+        {
+            new_deps[off + i] = deps[seg.off + i];
+            new_pos[off + i] = pos[seg.off + i];
+        }
+        seg.off = off;
+        off += seg.cap;
+    }
+    deps.swap(new_deps);
+    pos.swap(new_pos);
+    garbage = 0;
+}
+
+/**
+ * Compact Implementation
+ */
+compact_schedule_dag::compact_schedule_dag()
+    :m_ends_dirty(false)
+{
+    set_modified(false);
+}
+
+compact_schedule_dag::compact_schedule_dag(const schedule_dag& dag)
+    :schedule_dag(), m_ends_dirty(false)
+{
+    add_units(dag.get_units());
+    add_dependencies(dag.get_deps());
+    set_modified(false);
+}
+
+compact_schedule_dag::~compact_schedule_dag()
+{
+}
+
+compact_schedule_dag *compact_schedule_dag::dup() const
+{
+    return new compact_schedule_dag(*this);
+}
+
+bool compact_schedule_dag::modified() const
+{
+    return m_modified;
+}
+
+void compact_schedule_dag::set_modified(bool mod)
+{
+    m_modified = mod;
+}
+
+size_t compact_schedule_dag::index_of(const schedule_unit *unit) const
+{
+    size_t idx;
+    if(!m_index.find(unit, idx))
+        throw std::runtime_error("compact_schedule_dag::index_of: unit is not in the graph");
+    return idx;
+}
+
+schedule_dep_range compact_schedule_dag::get_succs(const schedule_unit *su) const
+{
+    size_t idx;
+    if(!m_index.find(su, idx))
+        return schedule_dep_range();
+    return m_succs.range(idx);
+}
+
+schedule_dep_range compact_schedule_dag::get_preds(const schedule_unit *su) const
+{
+    size_t idx;
+    if(!m_index.find(su, idx))
+        return schedule_dep_range();
+    return m_preds.range(idx);
+}
+
+void compact_schedule_dag::end_batch()
+{
+    if(m_ends_dirty)
+        rebuild_ends();
+}
+
+void compact_schedule_dag::rebuild_ends() const
+{
+    m_roots.clear();
+    m_leaves.clear();
+    for(size_t u = 0; u < m_units.size(); u++)
+    {
+        if(m_preds.segs[u].size == 0)
+        {
+            m_root_pos[u] = m_roots.size();
+            m_roots.push_back(m_units[u]);
+        }
+        if(m_succs.segs[u].size == 0)
+        {
+            m_leaf_pos[u] = m_leaves.size();
+            m_leaves.push_back(m_units[u]);
+        }
+    }
+    m_ends_dirty = false;
+}
+
+void compact_schedule_dag::add_root(size_t idx)
+{
+    if(m_ends_dirty)
+        return;
+    m_root_pos[idx] = m_roots.size();
+    m_roots.push_back(m_units[idx]);
+}
+
+void compact_schedule_dag::remove_root(size_t idx)
+{
+    if(m_ends_dirty)
+        return;
+    size_t pos = m_root_pos[idx];
+    m_roots[pos] = m_roots.back();
+    m_root_pos[index_of(m_roots[pos])] = pos;
+    m_roots.pop_back();
+}
+
+void compact_schedule_dag::add_leaf(size_t idx)
+{
+    if(m_ends_dirty)
+        return;
+    m_leaf_pos[idx] = m_leaves.size();
+    m_leaves.push_back(m_units[idx]);
+}
+
+void compact_schedule_dag::remove_leaf(size_t idx)
+{
+    if(m_ends_dirty)
+        return;
+    size_t pos = m_leaf_pos[idx];
+    m_leaves[pos] = m_leaves.back();
+    m_leaf_pos[index_of(m_leaves[pos])] = pos;
+    m_leaves.pop_back();
+}
+
+void compact_schedule_dag::remove_dep_at(size_t pos)
+{
+    size_t last = m_deps.size() - 1;
+    if(pos != last)
+    {
+        /* the last dependency takes the free slot, update its position */
+        const schedule_dep& moved = m_deps[last];
+        m_succs.change_pos(index_of(moved.from()), last, pos);
+        m_preds.change_pos(index_of(moved.to()), last, pos);
+        m_deps[pos] = moved;
+    }
+    m_deps.pop_back();
+}
+
+void compact_schedule_dag::add_unit(const schedule_unit *u)
+{
+    if(in_batch())
+        m_ends_dirty = true;
+    size_t idx = m_units.size();
+    m_index.set(u, idx);
+    m_units.push_back(u);
+    m_preds.segs.push_back(dep_segment());
+    m_succs.segs.push_back(dep_segment());
+    m_root_pos.push_back(0);
+    m_leaf_pos.push_back(0);
+    add_root(idx);
+    add_leaf(idx);
+
+    notify_unit_added(u);
+    end_change("add_unit");
+}
+
+void compact_schedule_dag::remove_unit(const schedule_unit *u)
+{
+    if(in_batch())
+        m_ends_dirty = true;
+    notify_unit_removed(u);
+    size_t idx = index_of(u);
+
+    if(m_preds.segs[idx].size == 0)
+        remove_root(idx);
+    if(m_succs.segs[idx].size == 0)
+        remove_leaf(idx);
+    /* detach dependencies from the neighbours, popping them from the back so
+     * that the positions of the remaining ones are kept up to date */
+    while(m_preds.segs[idx].size != 0)
+    {
+        const dep_segment& seg = m_preds.segs[idx];
+        size_t from = index_of(m_preds.deps[seg.off + seg.size - 1].from());
+        size_t pos = m_preds.pos[seg.off + seg.size - 1];
+        m_preds.pop(idx);
+
+        m_succs.remove_pos(from, pos);
+        remove_dep_at(pos);
+        if(m_succs.segs[from].size == 0)
+            add_leaf(from);
+    }
+    while(m_succs.segs[idx].size != 0)
+    {
+        const dep_segment& seg = m_succs.segs[idx];
+        size_t to = index_of(m_succs.deps[seg.off + seg.size - 1].to());
+        size_t pos = m_succs.pos[seg.off + seg.size - 1];
+        m_succs.pop(idx);
+
+        m_preds.remove_pos(to, pos);
+        remove_dep_at(pos);
+        if(m_preds.segs[to].size == 0)
+            add_root(to);
+    }
+
+    m_preds.release(idx);
+    m_succs.release(idx);
+
+    /* move last unit into the free slot */
+    size_t last = m_units.size() - 1;
+    if(idx != last)
+    {
+        m_units[idx] = m_units[last];
+        m_preds.segs[idx] = m_preds.segs[last];
+        m_succs.segs[idx] = m_succs.segs[last];
+        m_root_pos[idx] = m_root_pos[last];
+        m_leaf_pos[idx] = m_leaf_pos[last];
+        m_index.set(m_units[idx], idx);
+    }
+    m_units.pop_back();
+    m_preds.segs.pop_back();
+    m_succs.segs.pop_back();
+    m_root_pos.pop_back();
+    m_leaf_pos.pop_back();
+    m_index.erase(u);
+
+    end_change("remove_unit");
+}
+
+void compact_schedule_dag::add_dependency(schedule_dep d)
+{
+    if(in_batch())
+        m_ends_dirty = true;
+    size_t from = index_of(d.from());
+    size_t to = index_of(d.to());
+
+    if(m_succs.segs[from].size == 0)
+        remove_leaf(from);
+    if(m_preds.segs[to].size == 0)
+        remove_root(to);
+
+    m_succs.push(from, d, m_deps.size());
+    m_preds.push(to, d, m_deps.size());
+    m_deps.push_back(d);
+
+    notify_dependency_added(d);
+    end_change("add_dependency");
+}
+
+void compact_schedule_dag::remove_dependency(schedule_dep d)
+{
+    if(in_batch())
+        m_ends_dirty = true;
+    /*
+     * Warning !
+     * If a dependency exists twice, this should remove only one instance !!
+     */
+    size_t from = index_of(d.from());
+    size_t to = index_of(d.to());
+    size_t pos;
+
+    if(m_succs.find(from, d, pos))
+    {
+        m_succs.remove_pos(from, pos);
+        m_preds.remove_pos(to, pos);
+        remove_dep_at(pos);
+
+        if(m_succs.segs[from].size == 0)
+            add_leaf(from);
+        if(m_preds.segs[to].size == 0)
+            add_root(to);
+        notify_dependency_removed(d);
+    }
+
+    end_change("remove_dependency");
+}
+
+void compact_schedule_dag::modify_dep(const schedule_dep& _old, const schedule_dep& cur)
+{
+    /* make a copy of the old one ! */
+    schedule_dep old = _old;
+    assert(old.from() == cur.from() && old.to() == cur.to() && "You can't change from/to properties with modify_dep()");
+
+    size_t from = index_of(old.from());
+    size_t to = index_of(old.to());
+    size_t pos;
+
+    if(m_succs.find(from, old, pos))
+    {
+        m_succs.set_dep(from, pos, cur);
+        m_preds.set_dep(to, pos, cur);
+        m_deps[pos] = cur;
+        notify_dependency_modified(cur);
+    }
+
+    end_change("modify_dep", false);
+}
+
+bool compact_schedule_dag::is_consistent(std::string *out_msg) const
+{
+    #define NOT_CONSISTENT(msg) { if(out_msg) *out_msg = msg; return false; }
+    if(m_ends_dirty)
+        rebuild_ends();
+    size_t n = m_units.size();
+    if(m_index.size() != n || m_preds.segs.size() != n || m_succs.segs.size() != n ||
+            m_root_pos.size() != n || m_leaf_pos.size() != n)
+        NOT_CONSISTENT("unit tables have different sizes");
+    // every unit must be indexed at its position
+    for(size_t u = 0; u < n; u++)
+    {
+        size_t idx;
+        if(!m_index.find(m_units[u], idx) || idx != u)
+            NOT_CONSISTENT("unit in master list has a wrong index");
+        if(m_preds.segs[u].size == 0 && (m_root_pos[u] >= m_roots.size() || m_roots[m_root_pos[u]] != m_units[u]))
+            NOT_CONSISTENT("root unit has a wrong position in roots list");
+        if(m_succs.segs[u].size == 0 && (m_leaf_pos[u] >= m_leaves.size() || m_leaves[m_leaf_pos[u]] != m_units[u]))
+            NOT_CONSISTENT("leaf unit has a wrong position in leaves list");
+        for(size_t i = 0; i < m_preds.segs[u].size; i++)
+        {
+            size_t p = m_preds.pos[m_preds.segs[u].off + i];
+            if(p >= m_deps.size() || m_deps[p] != m_preds.deps[m_preds.segs[u].off + i])
+                NOT_CONSISTENT("unit has a predecessor dep with a wrong position");
+        }
+        for(size_t i = 0; i < m_succs.segs[u].size; i++)
+        {
+            size_t p = m_succs.pos[m_succs.segs[u].off + i];
+            if(p >= m_deps.size() || m_deps[p] != m_succs.deps[m_succs.segs[u].off + i])
+                NOT_CONSISTENT("unit has a successor dep with a wrong position");
+        }
+    }
+    // every node in root and leaves must be in the whole list
+    // and must be consistent
+    size_t nb_roots = 0, nb_leaves = 0;
+    for(size_t i = 0; i < m_roots.size(); i++)
+    {
+        size_t idx;
+        if(!m_index.find(m_roots[i], idx))
+            NOT_CONSISTENT("unit in roots list is not in master list");
+        if(m_preds.segs[idx].size != 0)
+            NOT_CONSISTENT("unit in roots list has predecessors");
+    }
+    for(size_t i = 0; i < m_leaves.size(); i++)
+    {
+        size_t idx;
+        if(!m_index.find(m_leaves[i], idx))
+            NOT_CONSISTENT("unit in leaves list is not in master list");
+        if(m_succs.segs[idx].size != 0)
+            NOT_CONSISTENT("unit in leaves list has successors");
+    }
+    // check unit dependencies
+    size_t nb_deps = 0;
+    for(size_t u = 0; u < n; u++)
+    {
+        const schedule_unit *unit = m_units[u];
+        schedule_dep_range preds = m_preds.range(u);
+        schedule_dep_range succs = m_succs.range(u);
+        size_t idx;
+
+        for(size_t j = 0; j < preds.size(); j++)
+        {
+            // dependency must go to the unit !
+            if(preds[j].to() != unit)
+                NOT_CONSISTENT("unit has invalid predeccessor dep (it is not the target !)");
+            // dependency must come from somewhere
+            if(!m_index.find(preds[j].from(), idx))
+                NOT_CONSISTENT("unit has invalid predeccessor dep (source does not exist !)");
+            // dependency must be attached to the source
+            if(!container_contains(m_succs.range(idx), preds[j]))
+                NOT_CONSISTENT("unit has invalid predeccessor dep (dep is not attached to source)");
+        }
+        for(size_t j = 0; j < succs.size(); j++)
+        {
+            // dependency must come from the unit !
+            if(succs[j].from() != unit)
+                NOT_CONSISTENT("unit has invalid successor dep (it is not the source !)");
+            // dependency must go somewhere
+            if(!m_index.find(succs[j].to(), idx))
+                NOT_CONSISTENT("unit has invalid successor dep (target does not exist !)");
+            // dependency must be attached to the target
+            if(!container_contains(m_preds.range(idx), succs[j]))
+                NOT_CONSISTENT("unit has invalid successor dep (dep is not attached to target)");
+        }
+        nb_deps += preds.size();
+
+        // check root and leaves
+        if(preds.size() == 0)
+        {
+            nb_roots++;
+            if(!container_contains(m_roots, unit))
+                NOT_CONSISTENT("root unit in master list is not in roots list");
+        }
+        if(succs.size() == 0)
+        {
+            nb_leaves++;
+            if(!container_contains(m_leaves, unit))
+                NOT_CONSISTENT("leaf unit in master list is not in leaves list");
+        }
+    }
+    if(nb_roots != m_roots.size())
+        NOT_CONSISTENT("roots list has duplicates");
+    if(nb_leaves != m_leaves.size())
+        NOT_CONSISTENT("leaves list has duplicates");
+    // check dep
+    if(nb_deps != m_deps.size())
+        NOT_CONSISTENT("master dep list and unit dep lists have different sizes");
+    for(size_t i = 0; i < m_deps.size(); i++)
+    {
+        const schedule_dep& dep = m_deps[i];
+        size_t from, to;
+
+        if(!m_index.find(dep.from(), from) || !container_contains(m_succs.range(from), dep))
+            NOT_CONSISTENT("dep in master list is not attached to source");
+        if(!m_index.find(dep.to(), to) || !container_contains(m_preds.range(to), dep))
+            NOT_CONSISTENT("dep in master list is not attached to target");
+    }
+    // check loops with a topological sort
+    std::vector< size_t > pred_count(n);
+    std::vector< size_t > stack;
+    for(size_t u = 0; u < n; u++)
+    {
+        pred_count[u] = m_preds.segs[u].size;
+        if(pred_count[u] == 0)
+            stack.push_back(u);
+    }
+    size_t nb_sorted = 0;
+    while(!stack.empty())
+    {
+        size_t u = stack.back();
+        stack.pop_back();
+        nb_sorted++;
+        schedule_dep_range succs = m_succs.range(u);
+        for(size_t i = 0; i < succs.size(); i++)
+        {
+            size_t to;
+            m_index.find(succs[i].to(), to);
+            if(--pred_count[to] == 0)
+                stack.push_back(to);
+        }
+    }
+    if(nb_sorted != n)
+        NOT_CONSISTENT("loop in DAG");
+    #undef NOT_CONSISTENT
+
+    return true;
+}
+
+void compact_schedule_dag::clear()
+{
+    m_units.clear();
+    m_leaves.clear();
+    m_roots.clear();
+    m_deps.clear();
+    m_preds = dep_pool();
+    m_succs = dep_pool();
+    m_root_pos.clear();
+    m_leaf_pos.clear();
+    m_ends_dirty = false;
+    m_index.clear();
+    notify_cleared();
+    end_change("clear");
+}
+
+}
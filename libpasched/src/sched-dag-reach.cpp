@@ -0,0 +1,189 @@
+#include "sched-dag.hpp"
+#include <stdexcept>
+#include <cassert>
+#include <algorithm>
+
+namespace PAMAURY_SCHEDULER_NS
+{
+
+/**
+ * Reachability index
+ */
+reachability_index::reachability_index(const schedule_dag& dag)
+    :m_dag(dag), m_attached(true), m_valid(false)
+{
+    assert(dag.m_reach_index == 0 && "DAG already has a reachability index");
+    dag.add_listener(this);
+    dag.m_reach_index = this;
+}
+
+reachability_index::~reachability_index()
+{
+    detach();
+}
+
+void reachability_index::detach()
+{
+    if(!m_attached)
+        return;
+    m_dag.remove_listener(this);
+    m_dag.m_reach_index = 0;
+    m_attached = false;
+    /* the graph might change from now on */
+    m_valid = false;
+}
+
+bool reachability_index::is_reachable(const schedule_unit *a, const schedule_unit *b) const
+{
+    if(!m_valid)
+        rebuild();
+    return m_path.test_bit(slot_of(a), slot_of(b));
+}
+
+void reachability_index::invalidate()
+{
+    m_valid = false;
+}
+
+void reachability_index::rebuild() const
+{
+    m_dag.build_path_map(m_path);
+    m_units = m_dag.get_units();
+    m_slot.clear();
+    for(size_t u = 0; u < m_units.size(); u++)
+        m_slot.set(m_units[u], u);
+    m_valid = true;
+}
+
+size_t reachability_index::slot_of(const schedule_unit *unit) const
+{
+    size_t slot;
+    if(!m_slot.find(unit, slot))
+        throw std::runtime_error("reachability_index: unit is not in the graph");
+    return slot;
+}
+
+void reachability_index::add_slot(const schedule_unit *unit)
+{
+    size_t n = m_units.size();
+    /* make room by doubling the matrix */
+    if(n == m_path.nb_rows())
+    {
+        bit_matrix path(std::max((size_t)16, 2 * n), std::max((size_t)16, 2 * n));
+        for(size_t r = 0; r < n; r++)
+            std::copy(m_path.row(r), m_path.row(r) + m_path.chunks_per_row(), path.row(r));
+        m_path.swap(path);
+    }
+    m_units.push_back(unit);
+    m_slot.set(unit, n);
+    m_path.set_bit(n, n);
+}
+
+void reachability_index::remove_slot(const schedule_unit *unit)
+{
+    size_t slot = slot_of(unit);
+    size_t last = m_units.size() - 1;
+    size_t cpr = m_path.chunks_per_row();
+    /* the last slot takes the free one, row then column */
+    if(slot != last)
+    {
+        std::copy(m_path.row(last), m_path.row(last) + cpr, m_path.row(slot));
+        for(size_t r = 0; r < last; r++)
+        {
+            if(m_path.test_bit(r, last))
+                m_path.set_bit(r, slot);
+            else
+                m_path.clear_bit(r, slot);
+        }
+        m_units[slot] = m_units[last];
+        m_slot.set(m_units[slot], slot);
+    }
+    for(size_t r = 0; r < last; r++)
+        m_path.clear_bit(r, last);
+    std::fill(m_path.row(last), m_path.row(last) + cpr, 0);
+    m_units.pop_back();
+    m_slot.erase(unit);
+}
+
+void reachability_index::add_paths(size_t a, size_t b)
+{
+    if(m_path.test_bit(a, b))
+        return;
+    size_t n = m_units.size();
+    size_t nb_chunks = (n + bit_matrix::BITS_PER_CHUNKS - 1) / bit_matrix::BITS_PER_CHUNKS;
+    for(size_t x = 0; x < n; x++)
+        if(m_path.test_bit(x, a))
+            combine_chunks< bit_or_op >(m_path.row(x), m_path.row(b), nb_chunks);
+}
+
+void reachability_index::unit_added(const schedule_dag& dag, const schedule_unit *unit)
+{
+    (void) dag;
+    if(m_valid)
+        add_slot(unit);
+}
+
+void reachability_index::unit_removed(const schedule_dag& dag, const schedule_unit *unit)
+{
+    if(!m_valid)
+        return;
+    /* no path goes through a root or a leaf */
+    if(dag.get_preds(unit).empty() || dag.get_succs(unit).empty())
+        remove_slot(unit);
+    else
+        invalidate();
+}
+
+void reachability_index::dependency_added(const schedule_dag& dag, const schedule_dep& dep)
+{
+    (void) dag;
+    if(m_valid)
+        add_paths(slot_of(dep.from()), slot_of(dep.to()));
+}
+
+void reachability_index::dependency_removed(const schedule_dag& dag, const schedule_dep& dep)
+{
+    if(!m_valid)
+        return;
+    /* if another successor S of A still reaches B, nothing changed: the
+     * path from S to B cannot use the removed A->B dependency because the
+     * graph is acyclic */
+    size_t to = slot_of(dep.to());
+    schedule_dep_range succs = dag.get_succs(dep.from());
+    for(size_t i = 0; i < succs.size(); i++)
+        if(m_path.test_bit(slot_of(succs[i].to()), to))
+            return;
+    invalidate();
+}
+
+void reachability_index::units_fused(const schedule_dag& dag, const schedule_unit *a,
+        const schedule_unit *b, const schedule_unit *c)
+{
+    (void) dag;
+    if(!m_valid)
+        return;
+    /* every path through A or B now goes through C, so no path is cut but
+     * whatever reaches B now reaches what A reaches */
+    add_slot(c);
+    size_t sa = slot_of(a);
+    size_t sb = slot_of(b);
+    size_t sc = slot_of(c);
+    size_t n = m_units.size();
+    size_t nb_chunks = (n + bit_matrix::BITS_PER_CHUNKS - 1) / bit_matrix::BITS_PER_CHUNKS;
+
+    combine_chunks< bit_or_op >(m_path.row(sc), m_path.row(sa), nb_chunks);
+    combine_chunks< bit_or_op >(m_path.row(sc), m_path.row(sb), nb_chunks);
+    for(size_t x = 0; x < n; x++)
+        if(x != sc && (m_path.test_bit(x, sa) || m_path.test_bit(x, sb)))
+            combine_chunks< bit_or_op >(m_path.row(x), m_path.row(sc), nb_chunks);
+    remove_slot(a);
+    remove_slot(b);
+}
+
+void reachability_index::cleared(const schedule_dag& dag)
+{
+    (void) dag;
+    invalidate();
+}
+
+}
@@ -0,0 +1,236 @@
+#include "sched-dag.hpp"
+#include <stdexcept>
+#include <cassert>
+#include <algorithm>
+
+namespace PAMAURY_SCHEDULER_NS
+{
+
+/**
+ * Subgraph view
+ */
+subgraph_schedule_dag::subgraph_schedule_dag(const schedule_dag& parent,
+        const std::set< const schedule_unit * >& units)
+    :m_parent(parent), m_has_deps(false), m_own(0)
+{
+    /* keep the order of the parent */
+    std::vector< std::pair< size_t, const schedule_unit * > > order;
+    order.reserve(units.size());
+    std::set< const schedule_unit * >::const_iterator it;
+    for(it = units.begin(); it != units.end(); ++it)
+        order.push_back(std::make_pair(parent.index_of(*it), *it));
+    std::sort(order.begin(), order.end());
+    for(size_t i = 0; i < order.size(); i++)
+    {
+        m_index.set(order[i].second, m_units.size());
+        m_units.push_back(order[i].second);
+    }
+    m_data.resize(m_units.size());
+
+    /* only units on the boundary need filtered lists */
+    for(size_t u = 0; u < m_units.size(); u++)
+    {
+        const schedule_unit *unit = m_units[u];
+        su_data& d = m_data[u];
+        schedule_dep_range preds = parent.get_preds(unit);
+        schedule_dep_range succs = parent.get_succs(unit);
+        size_t idx;
+
+        for(size_t i = 0; i < preds.size(); i++)
+            if(!m_index.find(preds[i].from(), idx))
+            {
+                d.all_preds = false;
+                break;
+            }
+        if(!d.all_preds)
+        {
+            for(size_t i = 0; i < preds.size(); i++)
+                if(m_index.find(preds[i].from(), idx))
+                    d.preds.push_back(preds[i]);
+        }
+        for(size_t i = 0; i < succs.size(); i++)
+            if(!m_index.find(succs[i].to(), idx))
+            {
+                d.all_succs = false;
+                break;
+            }
+        if(!d.all_succs)
+        {
+            for(size_t i = 0; i < succs.size(); i++)
+                if(m_index.find(succs[i].to(), idx))
+                    d.succs.push_back(succs[i]);
+        }
+
+        if(get_preds(unit).size() == 0)
+            m_roots.push_back(unit);
+        if(get_succs(unit).size() == 0)
+            m_leaves.push_back(unit);
+    }
+
+    set_modified(false);
+}
+
+subgraph_schedule_dag::~subgraph_schedule_dag()
+{
+    delete m_own;
+}
+
+schedule_dag *subgraph_schedule_dag::dup() const
+{
+    if(m_own)
+        return m_own->dup();
+    compact_schedule_dag *cpy = new compact_schedule_dag(*this);
+    cpy->set_modified(m_modified);
+    return cpy;
+}
+
+void subgraph_schedule_dag::materialise()
+{
+    if(m_own)
+        return;
+    m_own = new compact_schedule_dag(*this);
+    m_own->set_modified(m_modified);
+    /* keep the batch going on the copy */
+    if(in_batch())
+        m_own->begin_batch();
+}
+
+void subgraph_schedule_dag::end_batch()
+{
+    if(m_own && m_own->in_batch())
+        m_own->commit();
+}
+
+const std::vector< const schedule_unit *>& subgraph_schedule_dag::get_roots() const
+{
+    return m_own ? m_own->get_roots() : m_roots;
+}
+
+const std::vector< const schedule_unit *>& subgraph_schedule_dag::get_leaves() const
+{
+    return m_own ? m_own->get_leaves() : m_leaves;
+}
+
+const std::vector< const schedule_unit *>& subgraph_schedule_dag::get_units() const
+{
+    return m_own ? m_own->get_units() : m_units;
+}
+
+schedule_dep_range subgraph_schedule_dag::get_succs(const schedule_unit *su) const
+{
+    if(m_own)
+        return m_own->get_succs(su);
+    size_t idx;
+    if(!m_index.find(su, idx))
+        return schedule_dep_range();
+    if(m_data[idx].all_succs)
+        return m_parent.get_succs(su);
+    return m_data[idx].succs;
+}
+
+schedule_dep_range subgraph_schedule_dag::get_preds(const schedule_unit *su) const
+{
+    if(m_own)
+        return m_own->get_preds(su);
+    size_t idx;
+    if(!m_index.find(su, idx))
+        return schedule_dep_range();
+    if(m_data[idx].all_preds)
+        return m_parent.get_preds(su);
+    return m_data[idx].preds;
+}
+
+const std::vector< schedule_dep >& subgraph_schedule_dag::get_deps() const
+{
+    if(m_own)
+        return m_own->get_deps();
+    if(!m_has_deps)
+    {
+        for(size_t u = 0; u < m_units.size(); u++)
+        {
+            schedule_dep_range succs = get_succs(m_units[u]);
+            m_deps.insert(m_deps.end(), succs.begin(), succs.end());
+        }
+        m_has_deps = true;
+    }
+    return m_deps;
+}
+
+size_t subgraph_schedule_dag::index_of(const schedule_unit *unit) const
+{
+    if(m_own)
+        return m_own->index_of(unit);
+    size_t idx;
+    if(!m_index.find(unit, idx))
+        throw std::runtime_error("subgraph_schedule_dag::index_of: unit is not in the graph");
+    return idx;
+}
+
+bool subgraph_schedule_dag::modified() const
+{
+    return m_own ? m_own->modified() : m_modified;
+}
+
+void subgraph_schedule_dag::set_modified(bool mod)
+{
+    m_modified = mod;
+    if(m_own)
+        m_own->set_modified(mod);
+}
+
+void subgraph_schedule_dag::add_dependency(schedule_dep d)
+{
+    materialise();
+    m_own->add_dependency(d);
+    notify_dependency_added(d);
+}
+
+void subgraph_schedule_dag::remove_dependency(schedule_dep d)
+{
+    materialise();
+    size_t count = m_own->get_deps().size();
+    m_own->remove_dependency(d);
+    if(m_own->get_deps().size() != count)
+        notify_dependency_removed(d);
+}
+
+void subgraph_schedule_dag::add_unit(const schedule_unit *unit)
+{
+    materialise();
+    m_own->add_unit(unit);
+    notify_unit_added(unit);
+}
+
+void subgraph_schedule_dag::remove_unit(const schedule_unit *unit)
+{
+    notify_unit_removed(unit);
+    materialise();
+    m_own->remove_unit(unit);
+}
+
+void subgraph_schedule_dag::modify_dep(const schedule_dep& _old, const schedule_dep& _cur)
+{
+    /* make copies, the arguments might be references to the view */
+    schedule_dep old = _old;
+    schedule_dep cur = _cur;
+    materialise();
+    m_own->modify_dep(old, cur);
+    notify_dependency_modified(cur);
+}
+
+bool subgraph_schedule_dag::is_consistent(std::string *out_msg) const
+{
+    if(m_own)
+        return m_own->is_consistent(out_msg);
+    /* a view of a consistent graph is consistent */
+    return m_parent.is_consistent(out_msg);
+}
+
+void subgraph_schedule_dag::clear()
+{
+    materialise();
+    m_own->clear();
+    notify_cleared();
+}
+
+}
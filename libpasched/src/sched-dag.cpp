@@ -7,6 +7,11 @@
 #include <queue>
 #include <iostream>
 #include <cassert>
+#include <algorithm>
+#ifdef ENABLE_THREADS
+#include <pthread.h>
+#include <unistd.h>
+#endif
 
 #ifdef ENABLE_DAG_AUTO_CHECK_CONSISTENCY
 #define AUTO_CHECK_CONSISTENCY
@@ -15,17 +20,150 @@
 namespace PAMAURY_SCHEDULER_NS
 {
 
+/**
+ * Traversal workspace
+ */
+traversal_scratch::traversal_scratch()
+    :m_epoch(0)
+{
+}
+
+void traversal_scratch::begin(size_t nb_units)
+{
+    if(m_stamp.size() < nb_units)
+        m_stamp.resize(nb_units, 0);
+    /* on wrap around, old stamps could match the new epochs */
+    if(++m_epoch == 0)
+    {
+        std::fill(m_stamp.begin(), m_stamp.end(), 0);
+        m_epoch = 1;
+    }
+}
+
 /**
  * Interface Implementation
  */
 schedule_dag::schedule_dag()
+    :m_batch_depth(0), m_batch_changed(false), m_batch_modified(false),
+    m_notify_hold(0), m_reach_index(0)
 {
 }
 
+schedule_dag::schedule_dag(const schedule_dag& dag)
+    :m_batch_depth(0), m_batch_changed(false), m_batch_modified(false),
+    m_notify_hold(0), m_reach_index(0)
+{
+    /* a copy is never in a batch and has no listener */
+    (void) dag;
+}
+
 schedule_dag::~schedule_dag()
 {
 }
 
+void schedule_dag::begin_batch()
+{
+    m_batch_depth++;
+}
+
+void schedule_dag::commit()
+{
+    assert(m_batch_depth > 0 && "commit() without begin_batch()");
+    if(--m_batch_depth != 0)
+        return;
+    end_batch();
+    if(m_batch_changed)
+    {
+        m_batch_changed = false;
+        end_change("batch", m_batch_modified);
+        m_batch_modified = false;
+    }
+}
+
+void schedule_dag::end_batch()
+{
+}
+
+void schedule_dag::add_listener(schedule_dag_listener *l) const
+{
+    m_listeners.push_back(l);
+}
+
+void schedule_dag::remove_listener(schedule_dag_listener *l) const
+{
+    std::vector< schedule_dag_listener * >::iterator it =
+        std::find(m_listeners.begin(), m_listeners.end(), l);
+    assert(it != m_listeners.end() && "listener is not registered");
+    m_listeners.erase(it);
+}
+
+void schedule_dag::notify_unit_added(const schedule_unit *unit)
+{
+    if(!m_reg_info.empty())
+        m_reg_info.push_back(reg_info_entry());
+    if(m_notify_hold == 0)
+        for(size_t i = 0; i < m_listeners.size(); i++)
+            m_listeners[i]->unit_added(*this, unit);
+}
+
+void schedule_dag::notify_unit_removed(const schedule_unit *unit)
+{
+    reg_info_unit_removed(unit);
+    if(m_notify_hold == 0)
+        for(size_t i = 0; i < m_listeners.size(); i++)
+            m_listeners[i]->unit_removed(*this, unit);
+}
+
+void schedule_dag::notify_dependency_added(const schedule_dep& dep)
+{
+    reg_info_dependency_changed(dep);
+    if(m_notify_hold == 0)
+        for(size_t i = 0; i < m_listeners.size(); i++)
+            m_listeners[i]->dependency_added(*this, dep);
+}
+
+void schedule_dag::notify_dependency_removed(const schedule_dep& dep)
+{
+    reg_info_dependency_changed(dep);
+    if(m_notify_hold == 0)
+        for(size_t i = 0; i < m_listeners.size(); i++)
+            m_listeners[i]->dependency_removed(*this, dep);
+}
+
+void schedule_dag::notify_dependency_modified(const schedule_dep& dep)
+{
+    /* listeners only care about paths, which did not change */
+    reg_info_dependency_changed(dep);
+}
+
+void schedule_dag::notify_cleared()
+{
+    m_reg_info.clear();
+    if(m_notify_hold == 0)
+        for(size_t i = 0; i < m_listeners.size(); i++)
+            m_listeners[i]->cleared(*this);
+}
+
+void schedule_dag::end_change(const char *what, bool modified)
+{
+    if(in_batch())
+    {
+        m_batch_changed = true;
+        m_batch_modified = m_batch_modified || modified;
+        return;
+    }
+    if(modified)
+        set_modified(true);
+
+    #ifdef AUTO_CHECK_CONSISTENCY
+    std::string s;
+    if(!is_consistent(&s))
+        throw std::runtime_error(std::string("DAG is not consistent after ") + what + " (" + s + ")");
+    #else
+    (void) what;
+    #endif
+}
+
 schedule_dag *schedule_dag::deep_dup() const
 {
     /* poor's man deep_dup */
@@ -55,24 +193,28 @@ schedule_dag *schedule_dag::deep_dup() const
 
 void schedule_dag::add_dependencies(const std::vector< schedule_dep >& deps)
 {
+    schedule_dag_batch batch(*this);
     for(size_t i = 0; i < deps.size(); i++)
         add_dependency(deps[i]);
 }
 
 void schedule_dag::remove_dependencies(const std::vector< schedule_dep >& deps)
 {
+    schedule_dag_batch batch(*this);
     for(size_t i = 0; i < deps.size(); i++)
         remove_dependency(deps[i]);
 }
 
 void schedule_dag::add_units(const std::vector< const schedule_unit * >& units)
 {
+    schedule_dag_batch batch(*this);
     for(size_t i = 0; i < units.size(); i++)
         add_unit(units[i]);
 }
 
 void schedule_dag::remove_units(const std::vector< const schedule_unit * >& units)
 {
+    schedule_dag_batch batch(*this);
     for(size_t i = 0; i < units.size(); i++)
         remove_unit(units[i]);
 }
@@ -131,16 +273,237 @@ std::set< const schedule_unit * > schedule_dag::get_reachable(const schedule_uni
     return s;
 }
 
+namespace
+{
+    struct append_visitor : public schedule_unit_visitor
+    {
+        append_visitor(std::vector< const schedule_unit * >& out):out(out) {}
+
+        virtual void visit(const schedule_unit *unit)
+        {
+            out.push_back(unit);
+        }
+
+        std::vector< const schedule_unit * >& out;
+    };
+}
+
+void schedule_dag::visit_reachable(const schedule_unit *unit, unsigned flags,
+    traversal_scratch& scratch, schedule_unit_visitor& v) const
+{
+    std::vector< const schedule_unit * >& q = scratch.m_queue;
+
+    scratch.begin(get_units().size());
+    q.clear();
+    q.push_back(unit);
+    scratch.visit(index_of(unit));
+    if(flags & rf_include_unit)
+        v.visit(unit);
+
+    for(size_t head = 0; head < q.size(); head++)
+    {
+        const schedule_unit *u = q[head];
+        /* stop here if user asked for immediate neighbourhood */
+        if((flags & rf_immediate) && u != unit)
+            break;
+
+        schedule_dep_range preds = get_preds(u);
+        for(size_t i = 0; i < preds.size(); i++)
+        {
+            const schedule_dep& d = preds[i];
+            if(!(d.is_data() && (flags & rf_follow_preds_data)) &&
+                    !(d.is_order() && (flags & rf_follow_preds_order)))
+                continue;
+            if(!scratch.visit(index_of(d.from())))
+                continue;
+            q.push_back(d.from());
+            v.visit(d.from());
+        }
+
+        schedule_dep_range succs = get_succs(u);
+        for(size_t i = 0; i < succs.size(); i++)
+        {
+            const schedule_dep& d = succs[i];
+            if(!(d.is_data() && (flags & rf_follow_succs_data)) &&
+                    !(d.is_order() && (flags & rf_follow_succs_order)))
+                continue;
+            if(!scratch.visit(index_of(d.to())))
+                continue;
+            q.push_back(d.to());
+            v.visit(d.to());
+        }
+    }
+}
+
+void schedule_dag::get_reachable(const schedule_unit *unit, unsigned flags,
+    traversal_scratch& scratch, std::vector< const schedule_unit * >& out) const
+{
+    append_visitor v(out);
+    visit_reachable(unit, flags, scratch, v);
+}
+
+size_t schedule_dag::count_distinct_preds(const schedule_unit *unit, unsigned flags) const
+{
+    schedule_dep_range preds = get_preds(unit);
+    size_t count = 0;
+
+    m_count_scratch.begin(get_units().size());
+    for(size_t i = 0; i < preds.size(); i++)
+    {
+        const schedule_dep& d = preds[i];
+        if(!(d.is_data() && (flags & rf_follow_preds_data)) &&
+                !(d.is_order() && (flags & rf_follow_preds_order)))
+            continue;
+        if(m_count_scratch.visit(index_of(d.from())))
+            count++;
+    }
+    return count;
+}
+
+size_t schedule_dag::count_distinct_succs(const schedule_unit *unit, unsigned flags) const
+{
+    schedule_dep_range succs = get_succs(unit);
+    size_t count = 0;
+
+    m_count_scratch.begin(get_units().size());
+    for(size_t i = 0; i < succs.size(); i++)
+    {
+        const schedule_dep& d = succs[i];
+        if(!(d.is_data() && (flags & rf_follow_succs_data)) &&
+                !(d.is_order() && (flags & rf_follow_succs_order)))
+            continue;
+        if(m_count_scratch.visit(index_of(d.to())))
+            count++;
+    }
+    return count;
+}
+
+const schedule_dag::reg_info& schedule_dag::get_reg_info(const schedule_unit *unit) const
+{
+    if(m_reg_info.size() < get_units().size())
+        m_reg_info.resize(get_units().size());
+    reg_info_entry& e = m_reg_info[index_of(unit)];
+    reg_info& ri = e.info;
+
+    if(!e.def_use_valid)
+    {
+        ri.phys_create.clear();
+        ri.virt_create.clear();
+        ri.phys_use.clear();
+        ri.virt_use.clear();
+
+        schedule_dep_range succs = get_succs(unit);
+        for(size_t i = 0; i < succs.size(); i++)
+            if(succs[i].is_virt())
+                ri.virt_create.push_back(succs[i].reg());
+            else if(succs[i].is_phys())
+                ri.phys_create.push_back(succs[i].reg());
+        schedule_dep_range preds = get_preds(unit);
+        for(size_t i = 0; i < preds.size(); i++)
+            if(preds[i].is_virt())
+                ri.virt_use.push_back(preds[i].reg());
+            else if(preds[i].is_phys())
+                ri.phys_use.push_back(preds[i].reg());
+
+        sort_unique(ri.phys_create);
+        sort_unique(ri.virt_create);
+        sort_unique(ri.phys_use);
+        sort_unique(ri.virt_use);
+        ri.create = set_union(ri.phys_create, ri.virt_create);
+        ri.use = set_union(ri.phys_use, ri.virt_use);
+        e.def_use_valid = true;
+    }
+
+    if(!e.destroy_valid)
+    {
+        ri.destroy.clear();
+
+        schedule_dep_range preds = get_preds(unit);
+        for(size_t i = 0; i < preds.size(); i++)
+        {
+            const schedule_dep& dep = preds[i];
+            if(!dep.is_data())
+                continue;
+            schedule_dep_range sec_succs = get_succs(dep.from());
+            for(size_t j = 0; j < sec_succs.size(); j++)
+            {
+                const schedule_dep& sec_dep = sec_succs[j];
+                if(sec_dep.is_data() &&
+                        sec_dep.reg() == dep.reg() &&
+                        sec_dep.to() != unit)
+                    goto Lnot_destroy;
+            }
+            ri.destroy.push_back(dep.reg());
+
+            Lnot_destroy:
+            continue;
+        }
+
+        sort_unique(ri.destroy);
+        e.destroy_valid = true;
+    }
+
+    return ri;
+}
+
+void schedule_dag::reg_info_invalidate(const schedule_unit *unit, bool def_use) const
+{
+    reg_info_entry& e = m_reg_info[index_of(unit)];
+    if(def_use)
+        e.def_use_valid = false;
+    e.destroy_valid = false;
+}
+
+void schedule_dag::reg_info_invalidate_users(const schedule_unit *unit) const
+{
+    /* the registers destroyed by a unit depend on the other uses of them */
+    schedule_dep_range succs = get_succs(unit);
+    for(size_t i = 0; i < succs.size(); i++)
+        reg_info_invalidate(succs[i].to(), false);
+}
+
+void schedule_dag::reg_info_dependency_changed(const schedule_dep& dep) const
+{
+    if(m_reg_info.empty())
+        return;
+    reg_info_invalidate(dep.from(), true);
+    reg_info_invalidate(dep.to(), true);
+    reg_info_invalidate_users(dep.from());
+}
+
+void schedule_dag::reg_info_unit_removed(const schedule_unit *unit) const
+{
+    if(m_reg_info.empty())
+        return;
+    schedule_dep_range preds = get_preds(unit);
+    for(size_t i = 0; i < preds.size(); i++)
+    {
+        reg_info_invalidate(preds[i].from(), true);
+        reg_info_invalidate_users(preds[i].from());
+    }
+    schedule_dep_range succs = get_succs(unit);
+    for(size_t i = 0; i < succs.size(); i++)
+        reg_info_invalidate(succs[i].to(), true);
+
+    /* the last unit takes the free index */
+    size_t idx = index_of(unit);
+    if(idx + 1 != m_reg_info.size())
+        m_reg_info[idx].swap(m_reg_info.back());
+    m_reg_info.pop_back();
+}
+
 std::set< schedule_dep::reg_t > schedule_dag::get_reg_create(
     const schedule_unit *unit, bool pick_virt, bool pick_phys) const
 {
-    std::set< schedule_dep::reg_t > s;
-    for(size_t i = 0; i < get_succs(unit).size(); i++)
-        if(get_succs(unit)[i].is_virt() && pick_virt)
-            s.insert(get_succs(unit)[i].reg());
-        else if(get_succs(unit)[i].is_phys() && pick_phys)
-            s.insert(get_succs(unit)[i].reg());
-    return s;
+    const reg_info& ri = get_reg_info(unit);
+    if(pick_virt && pick_phys)
+        return std::set< schedule_dep::reg_t >(ri.create.begin(), ri.create.end());
+    else if(pick_virt)
+        return std::set< schedule_dep::reg_t >(ri.virt_create.begin(), ri.virt_create.end());
+    else if(pick_phys)
+        return std::set< schedule_dep::reg_t >(ri.phys_create.begin(), ri.phys_create.end());
+    else
+        return std::set< schedule_dep::reg_t >();
 }
 
 std::set< schedule_dep::reg_t > schedule_dag::get_reg_phys_create(
@@ -158,13 +521,15 @@ std::set< schedule_dep::reg_t > schedule_dag::get_reg_virt_create(
 std::set< schedule_dep::reg_t > schedule_dag::get_reg_use(
     const schedule_unit *unit, bool pick_virt, bool pick_phys) const
 {
-    std::set< schedule_dep::reg_t > s;
-    for(size_t i = 0; i < get_preds(unit).size(); i++)
-        if(get_preds(unit)[i].is_phys() && pick_phys)
-            s.insert(get_preds(unit)[i].reg());
-        else if(get_preds(unit)[i].is_virt() && pick_virt)
-            s.insert(get_preds(unit)[i].reg());
-    return s;
+    const reg_info& ri = get_reg_info(unit);
+    if(pick_virt && pick_phys)
+        return std::set< schedule_dep::reg_t >(ri.use.begin(), ri.use.end());
+    else if(pick_virt)
+        return std::set< schedule_dep::reg_t >(ri.virt_use.begin(), ri.virt_use.end());
+    else if(pick_phys)
+        return std::set< schedule_dep::reg_t >(ri.phys_use.begin(), ri.phys_use.end());
+    else
+        return std::set< schedule_dep::reg_t >();
 }
 
 std::set< schedule_dep::reg_t > schedule_dag::get_reg_phys_use(
@@ -182,50 +547,32 @@ std::set< schedule_dep::reg_t > schedule_dag::get_reg_virt_use(
 std::set< schedule_dep::reg_t > schedule_dag::get_reg_destroy(
     const schedule_unit *unit) const
 {
-    std::set< schedule_dep::reg_t > s;
-    for(size_t i = 0; i < get_preds(unit).size(); i++)
-    {
-        const schedule_dep& dep = get_preds(unit)[i];
-        if(!dep.is_data())
-            continue;
-        for(size_t j = 0; j < get_succs(dep.from()).size(); j++)
-        {
-            const schedule_dep& sec_dep = get_succs(dep.from())[j];
-            if(sec_dep.is_data() &&
-                    sec_dep.reg() == dep.reg() &&
-                    sec_dep.to() != unit)
-                goto Lnot_destroy;
-        }
-        s.insert(dep.reg());
-
-        Lnot_destroy:
-        continue;
-    }
-    return s;
+    const reg_info& ri = get_reg_info(unit);
+    return std::set< schedule_dep::reg_t >(ri.destroy.begin(), ri.destroy.end());
 }
 
 MTM_STAT(TM_DECLARE(schedule_dag__get_reg_destroy_exact, "mtm-get_reg_destroy_exact"))
 
-std::set< schedule_dep::reg_t > schedule_dag::get_reg_destroy_exact(
-    const schedule_unit *unit) const
+void schedule_dag::get_reg_destroy_exact(const schedule_unit *unit, reg_list& out) const
 {
     MTM_STAT(TM_START(schedule_dag__get_reg_destroy_exact))
-    std::set< schedule_dep::reg_t > s;
+    out.clear();
     /* compute backward reachable set of unit U */
-    std::set< const schedule_unit * > lazy_set;
     bool has_lazy_set = false;
     
     /* For each predecessor P of U */
-    for(size_t i = 0; i < get_preds(unit).size(); i++)
+    schedule_dep_range preds = get_preds(unit);
+    for(size_t i = 0; i < preds.size(); i++)
     {
-        const schedule_dep& dep = get_preds(unit)[i];
+        const schedule_dep& dep = preds[i];
         /* skip dep of it's not a data one */
         if(!dep.is_data())
             continue;
         /* For each successor S of P */
-        for(size_t j = 0; j < get_succs(dep.from()).size(); j++)
+        schedule_dep_range sec_succs = get_succs(dep.from());
+        for(size_t j = 0; j < sec_succs.size(); j++)
         {
-            const schedule_dep& sec_dep = get_succs(dep.from())[j];
+            const schedule_dep& sec_dep = sec_succs[j];
             /* if the P->S link uses the same register as P->U and P<>U
              * then the register has another use, so we need a complete
              * analysis */
@@ -233,48 +580,64 @@ std::set< schedule_dep::reg_t > schedule_dag::get_reg_destroy_exact(
                     sec_dep.reg() == dep.reg() &&
                     sec_dep.to() != unit)
             {
-                if(!has_lazy_set)
+                bool reach;
+                if(m_reach_index)
+                    reach = m_reach_index->is_reachable(sec_dep.to(), unit);
+                else
                 {
-                    lazy_set = get_reachable(unit, rf_follow_preds);
-                    has_lazy_set = true;
+                    if(!has_lazy_set)
+                    {
+                        m_reach_units.clear();
+                        get_reachable(unit, rf_follow_preds, m_reach_scratch, m_reach_units);
+                        has_lazy_set = true;
+                    }
+                    reach = m_reach_scratch.visited(index_of(sec_dep.to()));
                 }
                 /* if S is in, then it's ok, otherwise, we can't be sure
                  * that U destroys the register */
-                if(lazy_set.find(sec_dep.to()) == lazy_set.end())
+                if(!reach)
                     goto Lnot_destroy;
             }
         }
-        s.insert(dep.reg());
+        out.push_back(dep.reg());
 
         Lnot_destroy:
         continue;
     }
+    sort_unique(out);
     MTM_STAT(TM_STOP(schedule_dag__get_reg_destroy_exact))
-    return s;
+}
+
+std::set< schedule_dep::reg_t > schedule_dag::get_reg_destroy_exact(
+    const schedule_unit *unit) const
+{
+    reg_list l;
+    get_reg_destroy_exact(unit, l);
+    return std::set< schedule_dep::reg_t >(l.begin(), l.end());
 }
 
 MTM_STAT(TM_DECLARE(schedule_dag__get_reg_dont_destroy_exact, "mtm-get_reg_dont_destroy_exact"))
 
-std::set< schedule_dep::reg_t > schedule_dag::get_reg_dont_destroy_exact(
-    const schedule_unit *unit) const
+void schedule_dag::get_reg_dont_destroy_exact(const schedule_unit *unit, reg_list& out) const
 {
     MTM_STAT(TM_START(schedule_dag__get_reg_dont_destroy_exact))
-    std::set< schedule_dep::reg_t > s;
+    out.clear();
     /* compute reachable set of unit U */
-    std::set< const schedule_unit * > lazy_set;
     bool has_lazy_set = false;
     
     /* For each predecessor P of U */
-    for(size_t i = 0; i < get_preds(unit).size(); i++)
+    schedule_dep_range preds = get_preds(unit);
+    for(size_t i = 0; i < preds.size(); i++)
     {
-        const schedule_dep& dep = get_preds(unit)[i];
+        const schedule_dep& dep = preds[i];
         /* skip dep of it's not a data one */
         if(!dep.is_data())
             continue;
         /* For each successor S of P */
-        for(size_t j = 0; j < get_succs(dep.from()).size(); j++)
+        schedule_dep_range sec_succs = get_succs(dep.from());
+        for(size_t j = 0; j < sec_succs.size(); j++)
         {
-            const schedule_dep& sec_dep = get_succs(dep.from())[j];
+            const schedule_dep& sec_dep = sec_succs[j];
             /* if the P->S link uses the same register as P->U and P<>U
              * then the register has another use, so we need a complete
              * analysis */
@@ -282,14 +645,22 @@ std::set< schedule_dep::reg_t > schedule_dag::get_reg_dont_destroy_exact(
                     sec_dep.reg() == dep.reg() &&
                     sec_dep.to() != unit)
             {
-                if(!has_lazy_set)
+                bool reach;
+                if(m_reach_index)
+                    reach = m_reach_index->is_reachable(unit, sec_dep.to());
+                else
                 {
-                    lazy_set = get_reachable(unit, rf_follow_succs);
-                    has_lazy_set = true;
+                    if(!has_lazy_set)
+                    {
+                        m_reach_units.clear();
+                        get_reachable(unit, rf_follow_succs, m_reach_scratch, m_reach_units);
+                        has_lazy_set = true;
+                    }
+                    reach = m_reach_scratch.visited(index_of(sec_dep.to()));
                 }
                 /* if S is in reachable set of U, then the register is
                  * not destroyed by U because is used later on */
-                if(lazy_set.find(sec_dep.to()) != lazy_set.end())
+                if(reach)
                     goto Lnot_destroy;
             }
         }
@@ -298,11 +669,19 @@ std::set< schedule_dep::reg_t > schedule_dag::get_reg_dont_destroy_exact(
         continue;
 
         Lnot_destroy:
-        s.insert(dep.reg());
+        out.push_back(dep.reg());
         continue;
     }
+    sort_unique(out);
     MTM_STAT(TM_STOP(schedule_dag__get_reg_dont_destroy_exact))
-    return s;
+}
+
+std::set< schedule_dep::reg_t > schedule_dag::get_reg_dont_destroy_exact(
+    const schedule_unit *unit) const
+{
+    reg_list l;
+    get_reg_dont_destroy_exact(unit, l);
+    return std::set< schedule_dep::reg_t >(l.begin(), l.end());
 }
 
 MTM_STAT(TM_DECLARE(schedule_dag__fuse_units, "mtm-fuse_units"))
@@ -311,25 +690,31 @@ chain_schedule_unit *schedule_dag::fuse_units(const schedule_unit *a,
         const schedule_unit *b, bool simulate_if_approx, bool allow_unsafe_phys_dep_hiding)
 {
     MTM_STAT(TM_START(schedule_dag__fuse_units))
-    /* compute IRP */
-    std::set< schedule_dep::reg_t > vc = get_reg_create(a);
-    std::set< schedule_dep::reg_t > vu = get_reg_use(b);
-    std::set< schedule_dep::reg_t > vd = get_reg_destroy_exact(b);
-    std::set< schedule_dep::reg_t > vdd = get_reg_dont_destroy_exact(b);
-
-    std::set< schedule_dep::reg_t > vu_min_vc_min_vdd = set_minus(set_minus(vu, vc), vdd);
-    std::set< schedule_dep::reg_t > vu_plus__p_vc_min_vdd_p = set_union(vc, set_minus(vu, vdd));
-    std::set< schedule_dep::reg_t > vc_min_vd = set_minus(vc, vd);
+    /* compute IRP, the register information is only valid until the graph changes */
+    const reg_info& ria = get_reg_info(a);
+    const reg_info& rib = get_reg_info(b);
+    const reg_list& vc = ria.create;
+    const reg_list& vu = rib.use;
+    reg_list vd, vdd;
+    get_reg_destroy_exact(b, vd);
+    get_reg_dont_destroy_exact(b, vdd);
+
+    reg_list vu_min_vc_min_vdd = set_minus(set_minus(vu, vc), vdd);
+    reg_list vu_plus__p_vc_min_vdd_p = set_union(vc, set_minus(vu, vdd));
+    reg_list vc_min_vd = set_minus(vc, vd);
 
     /* Check for phys deps hiding */
     if(!allow_unsafe_phys_dep_hiding)
     {
         /* the A or B unit must not use any physical register */
-        if(!get_reg_phys_use(b).empty() ||
-                !get_reg_phys_use(a).empty() ||
-                !get_reg_phys_create(a).empty() ||
-                !get_reg_phys_create(b).empty())
+        if(!rib.phys_use.empty() ||
+                !ria.phys_use.empty() ||
+                !ria.phys_create.empty() ||
+                !rib.phys_create.empty())
+        {
+            MTM_STAT(TM_STOP(schedule_dag__fuse_units))
             return 0;
+        }
     }
 
     /**
@@ -376,7 +761,7 @@ chain_schedule_unit *schedule_dag::fuse_units(const schedule_unit *a,
          * If there is variable for which we are not sure if B destroy it
          * or not, then it's an overapproximation
          */
-        std::set< schedule_dep::reg_t > vu_min_vc_min_vdd_min_vd = set_minus(vu_min_vc_min_vdd, vd);
+        reg_list vu_min_vc_min_vdd_min_vd = set_minus(vu_min_vc_min_vdd, vd);
         if(vu_min_vc_min_vdd_min_vd.size() > 0)
         {
             /*
@@ -454,14 +839,23 @@ chain_schedule_unit *schedule_dag::fuse_units(const schedule_unit *a,
     #endif
 
 
-    /* change the graph */
-    add_unit(c);
-    remove_unit(a);
-    remove_unit(b);
-    add_dependencies(to_add);
-    
-    /* remove redundant data deps */
-    remove_redundant_data_dep_preds(c);
+    /* change the graph, listeners are told about the fusion as a whole
+     * because the individual changes look like paths being cut */
+    {
+        schedule_dag_batch batch(*this);
+        m_notify_hold++;
+        add_unit(c);
+        remove_unit(a);
+        remove_unit(b);
+        add_dependencies(to_add);
+        
+        /* remove redundant data deps */
+        remove_redundant_data_dep_preds(c);
+        m_notify_hold--;
+    }
+    if(m_notify_hold == 0)
+        for(size_t i = 0; i < m_listeners.size(); i++)
+            m_listeners[i]->units_fused(*this, a, b, c);
 
     MTM_STAT(TM_STOP(schedule_dag__fuse_units))
 
@@ -470,13 +864,8 @@ chain_schedule_unit *schedule_dag::fuse_units(const schedule_unit *a,
 
 schedule_dag *schedule_dag::dup_subgraph(const std::set< const schedule_unit * >& sub) const
 {
-    /* Do it the dirty and inefficient way: duplicate this DAG and remove the useless stuff */
-    schedule_dag *cpy = dup();
-
-    for(size_t u = 0; u < get_units().size(); u++)
-        if(sub.find(get_units()[u]) == sub.end())
-            cpy->remove_unit(get_units()[u]);
-    return cpy;
+    /* only copy the subgraph */
+    return subgraph_schedule_dag(*this, sub).dup();
 }
 
 
@@ -484,6 +873,7 @@ void schedule_dag::collapse_subgraph(const std::set< const schedule_unit * >& su
         const schedule_unit *new_unit)
 {
     std::vector< schedule_dep > to_add;
+    schedule_dag_batch batch(*this);
 
     for(size_t u = 0; u < get_units().size(); u++)
     {
@@ -607,67 +997,170 @@ void schedule_dag::remove_redundant_data_deps()
 
 namespace
 {
-    void compute_path_map(
-        const schedule_dag& dag,
-        std::vector< std::vector< bool > >& path,
-        std::map< const schedule_unit *, size_t >& name_map,
-        std::map< const schedule_unit *, bitmap >& reach,
-        const schedule_unit *unit)
+    /* Don't bother with threads below this number of units */
+    const size_t PATH_MAP_MIN_UNITS_PER_THREAD = 512;
+    /* Give each thread a multiple of a cache line of each row */
+    const size_t PATH_MAP_CHUNK_GRAIN = 8;
+
+    /* Part of the transitive closure: the column chunks [first,last) of
+     * every row, units being processed in reverse topological order */
+    struct path_map_job
     {
-        if(reach.find(unit) != reach.end())
-            return;
-        bitmap set(dag.get_units().size());
-        set.set_bit(name_map[unit]);
+        bit_matrix *path;
+        const std::vector< size_t > *order;
+        const std::vector< size_t > *succ_off;
+        const std::vector< size_t > *succ_idx;
+        size_t first, last;
+    };
+
+    void compute_path_map(path_map_job& job)
+    {
+        bit_matrix& path = *job.path;
+        const std::vector< size_t >& order = *job.order;
+        const std::vector< size_t >& succ_off = *job.succ_off;
+        const std::vector< size_t >& succ_idx = *job.succ_idx;
+        size_t n = job.last - job.first;
 
-        for(size_t i = 0; i < dag.get_succs(unit).size(); i++)
+        for(size_t k = 0; k < order.size(); k++)
         {
-            const schedule_unit *next = dag.get_succs(unit)[i].to();
-            compute_path_map(dag, path, name_map, reach, next);
-            
-            bitmap& rset = reach[next];
-            set |= rset;
+            size_t u = order[k];
+            bit_matrix::chunk_t *row = path.row(u) + job.first;
+            /* successors have already been processed */
+            for(size_t i = succ_off[u]; i < succ_off[u + 1]; i++)
+                combine_chunks< bit_or_op >(row, path.row(succ_idx[i]) + job.first, n);
         }
+    }
 
-        for(bitmap::const_bit_set_iterator it = set.bit_set_begin(); it != set.bit_set_end(); ++it)
-            path[name_map[unit]][*it] = true;
+#ifdef ENABLE_THREADS
+    void *compute_path_map_thread(void *job)
+    {
+        compute_path_map(*(path_map_job *)job);
+        return 0;
+    }
 
-        reach[unit] = set;
+    size_t nb_path_map_threads(size_t nb_units, size_t nb_chunks)
+    {
+        long nb_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        size_t nb = nb_cpus > 1 ? (size_t)nb_cpus : 1;
+        nb = std::min(nb, nb_units / PATH_MAP_MIN_UNITS_PER_THREAD);
+        nb = std::min(nb, nb_chunks / PATH_MAP_CHUNK_GRAIN);
+        return std::max(nb, (size_t)1);
     }
+#endif
 }
 
 MTM_STAT(TM_DECLARE(schedule_dag__build_path_map, "mtm-build_path_map"))
 
-void schedule_dag::build_path_map(std::vector< std::vector< bool > >& path,
-        std::map< const schedule_unit *, size_t >& name_map) const
+void schedule_dag::build_path_map(bit_matrix& path) const
 {
     MTM_STAT(TM_START(schedule_dag__build_path_map))
-    /* build name map and resize path */
-    path.resize(get_units().size());
-    name_map.clear();
-    
-    for(size_t u = 0; u < get_units().size(); u++)
+    const std::vector< const schedule_unit * >& units = get_units();
+    size_t n = units.size();
+    path.resize(n, n);
+
+    /* flatten successors, threads must not touch the graph */
+    std::vector< size_t > succ_off(n + 1, 0);
+    std::vector< size_t > succ_idx;
+    std::vector< size_t > nb_succs(n);
+    succ_idx.reserve(get_deps().size());
+    for(size_t u = 0; u < n; u++)
     {
-        name_map[get_units()[u]] = u;
-        path[u].resize(get_units().size());
+        schedule_dep_range succs = get_succs(units[u]);
+        for(size_t i = 0; i < succs.size(); i++)
+            succ_idx.push_back(index_of(succs[i].to()));
+        succ_off[u + 1] = succ_idx.size();
+        nb_succs[u] = succs.size();
+        /* there is a path from a unit to itself */
+        path.set_bit(u, u);
     }
 
-    /* compute path map */
-    std::map< const schedule_unit *, bitmap > reach;
+    /* reverse topological order: a unit comes after all its successors */
+    std::vector< size_t > order;
+    order.reserve(n);
+    for(size_t u = 0; u < n; u++)
+        if(nb_succs[u] == 0)
+            order.push_back(u);
+    for(size_t k = 0; k < order.size(); k++)
+    {
+        schedule_dep_range preds = get_preds(units[order[k]]);
+        for(size_t i = 0; i < preds.size(); i++)
+        {
+            size_t p = index_of(preds[i].from());
+            if(--nb_succs[p] == 0)
+                order.push_back(p);
+        }
+    }
+    if(order.size() != n)
+        throw std::runtime_error("schedule_dag::build_path_map: graph has a cycle");
 
-    for(size_t i = 0; i < get_roots().size(); i++)
-        compute_path_map(*this, path, name_map, reach, get_roots()[i]);
+    /* columns are independent so each thread handles a range of chunks */
+    size_t nb_threads = 1;
+    #ifdef ENABLE_THREADS
+    nb_threads = nb_path_map_threads(n, path.chunks_per_row());
+    #endif
+    std::vector< path_map_job > jobs(nb_threads);
+    size_t per_thread = (path.chunks_per_row() + nb_threads - 1) / nb_threads;
+    per_thread = (per_thread + PATH_MAP_CHUNK_GRAIN - 1) / PATH_MAP_CHUNK_GRAIN * PATH_MAP_CHUNK_GRAIN;
+    for(size_t t = 0; t < nb_threads; t++)
+    {
+        jobs[t].path = &path;
+        jobs[t].order = &order;
+        jobs[t].succ_off = &succ_off;
+        jobs[t].succ_idx = &succ_idx;
+        jobs[t].first = std::min(t * per_thread, path.chunks_per_row());
+        jobs[t].last = std::min((t + 1) * per_thread, path.chunks_per_row());
+    }
+
+    #ifdef ENABLE_THREADS
+    if(nb_threads > 1)
+    {
+        /* the calling thread handles the first job */
+        std::vector< pthread_t > threads(nb_threads);
+        std::vector< bool > started(nb_threads, false);
+        for(size_t t = 1; t < nb_threads; t++)
+            started[t] = pthread_create(&threads[t], 0, &compute_path_map_thread, &jobs[t]) == 0;
+        compute_path_map(jobs[0]);
+        for(size_t t = 1; t < nb_threads; t++)
+        {
+            if(started[t])
+                pthread_join(threads[t], 0);
+            else
+                compute_path_map(jobs[t]);
+        }
+    }
+    else
+    #endif
+        compute_path_map(jobs[0]);
 
     MTM_STAT(TM_STOP(schedule_dag__build_path_map))
-    debug() << "schedule_dag__build_path_map: " <<
-        schedule_dag__build_path_map.get_timer().get_value() / (float)schedule_dag__build_path_map.get_timer().get_hz() << "\n";
-    debug() << "  #nodes: " << get_units().size() << "\n";
-    debug() << "  #edges: " << get_deps().size() << "\n";
+    MTM_STAT(debug() << "schedule_dag__build_path_map: " <<
+        schedule_dag__build_path_map.get_timer().get_value() / (float)schedule_dag__build_path_map.get_timer().get_hz() << "\n";)
+    MTM_STAT(debug() << "  #nodes: " << n << " #edges: " << succ_idx.size() << " #threads: " << nb_threads << "\n";)
+}
+
+void compute_reg_spans(size_t nb_units, const std::vector< reg_lifetime >& regs,
+    const bit_matrix& path, std::vector< size_t >& span)
+{
+    span.assign(nb_units, 0);
+    for(size_t u = 0; u < nb_units; u++)
+        for(size_t r = 0; r < regs.size(); r++)
+        {
+            if(regs[r].creator == u || !path.test_bit(regs[r].creator, u))
+                continue;
+            for(size_t i = 0; i < regs[r].users.size(); i++)
+                if(regs[r].users[i] != u && path.test_bit(u, regs[r].users[i]))
+                {
+                    span[u]++;
+                    break;
+                }
+        }
 }
 
 /**
  * Generic Implementation
  */
 generic_schedule_dag::generic_schedule_dag()
+    :m_ends_dirty(false)
 {
     set_modified(false);
 }
@@ -692,106 +1185,234 @@ void generic_schedule_dag::set_modified(bool mod)
     m_modified = mod;
 }
 
-void generic_schedule_dag::add_unit(const schedule_unit *u)
+size_t generic_schedule_dag::index_of(const schedule_unit *unit) const
 {
-    m_units.push_back(u);
+    size_t idx;
+    if(!m_index.find(unit, idx))
+        throw std::runtime_error("generic_schedule_dag::index_of: unit is not in the graph");
+    return idx;
+}
+
+void generic_schedule_dag::end_batch()
+{
+    if(m_ends_dirty)
+        rebuild_ends();
+}
+
+void generic_schedule_dag::rebuild_ends() const
+{
+    m_roots.clear();
+    m_leaves.clear();
+    for(size_t i = 0; i < m_units.size(); i++)
+    {
+        su_data& d = m_unit_map[m_units[i]];
+        if(d.preds.empty())
+        {
+            d.root_pos = m_roots.size();
+            m_roots.push_back(m_units[i]);
+        }
+        if(d.succs.empty())
+        {
+            d.leaf_pos = m_leaves.size();
+            m_leaves.push_back(m_units[i]);
+        }
+    }
+    m_ends_dirty = false;
+}
+
+void generic_schedule_dag::add_root(const schedule_unit *u)
+{
+    if(m_ends_dirty)
+        return;
+    m_unit_map[u].root_pos = m_roots.size();
     m_roots.push_back(u);
-    m_leaves.push_back(u);
-    m_unit_map.insert(std::make_pair(u, su_data()));
-    
-    set_modified(true);
+}
 
-    #ifdef AUTO_CHECK_CONSISTENCY
-    std::string s;
-    if(!is_consistent(&s))
-        throw std::runtime_error("DAG is not consistent after add_unit (" + s + ")");
-    #endif
+void generic_schedule_dag::remove_root(const schedule_unit *u)
+{
+    if(m_ends_dirty)
+        return;
+    size_t pos = m_unit_map[u].root_pos;
+    m_roots[pos] = m_roots.back();
+    m_unit_map[m_roots[pos]].root_pos = pos;
+    m_roots.pop_back();
 }
 
-struct compare_from_to_against
+void generic_schedule_dag::add_leaf(const schedule_unit *u)
 {
-    compare_from_to_against(const schedule_unit *u) : u(u) {}
-    bool operator()(const schedule_dep& d) const { return d.from() == u || d.to() == u; }
-    const schedule_unit *u;
-};
+    if(m_ends_dirty)
+        return;
+    m_unit_map[u].leaf_pos = m_leaves.size();
+    m_leaves.push_back(u);
+}
 
-void generic_schedule_dag::remove_unit(const schedule_unit *u)
+void generic_schedule_dag::remove_leaf(const schedule_unit *u)
 {
-    compare_from_to_against cfta(u);
-    unordered_find_and_remove(cfta, m_deps);
-    for(size_t i = 0; i < m_units.size(); i++)
+    if(m_ends_dirty)
+        return;
+    size_t pos = m_unit_map[u].leaf_pos;
+    m_leaves[pos] = m_leaves.back();
+    m_unit_map[m_leaves[pos]].leaf_pos = pos;
+    m_leaves.pop_back();
+}
+
+namespace
+{
+    /* find the entry which refers to a given position in the master list */
+    size_t find_pos(const std::vector< size_t >& pos_list, size_t pos)
     {
-        unordered_find_and_remove(cfta, m_unit_map[m_units[i]].preds);
-        unordered_find_and_remove(cfta, m_unit_map[m_units[i]].succs);
+        for(size_t i = 0; i < pos_list.size(); i++)
+            if(pos_list[i] == pos)
+                return i;
+        assert(false && "dependency is not attached to its unit");
+        return 0;
     }
-    
-    unordered_find_and_remove(u, m_units);
-    unordered_find_and_remove(u, m_roots);
-    unordered_find_and_remove(u, m_leaves);
 
-    m_unit_map.erase(m_unit_map.find(u));
+    void remove_pos(std::vector< schedule_dep >& list, std::vector< size_t >& pos_list,
+        size_t pos)
+    {
+        size_t i = find_pos(pos_list, pos);
+        unordered_vector_remove(i, list);
+        unordered_vector_remove(i, pos_list);
+    }
+}
 
-    /* recompute roots and leaves */
-    m_roots.clear();
-    m_leaves.clear();
+void generic_schedule_dag::remove_dep_at(size_t pos)
+{
+    size_t last = m_deps.size() - 1;
+    if(pos != last)
+    {
+        /* the last dependency takes the free slot, update its position */
+        const schedule_dep& moved = m_deps[last];
+        su_data& from = m_unit_map[moved.from()];
+        su_data& to = m_unit_map[moved.to()];
+        from.succ_pos[find_pos(from.succ_pos, last)] = pos;
+        to.pred_pos[find_pos(to.pred_pos, last)] = pos;
+        m_deps[pos] = moved;
+    }
+    m_deps.pop_back();
+}
 
-    for(size_t i = 0; i < m_units.size(); i++)
+void generic_schedule_dag::add_unit(const schedule_unit *u)
+{
+    if(in_batch())
+        m_ends_dirty = true;
+    m_unit_map.insert(std::make_pair(u, su_data()));
+    m_index.set(u, m_units.size());
+    m_units.push_back(u);
+    add_root(u);
+    add_leaf(u);
+    
+    notify_unit_added(u);
+    end_change("add_unit");
+}
+
+void generic_schedule_dag::remove_unit(const schedule_unit *u)
+{
+    if(in_batch())
+        m_ends_dirty = true;
+    notify_unit_removed(u);
+    std::map< const schedule_unit *, su_data >::iterator it = m_unit_map.find(u);
+    assert(it != m_unit_map.end() && "unit is not in the graph");
+    su_data& d = it->second;
+
+    if(d.preds.empty())
+        remove_root(u);
+    if(d.succs.empty())
+        remove_leaf(u);
+    /* detach dependencies from the neighbours, popping them from the back so
+     * that the positions of the remaining ones are kept up to date */
+    while(!d.preds.empty())
     {
-        if(m_unit_map[m_units[i]].preds.size() == 0)
-            m_roots.push_back(m_units[i]);
-        if(m_unit_map[m_units[i]].succs.size() == 0)
-            m_leaves.push_back(m_units[i]);
+        const schedule_unit *from = d.preds.back().from();
+        size_t pos = d.pred_pos.back();
+        d.preds.pop_back();
+        d.pred_pos.pop_back();
+
+        su_data& fd = m_unit_map[from];
+        remove_pos(fd.succs, fd.succ_pos, pos);
+        remove_dep_at(pos);
+        if(fd.succs.empty())
+            add_leaf(from);
+    }
+    while(!d.succs.empty())
+    {
+        const schedule_unit *to = d.succs.back().to();
+        size_t pos = d.succ_pos.back();
+        d.succs.pop_back();
+        d.succ_pos.pop_back();
+
+        su_data& td = m_unit_map[to];
+        remove_pos(td.preds, td.pred_pos, pos);
+        remove_dep_at(pos);
+        if(td.preds.empty())
+            add_root(to);
     }
 
-    set_modified(true);
+    /* the last unit takes the free slot */
+    size_t idx = index_of(u);
+    m_units[idx] = m_units.back();
+    m_index.set(m_units[idx], idx);
+    m_units.pop_back();
 
-    #ifdef AUTO_CHECK_CONSISTENCY
-    std::string s;
-    if(!is_consistent(&s))
-        throw std::runtime_error("DAG is not consistent after remove_unit (" + s + ")");
-    #endif
+    m_unit_map.erase(it);
+    m_index.erase(u);
+
+    end_change("remove_unit");
 }
 
 void generic_schedule_dag::add_dependency(schedule_dep d)
 {
-    m_unit_map[d.from()].succs.push_back(d);
-    m_unit_map[d.to()].preds.push_back(d);
+    if(in_batch())
+        m_ends_dirty = true;
+    su_data& from = m_unit_map[d.from()];
+    su_data& to = m_unit_map[d.to()];
+
+    if(from.succs.empty())
+        remove_leaf(d.from());
+    if(to.preds.empty())
+        remove_root(d.to());
+
+    from.succs.push_back(d);
+    from.succ_pos.push_back(m_deps.size());
+    to.preds.push_back(d);
+    to.pred_pos.push_back(m_deps.size());
     m_deps.push_back(d);
 
-    unordered_find_and_remove(d.from(), m_leaves);
-    unordered_find_and_remove(d.to(), m_roots);
-
-    set_modified(true);
-
-    #ifdef AUTO_CHECK_CONSISTENCY
-    std::string s;
-    if(!is_consistent(&s))
-        throw std::runtime_error("DAG is not consistent after add_dependency (" + s + ")");
-    #endif
+    notify_dependency_added(d);
+    end_change("add_dependency");
 }
 
 void generic_schedule_dag::remove_dependency(schedule_dep d)
 {
+    if(in_batch())
+        m_ends_dirty = true;
     /*
      * Warning !
      * If a dependency exists twice, this should remove only one instance !!
      */
-    unordered_find_and_remove(d, m_deps, true);
-    unordered_find_and_remove(d, m_unit_map[d.from()].succs, true);
-    unordered_find_and_remove(d, m_unit_map[d.to()].preds, true);
+    su_data& from = m_unit_map[d.from()];
+    su_data& to = m_unit_map[d.to()];
 
-    if(m_unit_map[d.from()].succs.size() == 0)
-        m_leaves.push_back(d.from());
-    if(m_unit_map[d.to()].preds.size() == 0)
-        m_roots.push_back(d.to());
-
-    set_modified(true);
+    for(size_t i = 0; i < from.succs.size(); i++)
+    {
+        if(from.succs[i] != d)
+            continue;
+        size_t pos = from.succ_pos[i];
+        unordered_vector_remove(i, from.succs);
+        unordered_vector_remove(i, from.succ_pos);
+        remove_pos(to.preds, to.pred_pos, pos);
+        remove_dep_at(pos);
+
+        if(from.succs.empty())
+            add_leaf(d.from());
+        if(to.preds.empty())
+            add_root(d.to());
+        notify_dependency_removed(d);
+        break;
+    }
 
-    #ifdef AUTO_CHECK_CONSISTENCY
-    std::string s;
-    if(!is_consistent(&s))
-        throw std::runtime_error("DAG is not consistent after remove_dependency (" + s + ")");
-    #endif
+    end_change("remove_dependency");
 }
 
 void generic_schedule_dag::modify_dep(const schedule_dep& _old, const schedule_dep& cur)
@@ -800,15 +1421,22 @@ void generic_schedule_dag::modify_dep(const schedule_dep& _old, const schedule_d
     schedule_dep old = _old;
     assert(old.from() == cur.from() && old.to() == cur.to() && "You can't change from/to properties with modify_dep()");
 
-    unordered_find_and_modify(old, cur, m_deps, true);
-    unordered_find_and_modify(old, cur, m_unit_map[old.from()].succs, true);
-    unordered_find_and_modify(old, cur, m_unit_map[old.to()].preds, true);
+    su_data& from = m_unit_map[old.from()];
+    su_data& to = m_unit_map[old.to()];
+
+    for(size_t i = 0; i < from.succs.size(); i++)
+    {
+        if(from.succs[i] != old)
+            continue;
+        size_t pos = from.succ_pos[i];
+        from.succs[i] = cur;
+        to.preds[find_pos(to.pred_pos, pos)] = cur;
+        m_deps[pos] = cur;
+        notify_dependency_modified(cur);
+        break;
+    }
     
-    #ifdef AUTO_CHECK_CONSISTENCY
-    std::string s;
-    if(!is_consistent(&s))
-        throw std::runtime_error("DAG is not consistent after remove_dependency (" + s + ")");
-    #endif
+    end_change("modify_dep", false);
 }
 
 namespace
@@ -840,6 +1468,8 @@ bool generic_schedule_dag::is_consistent(std::string *out_msg) const
     #else
     #define NOT_CONSISTENT(msg) throw std::runtime_error("DAG is not consistent (" msg ")")
     #endif
+    if(m_ends_dirty)
+        rebuild_ends();
     // every node in root and leaves must be in the whole list
     // and must be consistent
     for(size_t i = 0; i < m_roots.size(); i++)
@@ -863,8 +1493,19 @@ bool generic_schedule_dag::is_consistent(std::string *out_msg) const
         if(m_unit_map.find(unit) == m_unit_map.end())
             NOT_CONSISTENT("unit in master list has no pred/succ info attached");
         su_data& d = m_unit_map[unit];
+        size_t idx;
+        if(!m_index.find(unit, idx) || idx != i)
+            NOT_CONSISTENT("unit in master list has a wrong index");
+        if(d.pred_pos.size() != d.preds.size() || d.succ_pos.size() != d.succs.size())
+            NOT_CONSISTENT("unit has dependencies without position");
+        if(d.preds.size() == 0 && (d.root_pos >= m_roots.size() || m_roots[d.root_pos] != unit))
+            NOT_CONSISTENT("root unit has a wrong position in roots list");
+        if(d.succs.size() == 0 && (d.leaf_pos >= m_leaves.size() || m_leaves[d.leaf_pos] != unit))
+            NOT_CONSISTENT("leaf unit has a wrong position in leaves list");
         for(size_t j = 0; j < d.preds.size(); j++)
         {
+            if(d.pred_pos[j] >= m_deps.size() || m_deps[d.pred_pos[j]] != d.preds[j])
+                NOT_CONSISTENT("unit has a predecessor dep with a wrong position");
             // dependency must go to the unit !
             if(d.preds[j].to() != unit)
                 NOT_CONSISTENT("unit has invalid predeccessor dep (it is not the target !)");
@@ -877,6 +1518,8 @@ bool generic_schedule_dag::is_consistent(std::string *out_msg) const
         }
         for(size_t j = 0; j < d.succs.size(); j++)
         {
+            if(d.succ_pos[j] >= m_deps.size() || m_deps[d.succ_pos[j]] != d.succs[j])
+                NOT_CONSISTENT("unit has a successor dep with a wrong position");
             // dependency must come from the unit !
             if(d.succs[j].from() != unit)
                 NOT_CONSISTENT("unit has invalid successor dep (it is not the source !)");
@@ -922,9 +1565,12 @@ void generic_schedule_dag::clear()
     m_units.clear();
     m_leaves.clear();
     m_roots.clear();
+    m_ends_dirty = false;
     m_unit_map.clear();
+    m_index.clear();
     m_deps.clear();
-    set_modified(true);
+    notify_cleared();
+    end_change("clear");
 }
 
 }
@@ -474,10 +474,8 @@ void strip_useless_order_deps::transform(schedule_dag& dag, const scheduler& s,
     /* Shortcuts */
     const std::vector< const schedule_unit * >& units = dag.get_units();
     size_t n = units.size();
-    /* Map a unit pointer to a number */
-    std::map< const schedule_unit *, size_t > name_map;
-    /* path[u][v] is true if there is a path from u to v */
-    std::vector< std::vector< bool > > path;
+    /* path.test_bit(u, v) is true if there is a path from u to v */
+    bit_matrix path;
     std::vector< schedule_dep > to_remove;
 
     status.begin_transformation();
@@ -488,7 +486,7 @@ void strip_useless_order_deps::transform(schedule_dag& dag, const scheduler& s,
     for(size_t u = 0; u < n; u++)
     {
         const schedule_unit *unit = units[u];
-        const std::vector< schedule_dep >& succs = dag.get_succs(unit);
+        schedule_dep_range succs = dag.get_succs(unit);
         std::map< const schedule_unit *, size_t > order_count;
         for(size_t i = 0; i < succs.size(); i++)
             if(succs[i].kind() == schedule_dep::order_dep)
@@ -501,7 +499,7 @@ void strip_useless_order_deps::transform(schedule_dag& dag, const scheduler& s,
     dag.remove_dependencies(to_remove);
     to_remove.clear();
 
-    dag.build_path_map(path, name_map);
+    dag.build_path_map(path);
 
     /* To remove a dependency, we go through each node U
      * If for such a node, there are two dependencies A->U and B->U
@@ -510,12 +508,12 @@ void strip_useless_order_deps::transform(schedule_dag& dag, const scheduler& s,
     for(size_t u = 0; u < n; u++)
     {
         const schedule_unit *unit = units[u];
-        const std::vector< schedule_dep >& preds = dag.get_preds(unit);
+        schedule_dep_range preds = dag.get_preds(unit);
 
         /* Loop through each pair of dep (A->U,B->U) */
         for(size_t i = 0; i < preds.size(); i++)
         {
-            size_t i_from = name_map[preds[i].from()];
+            size_t i_from = dag.index_of(preds[i].from());
             /* Mind the order !
              * We don't want to treat each pair twice because we would
              * end up removing each edge twice. Furthermore we should
@@ -524,14 +522,14 @@ void strip_useless_order_deps::transform(schedule_dag& dag, const scheduler& s,
              * then we want to remove only one of them */
             for(size_t j = i + 1; j < preds.size(); j++)
             {
-                size_t j_from = name_map[preds[j].from()];
+                size_t j_from = dag.index_of(preds[j].from());
 
-                assert(path[i_from][u] && path[j_from][u]);
+                assert(path.test_bit(i_from, u) && path.test_bit(j_from, u));
 
                 /* Try both order */
-                if(path[i_from][j_from] && preds[i].kind() == schedule_dep::order_dep)
+                if(path.test_bit(i_from, j_from) && preds[i].kind() == schedule_dep::order_dep)
                     to_remove.push_back(preds[i]);
-                else if(path[j_from][i_from] && preds[j].kind() == schedule_dep::order_dep)
+                else if(path.test_bit(j_from, i_from) && preds[j].kind() == schedule_dep::order_dep)
                     to_remove.push_back(preds[j]);
             }
         }
@@ -594,13 +592,12 @@ void smart_fuse_two_units::transform(schedule_dag& dag, const scheduler& s, sche
         {
             const schedule_unit *unit = dag.get_units()[u];
 
-            std::set< schedule_dep::reg_t > vc = dag.get_reg_create(unit);
-            std::set< schedule_dep::reg_t > vu = dag.get_reg_use(unit);
-            std::set< schedule_dep::reg_t > vd = dag.get_reg_destroy(unit);
-            std::set< const schedule_unit * > ipreds = dag.get_reachable(unit,
-                schedule_dag::rf_follow_preds | schedule_dag::rf_immediate);
-            std::set< const schedule_unit * > isuccs = dag.get_reachable(unit,
-                schedule_dag::rf_follow_succs | schedule_dag::rf_immediate);
+            const schedule_dag::reg_info& ri = dag.get_reg_info(unit);
+            const schedule_dag::reg_list& vc = ri.create;
+            const schedule_dag::reg_list& vu = ri.use;
+            const schedule_dag::reg_list& vd = ri.destroy;
+            size_t nb_ipreds = dag.count_distinct_preds(unit);
+            size_t nb_isuccs = dag.count_distinct_succs(unit);
             //*
             //debug() << "Unit: " << unit->to_string() << "\n";
             //debug() << "  VC=" << vc << "\n";
@@ -615,7 +612,7 @@ void smart_fuse_two_units::transform(schedule_dag& dag, const scheduler& s, sche
              * Then
              * - fuse unit to predecessor */
             /*
-            if(ipreds.size() == 1)
+            if(nb_ipreds == 1)
             {
                 debug() << "Unit: " << unit->to_string() << "\n";
                 debug() << "VC=" << vc.size() << "\n";
@@ -623,7 +620,7 @@ void smart_fuse_two_units::transform(schedule_dag& dag, const scheduler& s, sche
                 debug() << "VU=" << vu.size() << "\n";
             }
             */
-            if(ipreds.size() == 1 && vd.size() >= vc.size() &&
+            if(nb_ipreds == 1 && vd.size() >= vc.size() &&
                     unit->internal_register_pressure() <= vd.size())
             {
                 chain_schedule_unit *c = dag.fuse_units(dag.get_preds(unit)[0].from(), unit, !allow_approx);
@@ -639,7 +636,7 @@ void smart_fuse_two_units::transform(schedule_dag& dag, const scheduler& s, sche
              * - IRP of unit is lower than the number of created variables
              * Then
              * - fuse unit to successor */
-            else if(isuccs.size() == 1 && vc.size() >= vu.size() &&
+            else if(nb_isuccs == 1 && vc.size() >= vu.size() &&
                     unit->internal_register_pressure() <= vc.size())
             {
                 chain_schedule_unit *c = dag.fuse_units(unit, dag.get_succs(unit)[0].to(), !allow_approx);
@@ -729,14 +726,18 @@ bool smart_fuse_two_units::weak_fuse(schedule_dag& dag, const schedule_unit *a,
 {
     /* For each dep (U,B) add a dep (U,A) */
     std::vector< schedule_dep > to_add;
+    traversal_scratch scratch;
+    std::vector< const schedule_unit * > reach;
+    size_t a_idx = dag.index_of(a);
     for(size_t i = 0; i < dag.get_preds(b).size(); i++)
     {
         const schedule_unit *unit = dag.get_preds(b)[i].from();
         if(unit == a)
             continue;
-        std::set< const schedule_unit * > reach = dag.get_reachable(unit, schedule_dag::rf_follow_succs);
+        reach.clear();
+        dag.get_reachable(unit, schedule_dag::rf_follow_succs, scratch, reach);
 
-        if(reach.find(a) == reach.end())
+        if(!scratch.visited(a_idx))
             to_add.push_back(schedule_dep(unit, a, schedule_dep::order_dep));
     }
     
@@ -869,23 +870,22 @@ void simplify_order_cuts::transform(schedule_dag& dag, const scheduler& s, sched
     {
         //std::cout << "  " << it->second << "\n";
         /* schedule each subgraph */
-        schedule_dag *sub = dag.dup_subgraph(it->second);
+        subgraph_schedule_dag sub(dag, it->second);
         generic_schedule_chain gsc;
 
         XTM_FW_STOP(simplify_order_cuts)
         
-        s.schedule(*sub, gsc);
+        s.schedule(sub, gsc);
 
         XTM_FW_START(simplify_order_cuts)
         
         /* create a chain unit and collapse in the reduced sub graph */
         chain_schedule_unit *csu = new chain_schedule_unit;
         csu->get_chain() = gsc.get_units();
-        csu->set_internal_register_pressure(c.compute_rp_against_dag(*sub));
+        csu->set_internal_register_pressure(c.compute_rp_against_dag(sub));
 
+        /* NOTE: sub is a view of dag, don't use it once dag is modified */
         dag.collapse_subgraph(it->second, csu);
-        /* release memory */
-        delete sub;
     }
 
     XTM_FW_STOP(simplify_order_cuts)
@@ -933,13 +933,11 @@ void split_def_use_dom_use_deps::transform(schedule_dag& dag, const scheduler& s
     DEBUG_CHECK_BEGIN_X(dag, c)
     XTM_FW_START(split_def_use_dom_use_deps)
 
-    /* Map a unit pointer to a number */
-    std::map< const schedule_unit *, size_t > name_map;
-    /* path[u][v] is true if there is a path from u to v */
-    std::vector< std::vector< bool > > path;
+    /* path.test_bit(u, v) is true if there is a path from u to v */
+    bit_matrix path;
     /* First compute path map, it will not changed during the algorithm
-     * even though some edges are changed */
-    dag.build_path_map(path, name_map);
+     * even though some edges are changed (units and thus indexes don't) */
+    dag.build_path_map(path);
     /* Chain units added (each one "contains" only one unit but we need to tweak IRP) */
     std::vector< chain_schedule_unit * > chains_added;
     
@@ -957,7 +955,7 @@ void split_def_use_dom_use_deps::transform(schedule_dag& dag, const scheduler& s
         for(size_t u = 0; u < dag.get_units().size(); u++)
         {
             const schedule_unit *unit = dag.get_units()[u];
-            const std::vector< schedule_dep >& succs = dag.get_succs(unit);
+            schedule_dep_range succs = dag.get_succs(unit);
             /* Skip useless units for speed reason */
             if(succs.size() <= 1)
                 continue;
@@ -974,6 +972,8 @@ void split_def_use_dom_use_deps::transform(schedule_dag& dag, const scheduler& s
             for(; reg_succs_it != reg_succs.end(); ++reg_succs_it)
             {
                 std::vector< schedule_dep > reg_use = reg_succs_it->second;
+                /* the previous register might have changed the graph */
+                succs = dag.get_succs(unit);
 
                 /* See if one successor S of U dominate all uses
                  * NOTE: S can be any successor of U
@@ -983,7 +983,7 @@ void split_def_use_dom_use_deps::transform(schedule_dag& dag, const scheduler& s
                 for(size_t dom_idx = 0; dom_idx < succs.size(); dom_idx++)
                 {
                     for(size_t i = 0; i < reg_use.size(); i++)
-                        if(!path[name_map[succs[dom_idx].to()]][name_map[reg_use[i].to()]])
+                        if(!path.test_bit(dag.index_of(succs[dom_idx].to()), dag.index_of(reg_use[i].to())))
                             goto Lskip;
                     dominators.push_back(succs[dom_idx].to());
                     Lskip:
@@ -1246,12 +1246,12 @@ void break_symmetrical_branch_merge::transform(schedule_dag& dag, const schedule
             std::vector< const schedule_unit * > to_remove;
             for(it = succs.begin(); it != succs.end(); ++it)
             {
-                if(dag.get_reachable(*it, schedule_dag::rf_follow_preds | schedule_dag::rf_immediate).size() != 1)
+                if(dag.count_distinct_preds(*it) != 1)
                 {
                     to_remove.push_back(*it);
                     continue;
                 }
-                if(dag.get_reachable(*it, schedule_dag::rf_follow_succs | schedule_dag::rf_immediate).size() != 1)
+                if(dag.count_distinct_succs(*it) != 1)
                 {
                     to_remove.push_back(*it);
                     continue;
@@ -1281,13 +1281,13 @@ void break_symmetrical_branch_merge::transform(schedule_dag& dag, const schedule
             size_t irp = 0;
             for(it = grp.begin(); it != grp.end(); ++it)
             {
-                size_t cnt = dag.get_reg_use(*it).size();
+                size_t cnt = dag.get_reg_info(*it).use.size();
                 if(it == grp.begin())
                     nb_input_regs = cnt;
                 else if(nb_input_regs != cnt)
                     goto Lnext_group;
 
-                cnt = dag.get_reg_create(*it).size();
+                cnt = dag.get_reg_info(*it).create.size();
                 if(it == grp.begin())
                     nb_ouput_regs = cnt;
                 else if(nb_ouput_regs != cnt)
@@ -1304,10 +1304,9 @@ void break_symmetrical_branch_merge::transform(schedule_dag& dag, const schedule
                 std::map< schedule_dep::reg_t, size_t >::iterator ruc_it;
                 for(it = grp.begin(); it != grp.end(); ++it)
                 {
-                    std::set< schedule_dep::reg_t > use = dag.get_reg_use(*it);
-                    std::set< schedule_dep::reg_t >::iterator rit;
-                    for(rit = use.begin(); rit != use.end(); ++rit)
-                        reg_use_count[*rit]++;
+                    const schedule_dag::reg_list& use = dag.get_reg_info(*it).use;
+                    for(size_t i = 0; i < use.size(); i++)
+                        reg_use_count[use[i]]++;
                 }
 
                 for(ruc_it = reg_use_count.begin(); ruc_it != reg_use_count.end(); ++ruc_it)
@@ -1396,15 +1395,14 @@ void collapse_chains::transform(schedule_dag& dag, const scheduler& s, schedule_
         while(true)
         {
             chain.push_back(unit);
-            size_t s = dag.get_reachable(unit, schedule_dag::rf_follow_succs |
-                        schedule_dag::rf_immediate).size();
+            size_t s = dag.count_distinct_succs(unit);
             irp = std::max(irp, unit->internal_register_pressure());
             if(s == 0)
                 break;
             if(s != 1)
                 goto Lnot_chain;
 
-            irp = std::max(irp, (unsigned)dag.get_reg_create(unit).size());
+            irp = std::max(irp, (unsigned)dag.get_reg_info(unit).create.size());
             
             unit = dag.get_succs(unit)[0].to();
         }
@@ -1619,9 +1617,10 @@ namespace
             status.set_modified_graph(true);
             status.set_junction(true);
             
-            schedule_dag *sub = dag.dup_subgraph(set);
-            s.schedule(*sub, c);
-            delete sub;
+            {
+                subgraph_schedule_dag sub(dag, set);
+                s.schedule(sub, c);
+            }
             /* delete from the graph */
             dag.remove_units(set_to_vector(set));
         }
@@ -1813,6 +1812,8 @@ void handle_physical_regs::transform(schedule_dag& dag, const scheduler& s, sche
     
     status.begin_transformation();
 
+    /* path queries, the index is only built if needed */
+    reachability_index reach(dag);
     /* build a map of physical registers creators */
     reg_creator_list reg_creators;
     std::vector< schedule_dep::reg_t > several_creators;
@@ -1832,14 +1833,11 @@ void handle_physical_regs::transform(schedule_dag& dag, const scheduler& s, sche
      * Hopefully, in a number of cases, this is a false positive because the
      * natural ordering will prevent them from interfering.
      * Check this for each register.
-     * Loop because we add edges for detected partial order which can change things */
+     * Loop because we add edges for detected partial order which can change things,
+     * the reachability index follows them */
     while(true)
     {
         reg_problem_map partials;
-        /* create path map */
-        std::vector< std::vector< bool > > path;
-        std::map< const schedule_unit *, size_t > name_map;
-        dag.build_path_map(path, name_map);
         
         for(size_t i = 0; i < several_creators.size(); i++)
         {
@@ -1888,11 +1886,11 @@ void handle_physical_regs::transform(schedule_dag& dag, const scheduler& s, sche
                             continue;
                         const schedule_unit *use = dep.to();
                         /* if there is no path from S to D, then they might interfere */
-                        if(!path[name_map[use]][name_map[creator]])
+                        if(!reach.is_reachable(use, creator))
                             inter = true;
                         /* if there is a path from C to S, then it means that C has a partial order
                          * with S */
-                        if(creator != use && path[name_map[creator]][name_map[use]])
+                        if(creator != use && reach.is_reachable(creator, use))
                             partial = true;
                     }
                     /* we proved they do not interfere */
@@ -1937,7 +1935,11 @@ void handle_physical_regs::transform(schedule_dag& dag, const scheduler& s, sche
 
         if(partials.size() == 0)
             break;
-        /* Enforce partial orders */
+        /* Enforce partial orders
+         * The dependencies are only added once all of them are known so that the
+         * path queries see the graph as it was at the beginning of the pass, an
+         * order dependency implied by another one of the same pass is still added */
+        std::vector< schedule_dep > order_deps;
         for(reg_problem_map::iterator it = partials.begin(); it != partials.end(); ++it)
         {
             reg_problem_list& l = it->second;
@@ -1951,15 +1953,17 @@ void handle_physical_regs::transform(schedule_dag& dag, const scheduler& s, sche
                 {
                     const schedule_dep& dep = dag.get_succs(c_from)[j];
                     if(dep.is_phys() && dep.reg() == it->first &&
-                            !path[name_map[dep.to()]][name_map[c_to]])
+                            !reach.is_reachable(dep.to(), c_to))
                     {
-                        dag.add_dependency(
+                        order_deps.push_back(
                             schedule_dep(
                                 dep.to(), c_to, schedule_dep::order_dep));
                     }
                 }
             }
         }
+        for(size_t i = 0; i < order_deps.size(); i++)
+            dag.add_dependency(order_deps[i]);
         /* continue the loop */
     }
     /* If there are no more problem, just promote them all */
@@ -2019,6 +2023,7 @@ void handle_physical_regs::transform(schedule_dag& dag, const scheduler& s, sche
     }
 
     Lcont:
+    reach.detach();
     status.set_modified_graph(modified);
     status.set_junction(false);
     status.set_deadlock(false);
@@ -2,6 +2,7 @@
 #include <tools.hpp>
 #include <sched-dag-viewer.hpp>
 #include <climits>
+#include <algorithm>
 #include <queue>
 #include <map>
 #include <set>
@@ -22,6 +23,16 @@ scheduler::~scheduler()
 {
 }
 
+const budget_usage& scheduler::get_budget_usage() const
+{
+    return m_budget_usage;
+}
+
+void scheduler::reset_budget_usage()
+{
+    m_budget_usage = budget_usage();
+}
+
 /**
  * rand_scheduler
  */
@@ -148,6 +159,8 @@ void simple_rp_scheduler::schedule(schedule_dag& dag, schedule_chain& c) const
     std::map< const schedule_unit *, srp_unit_info > unit_info;
     std::map< schedule_dep::reg_t, srp_live_reg > live_regs;
     std::vector< const schedule_unit * > schedulable;
+    std::vector< const schedule_unit * > next;
+    traversal_scratch scratch;
     size_t max_rp = 0;
     generic_schedule_chain gsc;
 
@@ -155,8 +168,7 @@ void simple_rp_scheduler::schedule(schedule_dag& dag, schedule_chain& c) const
     for(size_t u = 0; u < dag.get_units().size(); u++)
     {
         const schedule_unit *unit = dag.get_units()[u];
-        unit_info[unit].nb_unscheduled_deps =
-            dag.get_reachable(unit, schedule_dag::rf_follow_preds | schedule_dag::rf_immediate).size();
+        unit_info[unit].nb_unscheduled_deps = dag.count_distinct_preds(unit);
     }
 
     schedulable = dag.get_roots();
@@ -171,19 +183,20 @@ void simple_rp_scheduler::schedule(schedule_dag& dag, schedule_chain& c) const
         for(size_t i = 0; i < schedulable.size(); i++)
         {
             const schedule_unit *unit = schedulable[i];
-            std::set< schedule_dep::reg_t > phys_create = dag.get_reg_phys_create(unit);
-            std::set< schedule_dep::reg_t > use = dag.get_reg_use(unit);
+            const schedule_dag::reg_info& ri = dag.get_reg_info(unit);
+            const schedule_dag::reg_list& phys_create = ri.phys_create;
+            const schedule_dag::reg_list& use = ri.use;
             /* first check that the node can be schedule: it must not create a physical register already in use
              * except if it also kills it, tricky ! */
             bool not_schedulable = false;
-            for(std::set< schedule_dep::reg_t >::iterator it = phys_create.begin(); it != phys_create.end(); ++it)
+            for(schedule_dag::reg_list::const_iterator it = phys_create.begin(); it != phys_create.end(); ++it)
             {
                 if(live_regs.find(*it) == live_regs.end())
                     continue; /* safe */
                 /* unsafe, it create a physical register so it must kill it otherwise it's not a valid schedule:
                  * 1) it must be in the reg use list
                  * 2) it must be the last use of it */
-                if(use.find(*it) != use.end())
+                if(std::binary_search(use.begin(), use.end(), *it))
                 {
                     assert(live_regs.find(*it) != live_regs.end() && "Use variable is not alive");
                     if(live_regs[*it].nb_use_left == 1)
@@ -199,10 +212,10 @@ void simple_rp_scheduler::schedule(schedule_dag& dag, schedule_chain& c) const
             /* compute score : max(irp, created_reg) - destroyed_reg */
             int score =
                 std::max((int)unit->internal_register_pressure(),
-                    (int)dag.get_reg_create(unit).size());
+                    (int)ri.create.size());
             /* loop through each variable used and determine if it is destroyed or not */
             
-            for(std::set< schedule_dep::reg_t >::iterator it = use.begin(); it != use.end(); ++it)
+            for(schedule_dag::reg_list::const_iterator it = use.begin(); it != use.end(); ++it)
             {
                 assert(live_regs.find(*it) != live_regs.end() && "Use variable is not alive");
                 assert(live_regs[*it].id == *it && "Inconsistent live reg map");
@@ -257,9 +270,10 @@ void simple_rp_scheduler::schedule(schedule_dag& dag, schedule_chain& c) const
         gsc.append_unit(unit);
 
         /* update children */
-        std::set< const schedule_unit * > next = dag.get_reachable(unit,
-            schedule_dag::rf_follow_succs | schedule_dag::rf_immediate);
-        for(std::set< const schedule_unit * >::iterator it = next.begin(); it != next.end(); ++it)
+        next.clear();
+        dag.get_reachable(unit, schedule_dag::rf_follow_succs | schedule_dag::rf_immediate,
+            scratch, next);
+        for(std::vector< const schedule_unit * >::iterator it = next.begin(); it != next.end(); ++it)
         {
             /* decrement the number of unscheduled deps */
             assert(unit_info.find(*it) != unit_info.end() && "Inconsistent unit info map");
@@ -275,9 +289,9 @@ void simple_rp_scheduler::schedule(schedule_dag& dag, schedule_chain& c) const
         }
 
         /* kills registers if needed */
-        std::set< schedule_dep::reg_t > use = dag.get_reg_use(unit);
+        const schedule_dag::reg_list& use = dag.get_reg_info(unit).use;
         std::vector< schedule_dep::reg_t > destroyed;
-        for(std::set< schedule_dep::reg_t >::iterator it = use.begin(); it != use.end(); ++it)
+        for(schedule_dag::reg_list::const_iterator it = use.begin(); it != use.end(); ++it)
         {
             live_regs[*it].nb_use_left--;
             /* register is dead ? */
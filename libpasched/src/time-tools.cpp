@@ -2,6 +2,7 @@
 #include "tools.hpp"
 #include <ctime>
 #include <stdexcept>
+#include <time.h>
 
 namespace PAMAURY_SCHEDULER_NS
 {
@@ -132,4 +133,134 @@ time_stat *time_stat::get_time_stat_by_name(const std::string& str)
     throw std::runtime_error("time_stat::get_time_stat_by_name can't find name in registered time stats");
 }
 
+/**
+ * budget
+ */
+budget::budget()
+    :m_work_limit(0), m_time_limit(0)
+{
+}
+
+budget::budget(uint64_t work_limit, uint64_t time_limit)
+    :m_work_limit(work_limit), m_time_limit(time_limit)
+{
+}
+
+budget budget::from_work(uint64_t work_limit)
+{
+    return budget(work_limit, 0);
+}
+
+budget budget::from_time(uint64_t time_limit)
+{
+    return budget(0, time_limit);
+}
+
+uint64_t budget::get_work_limit() const
+{
+    return m_work_limit;
+}
+
+uint64_t budget::get_time_limit() const
+{
+    return m_time_limit;
+}
+
+bool budget::is_limited() const
+{
+    return m_work_limit != 0 || m_time_limit != 0;
+}
+
+/**
+ * budget_meter
+ */
+namespace
+{
+    /* in ms, the time of day can jump */
+    uint64_t monotonic_time()
+    {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+    }
+}
+
+budget_meter::budget_meter()
+    :m_work(0), m_start(0), m_stop(0), m_running(false)
+{
+}
+
+void budget_meter::start(const budget& b)
+{
+    m_budget = b;
+    m_work = 0;
+    m_start = monotonic_time();
+    m_running = true;
+}
+
+void budget_meter::stop()
+{
+    m_stop = monotonic_time();
+    m_running = false;
+}
+
+void budget_meter::extend(const budget& more)
+{
+    uint64_t work = more.get_work_limit();
+    uint64_t time = more.get_time_limit();
+    m_budget = budget(work == 0 ? 0 : get_work() + work, time == 0 ? 0 : get_elapsed_time() + time);
+}
+
+void budget_meter::add_work(uint64_t work)
+{
+    #ifdef ENABLE_THREADS
+    __sync_fetch_and_add(&m_work, work);
+    #else
+    m_work += work;
+    #endif
+}
+
+uint64_t budget_meter::get_work() const
+{
+    #ifdef ENABLE_THREADS
+    return __atomic_load_n(&m_work, __ATOMIC_RELAXED);
+    #else
+    return m_work;
+    #endif
+}
+
+uint64_t budget_meter::get_elapsed_time() const
+{
+    return (m_running ? monotonic_time() : m_stop) - m_start;
+}
+
+bool budget_meter::is_exhausted() const
+{
+    if(m_budget.get_work_limit() != 0 && get_work() >= m_budget.get_work_limit())
+        return true;
+    return m_budget.get_time_limit() != 0 && get_elapsed_time() >= m_budget.get_time_limit();
+}
+
+const budget& budget_meter::get_budget() const
+{
+    return m_budget;
+}
+
+/**
+ * budget_usage
+ */
+budget_usage::budget_usage()
+    :work(0), time(0), nb_runs(0), nb_exhausted(0)
+{
+}
+
+void budget_usage::add(const budget_meter& meter, bool exhausted)
+{
+    work += meter.get_work();
+    time += meter.get_elapsed_time();
+    nb_runs++;
+    if(exhausted)
+        nb_exhausted++;
+}
+
 }
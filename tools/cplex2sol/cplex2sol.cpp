@@ -1,20 +1,11 @@
+#include <pasched.hpp>
 #include <fstream>
 #include <string>
 #include <iostream>
-#include <sstream>
 #include <vector>
 #include <cmath>
 #include <cstdlib>
 
-std::string trim(const std::string& s)
-{
-    size_t f = s.find_first_not_of(" ");
-    if(f == std::string::npos)
-        return std::string();
-
-    return s.substr(f, s.find_last_not_of(" ") - f + 1);
-}
-
 double round_if(double v)
 {
     double eps = 1e-10;
@@ -51,125 +42,20 @@ int main(int argc, char **argv)
         return 1;
     }
 
-    std::vector< double > constraint;
-    std::vector< double > variable;
-    double obj;
-
-    std::string line;
-    while(std::getline(fin, line))
+    pasched::cplex_solution sol;
+    if(!pasched::read_cplex_solution(fin, sol))
     {
-        int idx;
-        double val;
-        
-        line = trim(line);
-        
-        std::string s = "<constraint ";
-        if(line.size() > s.size() && line.substr(0, s.size()) == s)
-        {
-            line = trim(line.substr(s.size()));
-            s = "name=\"";
-            if(line.size() <= s.size() || line.substr(0, s.size()) != s)
-                continue;
-            line = line.substr(s.size());
-            size_t pos = line.find('\"');
-            if(pos == std::string::npos)
-                continue;
-            line = trim(line.substr(pos + 1));
-            s = "index=\"";
-            if(line.size() <= s.size() || line.substr(0, s.size()) != s)
-                continue;
-            line = line.substr(s.size());
-            pos = line.find('\"');
-            if(pos == std::string::npos)
-                continue;
-
-            std::istringstream iss(line.substr(0, pos));
-            if(!(iss >> idx) || !iss.eof())
-                continue;
-
-            line = trim(line.substr(pos + 1));
-            s = "slack=\"";
-            if(line.size() <= s.size() || line.substr(0, s.size()) != s)
-                continue;
-            line = line.substr(s.size());
-            pos = line.find('\"');
-            if(pos == std::string::npos)
-                continue;
-
-            std::istringstream iss2(line.substr(0, pos));
-            if(!(iss2 >> val))
-                continue;
-
-            constraint.push_back(val);
-            //std::cout << "constraint: idx=" << idx << " val=" << val << "\n";
-            continue;
-        }
-
-        s = "<variable ";
-        if(line.size() > s.size() && line.substr(0, s.size()) == s)
-        {
-            line = trim(line.substr(s.size()));
-            s = "name=\"";
-            if(line.size() <= s.size() || line.substr(0, s.size()) != s)
-                continue;
-            line = line.substr(s.size());
-            size_t pos = line.find('\"');
-            if(pos == std::string::npos)
-                continue;
-            line = trim(line.substr(pos + 1));
-            s = "index=\"";
-            if(line.size() <= s.size() || line.substr(0, s.size()) != s)
-                continue;
-            line = line.substr(s.size());
-            pos = line.find('\"');
-            if(pos == std::string::npos)
-                continue;
-
-            std::istringstream iss(line.substr(0, pos));
-            if(!(iss >> idx) || !iss.eof())
-                continue;
-
-            line = trim(line.substr(pos + 1));
-            s = "value=\"";
-            if(line.size() <= s.size() || line.substr(0, s.size()) != s)
-                continue;
-            line = line.substr(s.size());
-            pos = line.find('\"');
-            if(pos == std::string::npos)
-                continue;
-
-            std::istringstream iss2(line.substr(0, pos));
-            if(!(iss2 >> val))
-                continue;
-
-            variable.push_back(val);
-            //std::cout << "value: idx=" << idx << " val=" << val << "\n";
-            continue;
-        }
-
-        s = "objectiveValue=\"";
-        if(line.size() > s.size() && line.substr(0, s.size()) == s)
-        {
-            line = line.substr(s.size());
-            size_t pos = line.find('\"');
-            if(pos == std::string::npos)
-                continue;
-
-            std::istringstream iss(line.substr(0, pos));
-            if(!(iss >> obj) || !iss.eof())
-                continue;
-
-            std::cout << "objective value: " << obj << "\n";
-            continue;
-        }
+        std::cout << "No objective value in '" << argv[1] << "'\n";
+        return 1;
     }
-
-    fout << constraint.size() << " " << variable.size() << "\n";
-    fout << "5 " << obj << "\n";
-    for(size_t i = 0; i < constraint.size(); i++)
-        fout << round_if(constraint[i]) << "\n";
-    for(size_t i = 0; i < variable.size(); i++)
-        fout << round_if(variable[i]) << "\n";
+    std::cout << "objective value: " << sol.obj << "\n";
+
+    fout << sol.row_slacks.size() << " " << sol.col_values.size() << "\n";
+    fout << "5 " << sol.obj << "\n";
+    for(size_t i = 0; i < sol.row_slacks.size(); i++)
+        fout << round_if(sol.row_slacks[i]) << "\n";
+    for(size_t i = 0; i < sol.col_values.size(); i++)
+        fout << round_if(sol.col_values[i]) << "\n";
 
     return 0;
 }
@@ -481,7 +481,7 @@ int __main(int argc, char **argv)
 
     /* read DAG */
     TM_START(dtm_read)
-    pasched::generic_schedule_dag dag;
+    pasched::compact_schedule_dag dag;
     formats[from].read(argv[2], dag);
     if(!dag.is_consistent())
     {
@@ -517,10 +517,10 @@ int __main(int argc, char **argv)
 
     #if 0
     pasched::simple_rp_scheduler basic_sched;
-    pasched::mris_ilp_scheduler sched(&basic_sched, 1000, true);
+    pasched::mris_ilp_scheduler sched(&basic_sched, pasched::budget::from_time(1000), true);
     #elif 0
     pasched::simple_rp_scheduler basic_sched;
-    pasched::exp_scheduler sched(&basic_sched, 5000, false);
+    pasched::exp_scheduler sched(&basic_sched, pasched::budget::from_time(5000), false);
     #else
     pasched::simple_rp_scheduler sched;
     #endif
@@ -46,15 +46,13 @@ private:
         const pasched::schedule_dag& dag,
         std::set< pasched::schedule_dep::reg_t >& phys_regs,
         std::map< SUnit *, const LLVMScheduleUnit * >& su_name_map,
-        std::vector< std::vector< bool > >& path,
-        std::map< const pasched::schedule_unit *, size_t >& path_name_map);
+        pasched::bit_matrix& path);
     bool HandlePhysRangeUnitConflicts(
         const pasched::schedule_dag& dag,
         std::set< pasched::schedule_dep::reg_t >& phys_regs,
         std::map< SUnit *, const LLVMScheduleUnit * >& su_name_map,
         std::set< std::pair< const pasched::schedule_unit *, pasched::schedule_dep::reg_t > >& unsafe_clobbering,
-        std::vector< std::vector< bool > >& path,
-        std::map< const pasched::schedule_unit *, size_t >& path_name_map);
+        pasched::bit_matrix& path);
     EVT GetPhysicalRegisterVT(SDNode *N, unsigned Reg) const;
     SUnit *CloneInstruction(
         SUnit *su,
@@ -503,8 +501,7 @@ bool PaScheduleDAG::HandlePhysRangeUnitConflicts(
         std::set< pasched::schedule_dep::reg_t >& phys_regs,
         std::map< SUnit *, const LLVMScheduleUnit * >& su_name_map,
         std::set< std::pair< const pasched::schedule_unit *, pasched::schedule_dep::reg_t > >& unsafe_clobbering,
-        std::vector< std::vector< bool > >& path,
-        std::map< const pasched::schedule_unit *, size_t >& path_name_map)
+        pasched::bit_matrix& path)
 {
     bool graph_modified = false;
     /* build a map of clobbering units */
@@ -605,7 +602,7 @@ bool PaScheduleDAG::HandlePhysRangeUnitConflicts(
                 std::set< const pasched::schedule_unit * >tricky_units;
                 for(size_t i = 0; i < use_that_dont_clobber.size(); i++)
                 {
-                    if(path[path_name_map[use_that_clobber[0]]][path_name_map[use_that_dont_clobber[i]]])
+                    if(path.test_bit(dag.index_of(use_that_clobber[0]), dag.index_of(use_that_dont_clobber[i])))
                         tricky_units.insert(use_that_dont_clobber[i]);
                 }
                 /* real problem ? */
@@ -624,7 +621,7 @@ bool PaScheduleDAG::HandlePhysRangeUnitConflicts(
                 
                 for(size_t i = 0; i < use_that_dont_clobber.size(); i++)
                 {
-                    if(!path[path_name_map[use_that_dont_clobber[i]]][path_name_map[use_that_clobber[0]]])
+                    if(!path.test_bit(dag.index_of(use_that_dont_clobber[i]), dag.index_of(use_that_clobber[0])))
                     {
                         base = static_cast< const LLVMScheduleUnitBase * >(use_that_dont_clobber[i]);
                         assert(base->is_llvm_unit() && "all units must be of kind LLVMScheduleUnit at this point too");
@@ -650,7 +647,7 @@ bool PaScheduleDAG::HandlePhysRangeUnitConflicts(
                     {
                         if(j == k)
                             continue;
-                        if(path[path_name_map[use_that_clobber[k]]][path_name_map[use_that_clobber[j]]])
+                        if(path.test_bit(dag.index_of(use_that_clobber[k]), dag.index_of(use_that_clobber[j])))
                         {
                             selectable = false;
                             break;
@@ -673,7 +670,7 @@ bool PaScheduleDAG::HandlePhysRangeUnitConflicts(
                 }
                 for(size_t j = 0; j < use_that_dont_clobber.size(); j++)
                 {
-                    if(path[path_name_map[cutter]][path_name_map[use_that_dont_clobber[j]]])
+                    if(path.test_bit(dag.index_of(cutter), dag.index_of(use_that_dont_clobber[j])))
                         tricky_units.push_back(use_that_dont_clobber[j]);
                 }
                 /* now clone the creator */
@@ -705,10 +702,10 @@ bool PaScheduleDAG::HandlePhysRangeUnitConflicts(
             for(size_t j = 0; j < clobber.size(); j++)
             {
                 /* fast decision ? */
-                if(path[path_name_map[clobber[j]]][path_name_map[creator]])
+                if(path.test_bit(dag.index_of(clobber[j]), dag.index_of(creator)))
                     continue; /* not problem */
                 /* other way around ? */
-                bool path_create_clobber = path[path_name_map[creator]][path_name_map[clobber[j]]];
+                bool path_create_clobber = path.test_bit(dag.index_of(creator), dag.index_of(clobber[j]));
                 std::set< const pasched::schedule_unit * > path_clobber_use;
                 std::set< const pasched::schedule_unit * > no_path_use_clobber;
                 /* consider each use */
@@ -717,10 +714,10 @@ bool PaScheduleDAG::HandlePhysRangeUnitConflicts(
                     const pasched::schedule_unit *use = creators_phys_succs[i][k];
                     /*  */
                     if(clobber[j] != use &&
-                            path[path_name_map[clobber[j]]][path_name_map[use]])
+                            path.test_bit(dag.index_of(clobber[j]), dag.index_of(use)))
                         path_clobber_use.insert(use);
                     /* incomplete order ? */
-                    if(!path[path_name_map[use]][path_name_map[clobber[j]]])
+                    if(!path.test_bit(dag.index_of(use), dag.index_of(clobber[j])))
                         no_path_use_clobber.insert(use);
                 }
                 /* if there is a conflict, handle it by cloning unit */
@@ -790,8 +787,7 @@ bool PaScheduleDAG::HandlePhysRangeRangeConflicts(
         const pasched::schedule_dag& dag,
         std::set< pasched::schedule_dep::reg_t >& phys_regs,
         std::map< SUnit *, const LLVMScheduleUnit * >& su_name_map,
-        std::vector< std::vector< bool > >& path,
-        std::map< const pasched::schedule_unit *, size_t >& path_name_map)
+        pasched::bit_matrix& path)
 {
     /* loop through each register */
     std::set< pasched::schedule_dep::reg_t >::iterator rit;
@@ -837,13 +833,13 @@ bool PaScheduleDAG::HandlePhysRangeRangeConflicts(
                 for(size_t k = 0; k < creators_phys_succs[j].size(); k++)
                 {
                     const pasched::schedule_unit *succ = creators_phys_succs[j][k];
-                    if(succ != creators[i] && path[path_name_map[creators[i]]][path_name_map[succ]])
+                    if(succ != creators[i] && path.test_bit(dag.index_of(creators[i]), dag.index_of(succ)))
                         partial_i_j = true;
                 }
                 for(size_t k = 0; k < creators_phys_succs[i].size(); k++)
                 {
                     const pasched::schedule_unit *succ = creators_phys_succs[i][k];
-                    if(succ != creators[j] && path[path_name_map[creators[j]]][path_name_map[succ]])
+                    if(succ != creators[j] && path.test_bit(dag.index_of(creators[j]), dag.index_of(succ)))
                         partial_j_i = true;
                 }
                 
@@ -859,7 +855,7 @@ bool PaScheduleDAG::HandlePhysRangeRangeConflicts(
         /* we want to simulate a schedule so we need to virtually schedule either A
          * or B. It might be that only one order is possible if there is path between
          * A and B or between B and A, check that and make sure A is schedulable first */
-        if(path[path_name_map[b]][path_name_map[a]])
+        if(path.test_bit(dag.index_of(b), dag.index_of(a)))
             /* path between B and A: swap them */
             std::swap(a, b);
         /* virtually schedule all successors that depend on the phys R and that
@@ -870,7 +866,7 @@ bool PaScheduleDAG::HandlePhysRangeRangeConflicts(
             const pasched::schedule_dep& dep = dag.get_succs(a)[i];
             if(!dep.is_phys() || dep.reg() != reg)
                 continue;
-            if(!path[path_name_map[b]][path_name_map[dep.to()]])
+            if(!path.test_bit(dag.index_of(b), dag.index_of(dep.to())))
                 continue;
             tricky_units.insert(dep.to());
         }
@@ -962,8 +958,7 @@ void PaScheduleDAG::BuildPaSchedGraph(pasched::schedule_dag& dag)
     {
         std::map< SUnit *, const LLVMScheduleUnit * > map;
         std::set< pasched::schedule_dep::reg_t > phys_deps; /* list of phys reg in deps */
-        std::vector< std::vector< bool > > path;
-        std::map< const pasched::schedule_unit *, size_t > name_map;
+        pasched::bit_matrix path;
         /* cleaning */
         unsafe_clobbering.clear();
         /* build the simple underlying graph */
@@ -971,15 +966,15 @@ void PaScheduleDAG::BuildPaSchedGraph(pasched::schedule_dag& dag)
         if(!dag.is_consistent())
             assert(false);
         /* build a path map */
-        dag.build_path_map(path, name_map);
+        dag.build_path_map(path);
         /* look for conflicting physical registers ranges */
-        if(HandlePhysRangeRangeConflicts(dag, phys_deps, map, path, name_map))
+        if(HandlePhysRangeRangeConflicts(dag, phys_deps, map, path))
         {
             for(size_t i = 0; i < dag.get_units().size(); i++)
                 delete dag.get_units()[i];
         }
         /* look for conflicting physical registers range and unit */
-        else if(HandlePhysRangeUnitConflicts(dag, phys_deps, map, unsafe_clobbering, path, name_map))
+        else if(HandlePhysRangeUnitConflicts(dag, phys_deps, map, unsafe_clobbering, path))
         {
             for(size_t i = 0; i < dag.get_units().size(); i++)
                 delete dag.get_units()[i];
@@ -1018,7 +1013,7 @@ void PaScheduleDAG::Schedule()
     //dbgs() << "********** PaScheduleDAG **********\n";
 
     /* allocate schedule units build a map of them */
-    pasched::generic_schedule_dag dag;
+    pasched::compact_schedule_dag dag;
 
     assert(EntrySU.Succs.size() == 0 && "not handled yet");
     assert(ExitSU.Preds.size() == 0 && "not handled yet");
@@ -1055,9 +1050,9 @@ void PaScheduleDAG::Schedule()
     pasched::basic_status dummy_status;
     pasched::glued_transformation_scheduler fallback_sched(&fallback_accum, &basic_sched, dummy_status);
     #if 0
-    pasched::mris_ilp_scheduler sched(&fallback_sched, 10000, true);
+    pasched::mris_ilp_scheduler sched(&fallback_sched, pasched::budget::from_time(10000), true);
     #elif 0
-    pasched::exp_scheduler sched(&fallback_sched, 10000, false);
+    pasched::exp_scheduler sched(&fallback_sched, pasched::budget::from_time(10000), false);
     #elif 1
     pasched::simple_rp_scheduler sched;
     #else
@@ -352,7 +352,7 @@ struct PaScheduler : public BasicBlockPass
 
         #if 0
         pasched::simple_rp_scheduler basic_sched;
-        pasched::mris_ilp_scheduler sched(&basic_sched, 250);
+        pasched::mris_ilp_scheduler sched(&basic_sched, pasched::budget::from_time(250));
         #else
         pasched::simple_rp_scheduler sched;
         #endif